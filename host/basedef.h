@@ -0,0 +1,58 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Stand-in of the DDK header basedef.h for the host build.
+
+   The host build (cf. Makefile in this folder) compiles the sources of the
+   driver for tests and benchmarks on a Linux or Windows host, with the
+   stand-ins of the DDK headers and of the VxD services (cf. hostwrap.h).
+   The types have the same size as on Windows 95, in particular DWORD and
+   LONG are 32 bits wide (also on LP64 hosts).
+*/
+//-----------------------------------------------------------------------------
+#ifndef BASEDEF_H_
+#define BASEDEF_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#ifndef _cdecl
+#define _cdecl
+#endif
+#ifndef _stdcall
+#define _stdcall
+#endif
+
+#define VOID void
+#define TRUE (1)
+#define FALSE (0)
+
+
+/* -- Types --------------------------------------------------------------- */
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t  BYTE;
+typedef int      BOOL;
+typedef char *   PCHAR;
+typedef DWORD    ULONG;
+typedef int32_t  LONG;                //32 bits, like long on Windows 95
+typedef DWORD    HVM;                 //handle of a virtual machine
+typedef void (*  PFN)(void);
+
+/* -- Global Variables ---------------------------------------------------- */
+
+/* -- Function Prototypes ------------------------------------------------- */
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host benchmark of reads and writes over many port pairs (src/driver.c).
+
+   The driver is built for BENCH_PORTS ports (cf. NUMBER_OF_PORTS). Small
+   writes and reads run round robin over the first n port pairs, so that the
+   working set grows with n, until the port state no longer fits into the
+   caches. The fields, that m_PortWrite and m_PortRead touch, are grouped
+   behind the port data (hot section of PortInformation); the layout of that
+   section is printed along with the cost per transfer. For comparison, each
+   run is repeated with one cold cache line per port touched in addition (the
+   cost of a cold field within the write path, like the framing state was).
+   The fifo buffers are slab objects, separate from PortInformation.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define BENCH_PORTS     (NUMBER_OF_PORTS)
+#define TRANSFERS       (2000000)   //number of writes (and reads) per run
+#define CHUNK           (8)         //number of bytes per write
+#define CACHE_LINE      (64)
+#define REPEAT          (3)         //number of runs per configuration (the fastest one is reported)
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static DWORD m_Order[BENCH_PORTS / 2];    //pairs in random order (defeats the prefetcher of the port array)
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+//load the driver with BENCH_PORTS ports (pairs P0-P1, P2-P3, ...) and open all of them
+static BOOL m_Load(PortInformation * port[])
+{
+   char name[BENCH_PORTS][PORTNAME_LENGTH];
+   DWORD p;
+
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   for (p = 0; p < BENCH_PORTS; ++p)
+   {
+      snprintf(name[p], PORTNAME_LENGTH, "P%u", p);
+   }
+   for (p = 0; p < BENCH_PORTS; ++p)
+   {
+      host_RegistryString(p + 1, "PairPortName", name[p ^ 1]);
+      host_AddDevice(p + 1, name[p]);
+   }
+   for (p = 0; p < BENCH_PORTS; ++p)
+   {
+      long error;
+      port[p] = host_OpenPort(name[p], &error);
+      if (port[p] == NULL)
+      {
+         printf("bench_ports: %s can't be opened (error %ld)\n", name[p], error);
+         return 0;
+      }
+   }
+   return 1;
+}
+
+
+//order the given number of pairs randomly
+static void m_Shuffle(DWORD pairs)
+{
+   DWORD p;
+   srand(pairs);
+   for (p = 0; p < pairs; ++p)
+   {
+      m_Order[p] = p;
+   }
+   for (p = pairs - 1; p > 0; --p)
+   {
+      DWORD const other = rand() % (p + 1);
+      DWORD const swap = m_Order[p];
+      m_Order[p] = m_Order[other];
+      m_Order[other] = swap;
+   }
+}
+
+
+//write and read round robin over the given number of port pairs (in random order). return the time per
+//transfer [ns]. if cold is set, a cold field of both ports is read per transfer too (as if it was in the
+//write path)
+static double m_Run(PortInformation * port[], DWORD pairs, BOOL cold, DWORD * failures)
+{
+   BYTE data[CHUNK] = { 0 };
+   volatile char sink = 0;
+   double start;
+   DWORD n;
+   DWORD pair = 0;
+
+   *failures = 0;
+   start = m_Now();
+   for (n = 0; n < TRANSFERS; ++n)
+   {
+      PortInformation * const writer = port[2 * m_Order[pair]];
+      PortInformation * const reader = port[2 * m_Order[pair] + 1];
+      DWORD written = 0;
+      DWORD received = 0;
+      if (cold)
+      {
+         sink += writer->portName[0] + reader->portName[0];
+      }
+      m_PortWrite(writer, data, CHUNK, &written);
+      m_PortRead(reader, data, CHUNK, &received);
+      *failures += (written != CHUNK) || (received != CHUNK);
+      if (++pair == pairs)
+      {
+         pair = 0;
+      }
+   }
+   return (m_Now() - start) * 1e9 / TRANSFERS;
+}
+
+
+int main(void)
+{
+   static PortInformation * port[BENCH_PORTS];
+   DWORD const hot = offsetof(PortInformation, fifoReleaseTimeout); //first cold field
+   DWORD pairs;
+
+   printf("bench_ports: %u ports, %u transfers of %u bytes per run\n", BENCH_PORTS, TRANSFERS, CHUNK);
+   printf("PortInformation: %u bytes (%u cache lines), hot section incl. port data: %u bytes (%u cache lines)\n",
+          (DWORD)sizeof(PortInformation), (DWORD)(sizeof(PortInformation) + CACHE_LINE - 1) / CACHE_LINE,
+          hot, (hot + CACHE_LINE - 1) / CACHE_LINE);
+   if (!m_Load(port))
+   {
+      return 1;
+   }
+   printf("%8s %14s %14s %18s %10s\n", "ports", "hot set [KB]", "ns/transfer", "+1 cold line [ns]", "failures");
+   for (pairs = 2; pairs <= (BENCH_PORTS / 2); pairs *= 4)
+   {
+      DWORD failures = 0;
+      DWORD f;
+      double ns = 1e9;
+      double coldNs = 1e9;
+      int r;
+      m_Shuffle(pairs);
+      for (r = 0; r < REPEAT; ++r)
+      {
+         double const hotRun = m_Run(port, pairs, 0, &f);
+         double const coldRun = m_Run(port, pairs, 1, &failures);
+         failures += f;
+         ns = (hotRun < ns) ? hotRun : ns;
+         coldNs = (coldRun < coldNs) ? coldRun : coldNs;
+      }
+      //hot set: hot sections of both ports and the fifo buffer of the reader
+      DWORD const set = 2 * pairs * ((hot + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE + pairs * FIFO_SIZE_1BY;
+      printf("%8u %14.1f %14.1f %18.1f %10u\n", 2 * pairs, set / 1024.0, ns, coldNs, failures);
+   }
+   return 0;
+}
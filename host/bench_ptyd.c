@@ -0,0 +1,452 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host benchmark of the pty daemon (ptyd.c) against a socat-style relay.
+
+   The relay works like "socat pty,link=A pty,link=B": one process per pair,
+   that copies between the masters of two ptys (poll, read and write of up to
+   RELAY_CHUNK bytes). The daemon serves all pairs in one process, through
+   the driver.
+
+   For 1 to 128 pairs, the benchmark measures
+   - the throughput: all pairs transfer data from their first to their second
+     port at once (the data is checked),
+   - the latency: one byte is written to the first port of a pair, and the
+     time until it can be read from the second port is taken (median and 99th
+     percentile). The other pairs are idle meanwhile.
+
+   The applications open the links of the ports in raw mode, like serial
+   ports. Run from the host directory (starts ./ptyd).
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define MAX_PAIRS       (128)
+#define TOTAL_BYTES     (32 * 1024 * 1024)   //number of bytes per throughput run (all pairs)
+#define LATENCY_RUNS    (2000)
+#define RELAY_CHUNK     (8192)               //read size of the relay (socat default block size)
+#define LINK_DIR        "/tmp/bench_ptyd"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//a running pty server (daemon or relay)
+typedef struct _Server
+{
+   pid_t pid[MAX_PAIRS];
+   int count;
+} Server;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static int m_Fd[2 * MAX_PAIRS];
+static double m_Latency[LATENCY_RUNS];
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+//write all data to a non-blocking descriptor
+static int m_WriteAll(int fd, const unsigned char * data, size_t count)
+{
+   while (count)
+   {
+      ssize_t const num = write(fd, data, count);
+      if (num < 0)
+      {
+         struct pollfd p;
+         if (errno != EAGAIN)
+         {
+            return 0;
+         }
+         p.fd = fd;
+         p.events = POLLOUT;
+         poll(&p, 1, -1);
+         continue;
+      }
+      data += num;
+      count -= (size_t)num;
+   }
+   return 1;
+}
+
+
+//create a raw pty, linked as the given name. return the master
+static int m_RelayPty(const char * link, int * slave)
+{
+   struct termios t;
+   int const master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+   char * name;
+
+   if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0) || ((name = ptsname(master)) == NULL))
+   {
+      return -1;
+   }
+   *slave = open(name, O_RDWR | O_NOCTTY);
+   tcgetattr(*slave, &t);
+   cfmakeraw(&t);
+   tcsetattr(*slave, TCSANOW, &t);
+   unlink(link);
+   if (symlink(name, link) != 0)
+   {
+      return -1;
+   }
+   return master;
+}
+
+
+//process of the relay of one pair: copy between the masters of the ptys of both ports
+static void m_Relay(int pair, int ready)
+{
+   unsigned char data[RELAY_CHUNK];
+   char link[64];
+   struct pollfd p[2];
+   int slave[2];
+   int i;
+
+   for (i = 0; i < 2; ++i)
+   {
+      snprintf(link, sizeof(link), LINK_DIR "/P%d", 2 * pair + i);
+      p[i].fd = m_RelayPty(link, &slave[i]);
+      p[i].events = POLLIN;
+      if (p[i].fd < 0)
+      {
+         _exit(1);
+      }
+   }
+   if (write(ready, "", 1) != 1)
+   {
+      _exit(1);
+   }
+   for (;;)
+   {
+      if (poll(p, 2, -1) < 0)
+      {
+         _exit(0);
+      }
+      for (i = 0; i < 2; ++i)
+      {
+         if (p[i].revents & POLLIN)
+         {
+            ssize_t const num = read(p[i].fd, data, sizeof(data));
+            if ((num > 0) && !m_WriteAll(p[i ^ 1].fd, data, (size_t)num))
+            {
+               _exit(1);
+            }
+         }
+      }
+   }
+}
+
+
+//start the relays of the given number of pairs
+static int m_RelayStart(Server * server, int pairs)
+{
+   int ready[2];
+   char c;
+   int i;
+
+   if (pipe(ready) != 0)
+   {
+      return 0;
+   }
+   server->count = 0;
+   for (i = 0; i < pairs; ++i)
+   {
+      pid_t const pid = fork();
+      if (pid == 0)
+      {
+         close(ready[0]);
+         m_Relay(i, ready[1]);
+      }
+      server->pid[server->count++] = pid;
+   }
+   close(ready[1]);
+   for (i = 0; i < pairs; ++i)
+   {
+      if (read(ready[0], &c, 1) != 1)
+      {
+         close(ready[0]);
+         return 0;
+      }
+   }
+   close(ready[0]);
+   return 1;
+}
+
+
+//start the daemon with the given number of pairs
+static int m_DaemonStart(Server * server, int pairs)
+{
+   char line[256];
+   char count[16];
+   int out[2];
+   FILE * f;
+   pid_t pid;
+
+   if (pipe(out) != 0)
+   {
+      return 0;
+   }
+   snprintf(count, sizeof(count), "%d", pairs);
+   pid = fork();
+   if (pid == 0)
+   {
+      dup2(out[1], 1);
+      close(out[0]);
+      close(out[1]);
+      execl("./ptyd", "ptyd", "-n", count, "-d", LINK_DIR, (char *)NULL);
+      _exit(127);
+   }
+   close(out[1]);
+   server->pid[0] = pid;
+   server->count = 1;
+   f = fdopen(out[0], "r");
+   while (fgets(line, sizeof(line), f))
+   {
+      if (strncmp(line, "ready", 5) == 0)
+      {
+         fclose(f);
+         return 1;
+      }
+   }
+   fclose(f);
+   return 0;
+}
+
+
+static void m_Stop(Server * server)
+{
+   int i;
+   for (i = 0; i < server->count; ++i)
+   {
+      kill(server->pid[i], SIGTERM);
+   }
+   for (i = 0; i < server->count; ++i)
+   {
+      waitpid(server->pid[i], NULL, 0);
+   }
+}
+
+
+//open the ports of the given number of pairs, like an application opens a serial port
+static int m_OpenPorts(int pairs)
+{
+   char link[64];
+   int p;
+
+   for (p = 0; p < 2 * pairs; ++p)
+   {
+      struct termios t;
+      snprintf(link, sizeof(link), LINK_DIR "/P%d", p);
+      m_Fd[p] = open(link, O_RDWR | O_NOCTTY | O_NONBLOCK);
+      if (m_Fd[p] < 0)
+      {
+         printf("bench_ptyd: %s can't be opened (%s)\n", link, strerror(errno));
+         return 0;
+      }
+      tcgetattr(m_Fd[p], &t);
+      cfmakeraw(&t);
+      cfsetspeed(&t, B115200);
+      tcsetattr(m_Fd[p], TCSANOW, &t);
+   }
+   return 1;
+}
+
+
+static void m_ClosePorts(int pairs)
+{
+   int p;
+   for (p = 0; p < 2 * pairs; ++p)
+   {
+      close(m_Fd[p]);
+   }
+}
+
+
+//all pairs transfer TOTAL_BYTES / pairs bytes (counter pattern) at once. return the throughput [MB/s], 0 on error
+static double m_Throughput(int pairs)
+{
+   static unsigned char data[RELAY_CHUNK];
+   struct pollfd p[2 * MAX_PAIRS];
+   size_t sent[MAX_PAIRS];
+   size_t received[MAX_PAIRS];
+   size_t const total = TOTAL_BYTES / pairs;
+   double start;
+   int done = 0;
+   int i;
+
+   memset(sent, 0, sizeof(sent));
+   memset(received, 0, sizeof(received));
+   start = m_Now();
+   while (done < pairs)
+   {
+      for (i = 0; i < pairs; ++i)
+      {
+         p[2 * i].fd = m_Fd[2 * i];
+         p[2 * i].events = (sent[i] < total) ? POLLOUT : 0;
+         p[2 * i + 1].fd = m_Fd[2 * i + 1];
+         p[2 * i + 1].events = (received[i] < total) ? POLLIN : 0;
+      }
+      if (poll(p, 2 * pairs, 5000) <= 0)
+      {
+         printf("bench_ptyd: transfer stalled\n");
+         return 0;
+      }
+      for (i = 0; i < pairs; ++i)
+      {
+         ssize_t num;
+         size_t k;
+         if (p[2 * i].revents & POLLOUT)
+         {
+            size_t count = total - sent[i];
+            if (count > sizeof(data))
+            {
+               count = sizeof(data);
+            }
+            for (k = 0; k < count; ++k)
+            {
+               data[k] = (unsigned char)(sent[i] + k);
+            }
+            num = write(m_Fd[2 * i], data, count);
+            if (num > 0)
+            {
+               sent[i] += (size_t)num;
+            }
+         }
+         if (p[2 * i + 1].revents & POLLIN)
+         {
+            num = read(m_Fd[2 * i + 1], data, sizeof(data));
+            for (k = 0; (num > 0) && (k < (size_t)num); ++k)
+            {
+               if (data[k] != (unsigned char)(received[i] + k))
+               {
+                  printf("bench_ptyd: pair %d: data error at byte %zu\n", i, received[i] + k);
+                  return 0;
+               }
+            }
+            if (num > 0)
+            {
+               received[i] += (size_t)num;
+               done += (received[i] == total);
+            }
+         }
+      }
+   }
+   return (total * pairs) / (m_Now() - start) / 1e6;
+}
+
+
+static int m_Compare(const void * a, const void * b)
+{
+   double const x = *(const double *)a;
+   double const y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+
+//one-way latency of single bytes over the first pair [us]: median and 99th percentile
+static int m_LatencyRun(double * median, double * p99)
+{
+   struct pollfd p;
+   unsigned char c = 0;
+   int i;
+
+   p.fd = m_Fd[1];
+   p.events = POLLIN;
+   for (i = 0; i < LATENCY_RUNS; ++i)
+   {
+      double const start = m_Now();
+      unsigned char r;
+      if (write(m_Fd[0], &c, 1) != 1)
+      {
+         return 0;
+      }
+      if ((poll(&p, 1, 1000) != 1) || (read(m_Fd[1], &r, 1) != 1) || (r != c))
+      {
+         printf("bench_ptyd: byte %d lost\n", i);
+         return 0;
+      }
+      m_Latency[i] = (m_Now() - start) * 1e6;
+      c++;
+   }
+   qsort(m_Latency, LATENCY_RUNS, sizeof(double), m_Compare);
+   *median = m_Latency[LATENCY_RUNS / 2];
+   *p99 = m_Latency[(LATENCY_RUNS * 99) / 100];
+   return 1;
+}
+
+
+//run both measurements against one server
+static int m_Measure(const char * name, int pairs, int daemon)
+{
+   Server server;
+   double throughput = 0;
+   double median = 0;
+   double p99 = 0;
+   int ok;
+
+   ok = daemon ? m_DaemonStart(&server, pairs) : m_RelayStart(&server, pairs);
+   if (!ok || !m_OpenPorts(pairs))
+   {
+      printf("bench_ptyd: %s with %d pairs can't be started\n", name, pairs);
+      m_Stop(&server);
+      return 0;
+   }
+   throughput = m_Throughput(pairs);
+   ok = (throughput > 0) && m_LatencyRun(&median, &p99);
+   m_ClosePorts(pairs);
+   m_Stop(&server);
+   if (ok)
+   {
+      printf("%-6s %5d pairs: %8.1f MB/s, latency %6.1f us (p99 %6.1f us), %d processes\n",
+             name, pairs, throughput, median, p99, server.count);
+   }
+   return ok;
+}
+
+
+int main(void)
+{
+   static const int pairs[] = { 1, 16, 128 };
+   struct rlimit limit;
+   unsigned int i;
+
+   getrlimit(RLIMIT_NOFILE, &limit);
+   limit.rlim_cur = limit.rlim_max;
+   setrlimit(RLIMIT_NOFILE, &limit);
+   signal(SIGPIPE, SIG_IGN);
+   mkdir(LINK_DIR, 0755);
+   for (i = 0; i < (sizeof(pairs) / sizeof(pairs[0])); ++i)
+   {
+      if (!m_Measure("relay", pairs[i], 0) || !m_Measure("ptyd", pairs[i], 1))
+      {
+         return 1;
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,400 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host benchmark of the driver (src/driver.c), sharded over several cores.
+
+   The pairs are distributed over the shards (pair i on shard i % n). Each
+   shard is a worker process, pinned to a core, with a driver of its own, i.e.
+   with its own port table (the driver and the stand-ins keep their state in
+   module globals, like the VxD, that exists once per system). A worker runs
+   the applications of its pairs: it writes chunks of a counter pattern to the
+   first port of the pair, and reads and checks them at the second port.
+
+   Every CROSS_EVERY-th pair crosses shards: its second port is served by the
+   next shard. On the shard of the first port, that port is paired with a
+   proxy port; the worker drains the rx fifo of the proxy into a lock-free
+   single producer, single consumer queue in shared memory. The next shard
+   takes the data from the queue and writes it to its proxy port, whose pair
+   is the second port. The queues form a ring (shard i to shard i+1), so with
+   one shard, the shard is producer and consumer of its queue. The work is
+   the same for any number of shards.
+
+   Usage: bench_shards [max. number of shards], default: number of cores.
+   The time for all of the data is reported for 1, 2, 4, ... shards.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define SHARD_MAX       (64)
+#define PAIRS           (256)          //number of pairs (all shards)
+#define CROSS_EVERY     (4)            //every 4th pair crosses shards
+#define PAIR_BYTES      (1280 * 1024)  //number of bytes per pair
+#define CHUNK           (64)           //number of bytes per write of an application
+#define QUEUE_SLOTS     (256)          //number of slots of a queue (power of 2)
+#define SLOT_DATA       (248)          //number of bytes per slot
+#define CACHE_LINE      (64)
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//data of a pair, that crosses shards
+typedef struct _QueueSlot
+{
+   DWORD pair;
+   DWORD count;
+   BYTE data[SLOT_DATA];
+} QueueSlot;
+
+//lock-free queue from one shard to the next one. head is written by the producer only, tail by the consumer only
+typedef struct _Queue
+{
+   DWORD head;
+   BYTE reserved1[CACHE_LINE - sizeof(DWORD)];
+   DWORD tail;
+   BYTE reserved2[CACHE_LINE - sizeof(DWORD)];
+   QueueSlot slot[QUEUE_SLOTS];
+} Queue;
+
+//memory, shared by all workers
+typedef struct _Shared
+{
+   DWORD ready;                  //number of workers, that are ready to start
+   DWORD start;                  //set, when all workers are ready
+   DWORD failed;                 //number of workers, that failed
+   double end[SHARD_MAX];        //time, each worker was done
+   Queue queue[SHARD_MAX];       //queue[i]: shard i to shard i+1
+} Shared;
+
+//a pair, as seen by one shard
+typedef struct _Link
+{
+   PortInformation * tx;         //first port, written by the application (NULL: on another shard)
+   PortInformation * rx;         //second port, read by the application (NULL: on another shard)
+   PortInformation * out;        //proxy, whose rx fifo is drained into the queue (cross shard pair)
+   PortInformation * in;         //proxy, that the data of the queue is written to (cross shard pair)
+   DWORD sent;
+   DWORD forwarded;
+   DWORD received;
+} Link;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static Shared * m_Shared;
+static Link m_Links[PAIRS];
+static BYTE m_Pattern[2 * 256 + SLOT_DATA];
+static DWORD m_DevNode;
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static DWORD m_Min(DWORD a, DWORD b)
+{
+   return (a < b) ? a : b;
+}
+
+
+static PortFunctionTable * m_Functions(PortInformation * hPort)
+{
+   return (PortFunctionTable *)hPort->portData.PDfunctions;
+}
+
+
+//free slot at the head of a queue (producer), NULL if the queue is full
+static QueueSlot * m_QueueSlot(Queue * queue)
+{
+   DWORD const tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+   return ((queue->head - tail) < QUEUE_SLOTS) ? &queue->slot[queue->head % QUEUE_SLOTS] : NULL;
+}
+
+
+static void m_QueuePush(Queue * queue)
+{
+   __atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+
+//slot at the tail of a queue (consumer), NULL if the queue is empty
+static QueueSlot * m_QueueFront(Queue * queue)
+{
+   DWORD const head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+   return (head != queue->tail) ? &queue->slot[queue->tail % QUEUE_SLOTS] : NULL;
+}
+
+
+static void m_QueuePop(Queue * queue)
+{
+   __atomic_store_n(&queue->tail, queue->tail + 1, __ATOMIC_RELEASE);
+}
+
+
+//add a pair of ports to the driver of this shard, and open both of them
+static BOOL m_AddPair(char * name, PortInformation ** first, PortInformation ** second)
+{
+   char firstName[PORTNAME_LENGTH];
+   char secondName[PORTNAME_LENGTH];
+   long error = 0;
+
+   snprintf(firstName, sizeof(firstName), "%sA", name);
+   snprintf(secondName, sizeof(secondName), "%sB", name);
+   host_RegistryString(m_DevNode + 1, "PairPortName", secondName);
+   host_RegistryString(m_DevNode + 2, "PairPortName", firstName);
+   host_AddDevice(m_DevNode + 1, firstName);
+   host_AddDevice(m_DevNode + 2, secondName);
+   m_DevNode += 2;
+   *first = host_OpenPort(firstName, &error);
+   *second = host_OpenPort(secondName, &error);
+   if ((*first == NULL) || (*second == NULL))
+   {
+      printf("bench_shards: %s can't be opened (error %ld)\n", name, error);
+      return 0;
+   }
+   return 1;
+}
+
+
+//load the driver of a shard, with the ports of its pairs
+static BOOL m_Load(DWORD shard, DWORD shards)
+{
+   char name[PORTNAME_LENGTH];
+   DWORD p;
+
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   for (p = 0; p < PAIRS; ++p)
+   {
+      Link * const link = &m_Links[p];
+      DWORD const first = p % shards;
+      DWORD const second = ((p % CROSS_EVERY) == 0) ? ((first + 1) % shards) : first;
+      snprintf(name, sizeof(name), "P%u", p);
+      if ((first == shard) && (second == shard) && ((p % CROSS_EVERY) != 0))
+      {
+         if (!m_AddPair(name, &link->tx, &link->rx)) return 0;
+         continue;
+      }
+      if (first == shard)
+      {
+         snprintf(name, sizeof(name), "X%u", p);
+         if (!m_AddPair(name, &link->tx, &link->out)) return 0;
+      }
+      if (second == shard)
+      {
+         snprintf(name, sizeof(name), "Y%u", p);
+         if (!m_AddPair(name, &link->in, &link->rx)) return 0;
+      }
+   }
+   return 1;
+}
+
+
+//check the data, received by a pair
+static BOOL m_Check(Link * link, BYTE * data, DWORD count)
+{
+   DWORD i;
+   for (i = 0; i < count; ++i)
+   {
+      if (data[i] != (BYTE)(link->received + i))
+      {
+         printf("bench_shards: pair %u: data error at byte %u\n", (DWORD)(link - m_Links), link->received + i);
+         return 0;
+      }
+   }
+   link->received += count;
+   return 1;
+}
+
+
+//run the applications of the pairs of a shard, until all of their data is transferred
+static BOOL m_Work(DWORD shard, DWORD shards)
+{
+   static BYTE data[FIFO_SIZE_MAX];
+   Queue * const outQueue = &m_Shared->queue[shard];
+   Queue * const inQueue = &m_Shared->queue[(shard + shards - 1) % shards];
+   DWORD inPos = 0;
+   BOOL done = 0;
+
+   while (!done)
+   {
+      BOOL progress = 0;
+      QueueSlot * slot;
+      DWORD p;
+
+      done = 1;
+      for (p = 0; p < PAIRS; ++p)
+      {
+         Link * const link = &m_Links[p];
+         DWORD num = 0;
+         if (link->tx && (link->sent < PAIR_BYTES))
+         {
+            m_Functions(link->tx)->pPortWrite(link->tx, &m_Pattern[link->sent % 256], CHUNK, &num);
+            link->sent += num;
+            done = 0;
+         }
+         while (link->out && (link->forwarded < PAIR_BYTES) && ((slot = m_QueueSlot(outQueue)) != NULL))
+         {
+            m_Functions(link->out)->pPortRead(link->out, slot->data, SLOT_DATA, &num);
+            if (num == 0)
+            {
+               break;
+            }
+            slot->pair = p;
+            slot->count = num;
+            m_QueuePush(outQueue);
+            link->forwarded += num;
+         }
+         if (link->out && (link->forwarded < PAIR_BYTES))
+         {
+            done = 0;
+         }
+         if (link->rx && (link->received < PAIR_BYTES))
+         {
+            m_Functions(link->rx)->pPortRead(link->rx, data, sizeof(data), &num);
+            if (!m_Check(link, data, num))
+            {
+               return 0;
+            }
+            progress |= (num != 0);
+            done = 0;
+         }
+      }
+      //data of cross shard pairs, from the previous shard
+      while ((slot = m_QueueFront(inQueue)) != NULL)
+      {
+         Link * const link = &m_Links[slot->pair];
+         DWORD num = 0;
+         m_Functions(link->in)->pPortWrite(link->in, &slot->data[inPos], slot->count - inPos, &num);
+         inPos += num;
+         if (inPos < slot->count)
+         {
+            break; //the application must read first
+         }
+         inPos = 0;
+         m_QueuePop(inQueue);
+      }
+      if (!progress)
+      {
+         sched_yield(); //waiting for another shard
+      }
+   }
+   return 1;
+}
+
+
+//worker process of a shard
+static int m_Worker(DWORD shard, DWORD shards)
+{
+   cpu_set_t cpus;
+   long const cores = sysconf(_SC_NPROCESSORS_ONLN);
+   BOOL ok;
+
+   CPU_ZERO(&cpus);
+   CPU_SET(shard % (cores > 0 ? cores : 1), &cpus);
+   sched_setaffinity(0, sizeof(cpus), &cpus);
+   ok = m_Load(shard, shards);
+   __atomic_add_fetch(&m_Shared->ready, 1, __ATOMIC_ACQ_REL);
+   while (!__atomic_load_n(&m_Shared->start, __ATOMIC_ACQUIRE))
+   {
+      sched_yield();
+   }
+   ok = ok && m_Work(shard, shards);
+   m_Shared->end[shard] = m_Now();
+   if (!ok)
+   {
+      __atomic_add_fetch(&m_Shared->failed, 1, __ATOMIC_ACQ_REL);
+   }
+   return ok ? 0 : 1;
+}
+
+
+//run all pairs on the given number of shards. return the time [s], 0 on error
+static double m_Run(DWORD shards)
+{
+   pid_t pid[SHARD_MAX];
+   double start;
+   double end = 0;
+   DWORD s;
+
+   memset(m_Shared, 0, sizeof(Shared));
+   for (s = 0; s < shards; ++s)
+   {
+      pid[s] = fork();
+      if (pid[s] == 0)
+      {
+         _exit(m_Worker(s, shards));
+      }
+   }
+   while (__atomic_load_n(&m_Shared->ready, __ATOMIC_ACQUIRE) < shards)
+   {
+      sched_yield();
+   }
+   start = m_Now();
+   __atomic_store_n(&m_Shared->start, 1, __ATOMIC_RELEASE);
+   for (s = 0; s < shards; ++s)
+   {
+      waitpid(pid[s], NULL, 0);
+      if (m_Shared->end[s] > end)
+      {
+         end = m_Shared->end[s];
+      }
+   }
+   return m_Shared->failed ? 0 : (end - start);
+}
+
+
+int main(int argc, char * argv[])
+{
+   long const cores = sysconf(_SC_NPROCESSORS_ONLN);
+   DWORD maxShards = (argc > 1) ? (DWORD)strtoul(argv[1], NULL, 0) : (DWORD)cores;
+   double single = 0;
+   DWORD shards;
+   DWORD i;
+
+   if (maxShards < 1) maxShards = 1;
+   if (maxShards > SHARD_MAX) maxShards = SHARD_MAX;
+   for (i = 0; i < sizeof(m_Pattern); ++i)
+   {
+      m_Pattern[i] = (BYTE)i;
+   }
+   m_Shared = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (m_Shared == MAP_FAILED)
+   {
+      return 1;
+   }
+   printf("bench_shards: %u pairs (every %u. across shards), %u KB per pair, %ld cores\n",
+          PAIRS, CROSS_EVERY, PAIR_BYTES / 1024, cores);
+   for (shards = 1; shards <= maxShards; shards = (shards == maxShards) ? (shards + 1) : m_Min(2 * shards, maxShards))
+   {
+      double const t = m_Run(shards);
+      if (t <= 0)
+      {
+         printf("bench_shards: run with %u shards failed\n", shards);
+         return 1;
+      }
+      if (shards == 1)
+      {
+         single = t;
+      }
+      printf("%2u shards: %6.3f s, %7.1f MB/s, speedup %4.2f\n",
+             shards, t, ((double)PAIRS * PAIR_BYTES) / t / 1e6, single / t);
+   }
+   return 0;
+}
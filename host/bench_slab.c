@@ -0,0 +1,118 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host benchmark of the slab allocator (src/slab.c) against the heap.
+
+   The same sequence of allocations and frees (random sizes of the driver's
+   objects, a working set of up to WORKING_SET objects) is run on the slab and
+   on the heap stand-in of hostwrap.c (C library malloc/free). The VMM heap
+   of Windows 95 is not available on the host; the comparison shows the cost
+   of the slab itself, which is independent of the heap implementation. The
+   slab grows on demand (slab_alloc_grow); its memory is reported after the
+   reserve, the run and the trim.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hostwrap.h"
+#include "slab.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define OPERATIONS      (20000000)  //number of allocations (and frees)
+#define WORKING_SET     (16)        //max. number of objects alive at once
+#define SEQUENCE        (4096)      //length of the (repeated) random sequence
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static DWORD m_Size[SEQUENCE];      //size of each allocation
+static DWORD m_Victim[SEQUENCE];    //object to free before each allocation
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+//run the sequence with the given allocator. return the time per allocation and free [ns]
+static double m_Run(void * (*allocate)(DWORD size), void (*release)(void * object), DWORD * failures)
+{
+   void * object[WORKING_SET] = { 0 };
+   double start;
+   DWORD n;
+
+   *failures = 0;
+   start = m_Now();
+   for (n = 0; n < OPERATIONS; ++n)
+   {
+      DWORD const i = n % SEQUENCE;
+      void ** const slot = &object[m_Victim[i]];
+      if (*slot)
+      {
+         release(*slot);
+      }
+      *slot = allocate(m_Size[i]);
+      if (*slot == NULL)
+      {
+         (*failures)++;
+      }
+      else
+      {
+         *(DWORD *)*slot = n; //touch the object
+      }
+   }
+   for (n = 0; n < WORKING_SET; ++n)
+   {
+      if (object[n])
+      {
+         release(object[n]);
+      }
+   }
+   return (m_Now() - start) * 1e9 / OPERATIONS;
+}
+
+
+static void * m_HeapAllocate(DWORD size)
+{
+   return Heap_Allocate(size, 0);
+}
+
+static void m_HeapFree(void * object)
+{
+   Heap_Free(object, 0);
+}
+
+
+int main(void)
+{
+   //sizes of the driver's objects: small records, rx fifos (base and grown), delay lines
+   static const DWORD sizes[] = { 24, 64, 512, 512, 1024, 2048, 4096, 8000 };
+   DWORD failures;
+   double ns;
+   DWORD i;
+
+   srand(1);
+   for (i = 0; i < SEQUENCE; ++i)
+   {
+      m_Size[i] = sizes[rand() % (sizeof(sizes)/sizeof(sizes[0]))];
+      m_Victim[i] = rand() % WORKING_SET;
+   }
+   slab_init();
+   printf("slab reserve: %u bytes\n", host_heapBytes);
+   ns = m_Run(slab_alloc_grow, slab_free, &failures);
+   printf("slab     %6.1f ns per allocation and free (%u failed), grown to %u bytes\n", ns, failures, host_heapBytes);
+   slab_trim();
+   printf("slab trimmed: %u bytes\n", host_heapBytes);
+   slab_exit();
+   ns = m_Run(m_HeapAllocate, m_HeapFree, &failures);
+   printf("heap     %6.1f ns per allocation and free (%u failed)\n", ns, failures);
+   return 0;
+}
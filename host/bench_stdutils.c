@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host benchmark of the stdutils kernels (src/stdutils.c).
+
+   Each kernel is timed against a byte by byte reference (the implementation
+   before the word-wide kernels) and the C library, for the sizes used by the
+   driver (names, DCB/COMMPROP, records, fifo buffers). The host build runs the
+   portable C implementation of the kernels; the VxD uses rep movsd/stosd.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stdutils.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define BENCH_BYTES     (64*1024*1024)    //number of bytes processed per kernel and size
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned char m_Source[8192 + 8];
+static unsigned char m_Destination[8192 + 8];
+static volatile DWORD m_Sink; //keeps the compiler from dropping the results
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+//byte by byte references
+static void m_ByteMemclr(void * memory, unsigned int num)
+{
+   unsigned char * mem = memory;
+   while (num--)
+   {
+      *mem++ = 0;
+   }
+}
+
+static void m_ByteMemcpy(void * destination, const void * source, unsigned int num)
+{
+   unsigned char * dest = destination;
+   const unsigned char * src = source;
+   while (num--)
+   {
+      *dest++ = *src++;
+   }
+}
+
+static void * m_ByteMemchr(const void * memory, int value, unsigned int num)
+{
+   const unsigned char * mem = memory;
+   while (num--)
+   {
+      if (*mem == (unsigned char)value)
+      {
+         return (void *)mem;
+      }
+      ++mem;
+   }
+   return 0;
+}
+
+static int m_ByteStrncmp(const char * str1, const char * str2, unsigned int num)
+{
+   int c1;
+   int c2;
+   if (num == 0)
+   {
+      return 0;
+   }
+   do
+   {
+      c1 = *str1++;
+      c2 = *str2++;
+      if (c1 != c2)
+      {
+         break;
+      }
+      --num;
+   } while (c1 && c2 && num);
+   return (c1 - c2);
+}
+
+static unsigned int m_DigitUitoa(char * destination, DWORD value, unsigned int num)
+{
+   char * start = destination;
+   unsigned int len = 0;
+   do
+   {
+      if (num <= 1)
+      {
+         break;
+      }
+      *destination++ = (char)('0' + (value % 10));
+      value = value / 10;
+      --num;
+      ++len;
+   } while (value != 0);
+   *destination = 0;
+   --destination;
+   while (start < destination)
+   {
+      char tmp = *start;
+      *start++ = *destination;
+      *destination-- = tmp;
+   }
+   return len;
+}
+
+
+//print the throughput of a kernel [MB/s] resp. its rate [calls/s]
+static void m_Report(const char * kernel, unsigned int size, const char * variant, double seconds, DWORD calls)
+{
+   if (size)
+   {
+      printf("%-8s %5u  %-10s %9.0f MB/s\n", kernel, size, variant, (double)calls * size / seconds / 1e6);
+   }
+   else
+   {
+      printf("%-8s %5s  %-10s %9.1f Mcalls/s\n", kernel, "-", variant, calls / seconds / 1e6);
+   }
+}
+
+
+//run statement BENCH_BYTES/size times; report is the size for the report (0: calls/s)
+#define BENCH_REPORT(kernel, size, report, variant, statement) \
+   { \
+      DWORD const calls = BENCH_BYTES / (size); \
+      DWORD c; \
+      double start = m_Now(); \
+      for (c = 0; c < calls; ++c) \
+      { \
+         statement; \
+         __asm__ __volatile__("" ::: "memory"); \
+      } \
+      m_Report(kernel, report, variant, m_Now() - start, calls); \
+   }
+
+#define BENCH(kernel, size, variant, statement) BENCH_REPORT(kernel, size, size, variant, statement)
+
+
+int main(void)
+{
+   static const unsigned int sizes[] = { 16, 64, 512, 4096 };
+   unsigned int i;
+
+   memset(m_Source, 'a', sizeof(m_Source));
+   for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i)
+   {
+      unsigned int const size = sizes[i];
+      BENCH("memclr", size, "bytewise", m_ByteMemclr(m_Destination, size));
+      BENCH("memclr", size, "stdutils", stdutils_memclr(m_Destination, size));
+      BENCH("memclr", size, "libc", memset(m_Destination, 0, size));
+      BENCH("memcpy", size, "bytewise", m_ByteMemcpy(m_Destination, m_Source, size));
+      BENCH("memcpy", size, "stdutils", stdutils_memcpy(m_Destination, m_Source, size));
+      BENCH("memcpy", size, "libc", memcpy(m_Destination, m_Source, size));
+      BENCH("memmove", size, "stdutils", stdutils_memmove(&m_Destination[1], m_Destination, size));
+      BENCH("memmove", size, "libc", memmove(&m_Destination[1], m_Destination, size));
+      BENCH("memchr", size, "bytewise", m_Sink += (m_ByteMemchr(m_Source, 'x', size) != 0));
+      BENCH("memchr", size, "stdutils", m_Sink += (stdutils_memchr(m_Source, 'x', size) != 0));
+      BENCH("memchr", size, "libc", m_Sink += (memchr(m_Source, 'x', size) != 0));
+   }
+   //strings: port names (equal up to the last char)
+   {
+      static char str1[16] = "COM1234567890AB";
+      static char str2[16] = "COM1234567890AC";
+      BENCH("strncmp", 16, "bytewise", m_Sink += m_ByteStrncmp(str1, str2, sizeof(str1)));
+      BENCH("strncmp", 16, "stdutils", m_Sink += stdutils_strncmp(str1, str2, sizeof(str1)));
+      BENCH("strncmp", 16, "libc", m_Sink += strncmp(str1, str2, sizeof(str1)));
+   }
+   //number formatting (trace messages): calls per second
+   {
+      char buffer[16];
+      DWORD value = 0;
+      BENCH_REPORT("uitoa", 16, 0, "digitwise", m_Sink += m_DigitUitoa(buffer, value += 2654435761u, sizeof(buffer)));
+      BENCH_REPORT("uitoa", 16, 0, "stdutils", m_Sink += stdutils_uitoa(buffer, value += 2654435761u, sizeof(buffer)));
+   }
+   return 0;
+}
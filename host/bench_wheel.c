@@ -0,0 +1,242 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host benchmark of the timer wheel (src/wheel.c) with 10000 timers.
+
+   The timers are armed with random periods of up to SPREAD ms, re-armed (as
+   the rx interval timer is, when data was received meanwhile), cancelled, and
+   at last left to expire, while the virtual time advances. The same sequence
+   is run on a sorted list of timers, as a per-timer time-out list would keep
+   them. The expiry is checked: each timer fires once, no earlier than due and
+   at most WHEEL_PERIOD ms late, and the callbacks run at interrupt time.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hostwrap.h"
+#include "wheel.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define TIMERS          (10000)
+#define SPREAD          (10000)     //max. period [ms] of a timer
+#define ROUNDS          (20)        //number of arm, re-arm and cancel runs
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//timer of the sorted list
+typedef struct _ListTimer
+{
+   struct _ListTimer * next;
+   struct _ListTimer * prev;
+   DWORD due;
+   DWORD armed;
+} ListTimer;
+
+//operations of a timer implementation
+typedef struct _TimerOps
+{
+   const char * name;
+   void (* arm)(unsigned int timer, DWORD due);
+   void (* cancel)(unsigned int timer);
+   void (* run)(DWORD milliseconds);   //advance the virtual time, expire the due timers
+} TimerOps;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static WheelTimer m_WheelTimer[TIMERS];
+static ListTimer m_ListTimer[TIMERS];
+static ListTimer m_ListHead;           //circular, sorted by due time
+static DWORD m_Period[TIMERS];         //random period of each timer
+static DWORD m_Due[TIMERS];            //due time of each timer
+static DWORD m_Fired[TIMERS];          //number of expiries of each timer
+static DWORD m_Late;                   //max. delay of an expiry [ms]
+static DWORD m_Errors;                 //expiries before due time, or not at interrupt time
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+//a timer expired
+static void m_Expire(DWORD refData)
+{
+   DWORD const late = host_time - m_Due[refData];
+   if (((LONG)late < 0) || !host_interrupt)
+   {
+      m_Errors++;
+   }
+   if (late > m_Late)
+   {
+      m_Late = late;
+   }
+   m_Fired[refData]++;
+}
+
+
+static void m_WheelArm(unsigned int timer, DWORD due)
+{
+   wheel_arm(&m_WheelTimer[timer], due, m_Expire, timer);
+}
+
+
+static void m_WheelCancel(unsigned int timer)
+{
+   wheel_cancel(&m_WheelTimer[timer]);
+}
+
+
+//insert in order of the due time (searched from the end, where later timers are)
+static void m_ListArm(unsigned int timer, DWORD due)
+{
+   ListTimer * const t = &m_ListTimer[timer];
+   ListTimer * p = m_ListHead.prev;
+
+   if (t->armed)
+   {
+      t->prev->next = t->next;
+      t->next->prev = t->prev;
+   }
+   while ((p != &m_ListHead) && ((LONG)(p->due - due) > 0))
+   {
+      p = p->prev;
+   }
+   t->due = due;
+   t->armed = 1;
+   t->prev = p;
+   t->next = p->next;
+   p->next->prev = t;
+   p->next = t;
+}
+
+
+static void m_ListCancel(unsigned int timer)
+{
+   ListTimer * const t = &m_ListTimer[timer];
+   if (t->armed)
+   {
+      t->prev->next = t->next;
+      t->next->prev = t->prev;
+      t->armed = 0;
+   }
+}
+
+
+//expire the due timers of the list every WHEEL_PERIOD ms (like the time-out of the wheel)
+static void m_ListRun(DWORD milliseconds)
+{
+   DWORD const end = host_time + milliseconds;
+   while ((LONG)(end - host_time) > 0)
+   {
+      host_time += WHEEL_PERIOD;
+      host_interrupt = 1;
+      while ((m_ListHead.next != &m_ListHead) && ((LONG)(host_time - m_ListHead.next->due) >= 0))
+      {
+         ListTimer * const t = m_ListHead.next;
+         m_ListCancel((unsigned int)(t - m_ListTimer));
+         m_Expire((DWORD)(t - m_ListTimer));
+      }
+      host_interrupt = 0;
+   }
+}
+
+
+//arm all timers with the periods, starting at the given one. return the time per timer [ns]
+static double m_ArmAll(const TimerOps * ops, unsigned int first)
+{
+   double const start = m_Now();
+   unsigned int i;
+   for (i = 0; i < TIMERS; ++i)
+   {
+      m_Due[i] = host_time + m_Period[(first + i) % TIMERS];
+      ops->arm(i, m_Due[i]);
+   }
+   return (m_Now() - start) * 1e9 / TIMERS;
+}
+
+
+//run the sequence with the given implementation. return FALSE on a wrong expiry
+static int m_Run(const TimerOps * ops)
+{
+   double arm = 0;
+   double rearm = 0;
+   double cancel = 0;
+   double start;
+   double expiry;
+   unsigned int r;
+   unsigned int i;
+
+   for (r = 0; r < ROUNDS; ++r)
+   {
+      arm += m_ArmAll(ops, 0);
+      rearm += m_ArmAll(ops, r + 1); //other periods
+      start = m_Now();
+      for (i = 0; i < TIMERS; ++i)
+      {
+         ops->cancel(i);
+      }
+      cancel += (m_Now() - start) * 1e9 / TIMERS;
+   }
+
+   //let all timers expire
+   m_Late = 0;
+   m_Errors = 0;
+   for (i = 0; i < TIMERS; ++i)
+   {
+      m_Fired[i] = 0;
+   }
+   m_ArmAll(ops, 0);
+   start = m_Now();
+   ops->run(SPREAD + 2 * WHEEL_PERIOD);
+   expiry = (m_Now() - start) * 1e9 / TIMERS;
+   for (i = 0; i < TIMERS; ++i)
+   {
+      if (m_Fired[i] != 1)
+      {
+         printf("bench_wheel: %s: timer %u fired %u times\n", ops->name, i, m_Fired[i]);
+         return 0;
+      }
+   }
+   if (m_Errors || (m_Late > WHEEL_PERIOD))
+   {
+      printf("bench_wheel: %s: %u early expiries or not at interrupt time, up to %u ms late\n", ops->name, m_Errors, m_Late);
+      return 0;
+   }
+   printf("%-6s %7.1f ns arm, %7.1f ns re-arm, %5.1f ns cancel, %7.1f ns expiry (up to %u ms late)\n",
+          ops->name, arm / ROUNDS, rearm / ROUNDS, cancel / ROUNDS, expiry, m_Late);
+   return 1;
+}
+
+
+int main(void)
+{
+   static const TimerOps wheel = { "wheel", m_WheelArm, m_WheelCancel, host_Run };
+   static const TimerOps list = { "list", m_ListArm, m_ListCancel, m_ListRun };
+   unsigned int i;
+
+   srand(1);
+   for (i = 0; i < TIMERS; ++i)
+   {
+      m_Period[i] = 1 + (DWORD)rand() % SPREAD;
+   }
+   m_ListHead.next = &m_ListHead;
+   m_ListHead.prev = &m_ListHead;
+   wheel_init();
+   printf("%u timers, periods up to %u ms\n", TIMERS, SPREAD);
+   if (!m_Run(&wheel) || !m_Run(&list))
+   {
+      return 1;
+   }
+   wheel_exit();
+   return (host_violations != 0);
+}
@@ -0,0 +1,664 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Stand-ins of the VxD services for the host build.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vcomm.h"
+#include "hostwrap.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define HOST_TIMEOUTS      (256)    //max. number of pending time-outs
+#define HOST_EVENTS        (256)    //max. number of pending global events
+#define HOST_PAGES         (64)     //max. number of page allocations
+#define HOST_FILES         (8)      //max. number of open files
+#define HOST_PORTS         (4096)   //max. number of ports added to VCOMM
+#define HOST_VALUES        (8192)   //max. number of registry values
+#define HOST_STATS         (8192)   //max. number of System Monitor statistics
+#define HOST_NAME_LENGTH   (32)
+#define HOST_VALUE_SIZE    (128)
+#define HOST_PAGE_SIZE     (4096)
+#define HOST_SYS_VM        (1)      //handle of the system VM
+#define HOST_USER_START    (0x00400000)   //lowest address of a buffer of a Win32 application (cf. USER_ARENA_START)
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//header of a heap block (keeps the size for the statistics)
+typedef union _HeapBlock
+{
+   DWORD size;
+   double align;
+} HeapBlock;
+
+typedef struct _HostTimeOut
+{
+   DWORD handle;        //0 if unused
+   DWORD due;           //system time of expiry
+   HostCallback callback;
+   DWORD refData;
+} HostTimeOut;
+
+typedef struct _HostEvent
+{
+   HostCallback callback;
+   DWORD refData;
+} HostEvent;
+
+typedef struct _HostPort
+{
+   char name[HOST_NAME_LENGTH];
+   HostPortOpen open;
+} HostPort;
+
+typedef struct _HostValue
+{
+   DWORD devNode;
+   char name[HOST_NAME_LENGTH];
+   DWORD type;
+   DWORD size;
+   BYTE data[HOST_VALUE_SIZE];
+} HostValue;
+
+
+/* -- Global Variables ---------------------------------------------------- */
+int host_critical;
+int host_carry;
+int host_interrupt;
+DWORD host_violations;
+DWORD host_heapBytes;
+DWORD host_heapFail;
+DWORD host_time;
+DWORD host_completions;
+DWORD host_process;
+DWORD host_userLocks;
+DWORD host_userLockFail;
+BOOL host_perfLoaded;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static HostTimeOut m_TimeOuts[HOST_TIMEOUTS];
+static DWORD m_TimeOutHandle;
+static HostEvent m_Events[HOST_EVENTS];
+static DWORD m_EventHead;
+static DWORD m_EventTail;
+static void * m_Pages[HOST_PAGES];
+static FILE * m_Files[HOST_FILES];
+static HostDriverControl m_DriverControl;
+static HostPort m_Ports[HOST_PORTS];
+static HostValue m_Values[HOST_VALUES];
+static PerfServer * m_PerfServer;      //the one registered server (handle 1)
+static PerfStat * m_PerfStats[HOST_STATS];
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//services, that must not be called at interrupt time or within a critical section, count a violation
+static void m_CheckTaskTime(const char * service)
+{
+   if (host_interrupt || host_critical)
+   {
+      fprintf(stderr, "%s called %s\n", service, host_interrupt ? "at interrupt time" : "within a critical section");
+      host_violations++;
+   }
+}
+
+
+void SHELL_SendMessage(HVM hvm, PCHAR pszCaption, PCHAR pszMessage)
+{
+   fprintf(stderr, "%s: %s\n", pszCaption ? pszCaption : "SHELL", pszMessage);
+}
+
+
+HVM Get_Sys_VM_Handle(void)
+{
+   return HOST_SYS_VM;
+}
+
+
+WORD VCOMM_GetVersion(VOID)
+{
+   return 0x0100;
+}
+
+
+BOOL VCOMM_RegisterPortDriver(PFN pDriverControl)
+{
+   m_DriverControl = (HostDriverControl)pDriverControl;
+   return 1;
+}
+
+
+BOOL VCOMM_AddPort(DWORD refData, PFN pPortOpen, char * pPortName)
+{
+   unsigned int p;
+   for (p = 0; p < HOST_PORTS; ++p)
+   {
+      if ((m_Ports[p].open == NULL) || (strncmp(m_Ports[p].name, pPortName, HOST_NAME_LENGTH) == 0))
+      {
+         strncpy(m_Ports[p].name, pPortName, HOST_NAME_LENGTH - 1);
+         m_Ports[p].open = (HostPortOpen)pPortOpen;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+
+void * Heap_Allocate(DWORD numOfBytes, DWORD flags)
+{
+   HeapBlock * block;
+
+   m_CheckTaskTime("Heap_Allocate");
+   if (host_heapFail && (--host_heapFail == 0))
+   {
+      return NULL; //simulated shortage of memory
+   }
+   block = malloc(sizeof(HeapBlock) + numOfBytes);
+   if (block == NULL)
+   {
+      return NULL;
+   }
+   block->size = numOfBytes;
+   host_heapBytes += numOfBytes;
+   return block + 1;
+}
+
+
+void Heap_Free(void * memory, DWORD flags)
+{
+   HeapBlock * const block = (HeapBlock *)memory - 1;
+   m_CheckTaskTime("Heap_Free");
+   host_heapBytes -= block->size;
+   free(block);
+}
+
+
+DWORD CONFIGMG_ReadRegistryValue(DWORD dnDevNode, char * pszSubKey, char * pszValueName,
+                                 DWORD ulExpectedType, void * pvBuffer, DWORD * pulLength,
+                                 DWORD ulFlags)
+{
+   unsigned int v;
+   for (v = 0; v < HOST_VALUES; ++v)
+   {
+      HostValue * const value = &m_Values[v];
+      if (value->name[0] && (value->devNode == dnDevNode) &&
+          (strncmp(value->name, pszValueName, HOST_NAME_LENGTH) == 0))
+      {
+         if (value->type != ulExpectedType)
+         {
+            return CR_WRONG_TYPE;
+         }
+         if (value->size > *pulLength)
+         {
+            *pulLength = value->size;
+            return CR_BUFFER_SMALL;
+         }
+         memcpy(pvBuffer, value->data, value->size);
+         *pulLength = value->size;
+         return CR_SUCCESS;
+      }
+   }
+   return CR_NO_SUCH_VALUE;
+}
+
+
+//the pages are locked and zero initialized. the handle is the index of the allocation + 1
+void * Page_Allocate(DWORD pages, DWORD * handle)
+{
+   unsigned int p;
+   m_CheckTaskTime("Page_Allocate");
+   *handle = 0;
+   for (p = 0; p < HOST_PAGES; ++p)
+   {
+      if (m_Pages[p] == NULL)
+      {
+         if (posix_memalign(&m_Pages[p], HOST_PAGE_SIZE, pages * HOST_PAGE_SIZE) != 0)
+         {
+            m_Pages[p] = NULL;
+            return NULL;
+         }
+         memset(m_Pages[p], 0, pages * HOST_PAGE_SIZE);
+         *handle = p + 1;
+         return m_Pages[p];
+      }
+   }
+   return NULL;
+}
+
+
+void Page_Free(DWORD handle)
+{
+   m_CheckTaskTime("Page_Free");
+   if ((handle > 0) && (handle <= HOST_PAGES))
+   {
+      free(m_Pages[handle - 1]);
+      m_Pages[handle - 1] = NULL;
+   }
+}
+
+
+//the host has a single address space: the global address is the address itself
+void * Page_MapGlobal(void * address, DWORD pages)
+{
+   return address;
+}
+
+
+void Page_UnmapGlobal(void * global, DWORD pages)
+{
+}
+
+
+//the host has no private arena. the addresses below it are invalid, like on Windows 95
+BOOL Page_LockUser(void * buffer, DWORD length)
+{
+   m_CheckTaskTime("Page_LockUser");
+   if (length == 0)
+   {
+      return 1;
+   }
+   if (((uintptr_t)buffer < HOST_USER_START) || (host_userLockFail && (--host_userLockFail == 0)))
+   {
+      return 0;
+   }
+   host_userLocks++;
+   return 1;
+}
+
+
+void Page_UnlockUser(void * buffer, DWORD length)
+{
+   m_CheckTaskTime("Page_UnlockUser");
+   if (length)
+   {
+      host_userLocks--;
+   }
+}
+
+
+DWORD Timer_SetGlobalTimeOut(DWORD milliseconds, DWORD refData, void * callback)
+{
+   unsigned int t;
+   for (t = 0; t < HOST_TIMEOUTS; ++t)
+   {
+      HostTimeOut * const timeOut = &m_TimeOuts[t];
+      if (timeOut->handle == 0)
+      {
+         if (++m_TimeOutHandle == 0)
+         {
+            m_TimeOutHandle = 1; //0 is no valid handle
+         }
+         timeOut->handle = m_TimeOutHandle;
+         timeOut->due = host_time + milliseconds;
+         timeOut->callback = (HostCallback)callback;
+         timeOut->refData = refData;
+         return timeOut->handle;
+      }
+   }
+   return 0;
+}
+
+
+void Timer_CancelTimeOut(DWORD handle)
+{
+   unsigned int t;
+   for (t = 0; (t < HOST_TIMEOUTS) && handle; ++t)
+   {
+      if (m_TimeOuts[t].handle == handle)
+      {
+         m_TimeOuts[t].handle = 0;
+         break;
+      }
+   }
+}
+
+
+DWORD Event_ScheduleGlobal(void * callback, DWORD refData)
+{
+   HostEvent * const event = &m_Events[m_EventTail % HOST_EVENTS];
+   if ((m_EventTail - m_EventHead) >= HOST_EVENTS)
+   {
+      fprintf(stderr, "Event_ScheduleGlobal: too many events\n");
+      host_violations++;
+      return 0;
+   }
+   event->callback = (HostCallback)callback;
+   event->refData = refData;
+   return ++m_EventTail;
+}
+
+
+//the handle of a file is its index + 1
+DWORD IFSMgr_OpenFile(char * path, DWORD mode, DWORD action)
+{
+   unsigned int f;
+   const char * fopenMode;
+
+   m_CheckTaskTime("IFSMgr_OpenFile");
+   if (action & (R0_ACTION_CREATENEW | R0_ACTION_REPLACEEXISTING))
+   {
+      fopenMode = ((mode & 0x0F) == R0_ACCESS_READWRITE) ? "w+b" : "wb";
+   }
+   else
+   {
+      fopenMode = ((mode & 0x0F) == R0_ACCESS_READONLY) ? "rb" : "r+b";
+   }
+   for (f = 0; f < HOST_FILES; ++f)
+   {
+      if (m_Files[f] == NULL)
+      {
+         m_Files[f] = fopen(path, fopenMode);
+         return m_Files[f] ? (f + 1) : 0;
+      }
+   }
+   return 0;
+}
+
+
+DWORD IFSMgr_ReadFile(DWORD handle, void * buffer, DWORD count, DWORD position)
+{
+   FILE * const file = m_Files[handle - 1];
+   m_CheckTaskTime("IFSMgr_ReadFile");
+   if (fseek(file, position, SEEK_SET) != 0)
+   {
+      return 0;
+   }
+   return (DWORD)fread(buffer, 1, count, file);
+}
+
+
+DWORD IFSMgr_WriteFile(DWORD handle, void * buffer, DWORD count, DWORD position)
+{
+   FILE * const file = m_Files[handle - 1];
+   m_CheckTaskTime("IFSMgr_WriteFile");
+   if (fseek(file, position, SEEK_SET) != 0)
+   {
+      return 0;
+   }
+   return (DWORD)fwrite(buffer, 1, count, file);
+}
+
+
+DWORD IFSMgr_GetFileSize(DWORD handle)
+{
+   FILE * const file = m_Files[handle - 1];
+   m_CheckTaskTime("IFSMgr_GetFileSize");
+   if (fseek(file, 0, SEEK_END) != 0)
+   {
+      return 0;
+   }
+   return (DWORD)ftell(file);
+}
+
+
+void IFSMgr_CloseFile(DWORD handle)
+{
+   m_CheckTaskTime("IFSMgr_CloseFile");
+   fclose(m_Files[handle - 1]);
+   m_Files[handle - 1] = NULL;
+}
+
+
+DWORD System_GetTime(void)
+{
+   return host_time;
+}
+
+
+void VWIN32_DIOCCompletion(DWORD event)
+{
+   host_completions++;
+}
+
+
+DWORD VWIN32_GetCurrentProcess(void)
+{
+   return host_process;
+}
+
+
+//the PERF VxD is loaded, if the test says so (host_perfLoaded)
+void * VMM_GetDDB(DWORD deviceId)
+{
+   return ((deviceId == PERF_DEVICE_ID) && host_perfLoaded) ? (void *)&host_perfLoaded : NULL;
+}
+
+
+DWORD PERF_ServerRegister(PerfServer * server)
+{
+   m_CheckTaskTime("PERF_ServerRegister");
+   if (!host_perfLoaded || m_PerfServer)
+   {
+      return 0;
+   }
+   m_PerfServer = server;
+   return 1;
+}
+
+
+//the statistic stays registered until its server is deregistered (like System Monitor reads it until then)
+DWORD PERF_ServerAddStat(DWORD server, PerfStat * stat)
+{
+   DWORD s;
+   m_CheckTaskTime("PERF_ServerAddStat");
+   if ((server != 1) || (m_PerfServer == NULL))
+   {
+      return 0;
+   }
+   for (s = 0; s < HOST_STATS; ++s)
+   {
+      if (m_PerfStats[s] == NULL)
+      {
+         m_PerfStats[s] = stat;
+         return s + 1;
+      }
+   }
+   return 0;
+}
+
+
+void PERF_ServerDeregister(DWORD server)
+{
+   m_CheckTaskTime("PERF_ServerDeregister");
+   if ((server == 1) && m_PerfServer)
+   {
+      m_PerfServer = NULL;
+      memset(m_PerfStats, 0, sizeof(m_PerfStats));
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Read a statistic, like System Monitor does.
+
+   \param   statName    name of the statistic (e.g. "COM5 Rx fifo fill")
+   \param   value       receives the value of the statistic
+
+   \retval  TRUE        if the statistic is registered
+   \retval  FALSE       otherwise
+----------------------------------------------------------------------------*/
+BOOL host_PerfRead(char * statName, DWORD * value)
+{
+   DWORD s;
+   for (s = 0; s < HOST_STATS; ++s)
+   {
+      PerfStat * const stat = m_PerfStats[s];
+      if (stat && (strcmp(stat->name, statName) == 0))
+      {
+         *value = (stat->flags & PERF_STAT_FUNCPTR) ? ((DWORD (*)(void))stat->stat)() : *(DWORD *)stat->stat;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Call all scheduled global events, including the ones scheduled meanwhile.
+----------------------------------------------------------------------------*/
+void host_RunEvents(void)
+{
+   while (m_EventHead != m_EventTail)
+   {
+      HostEvent const event = m_Events[m_EventHead++ % HOST_EVENTS];
+      if (host_critical)
+      {
+         fprintf(stderr, "event called within a critical section\n");
+         host_violations++;
+      }
+      event.callback(event.refData);
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Advance the virtual system time.
+
+   The time-outs, which expire meanwhile, are called in the order of their expiry
+   (time-outs with the same expiry in the order of scheduling), at their expiry time.
+   The global events are called after each time-out.
+
+   \param milliseconds   period to advance
+----------------------------------------------------------------------------*/
+void host_Run(DWORD milliseconds)
+{
+   DWORD const end = host_time + milliseconds;
+
+   host_RunEvents();
+   for (;;)
+   {
+      HostTimeOut * next = NULL;
+      HostTimeOut current;
+      unsigned int t;
+
+      //find the time-out, expiring next (the smallest handle first, if several expire at the same time)
+      for (t = 0; t < HOST_TIMEOUTS; ++t)
+      {
+         HostTimeOut * const timeOut = &m_TimeOuts[t];
+         if (timeOut->handle && ((LONG)(timeOut->due - end) <= 0) &&
+             ((next == NULL) || ((LONG)(timeOut->due - next->due) < 0) ||
+              ((timeOut->due == next->due) && ((LONG)(timeOut->handle - next->handle) < 0))))
+         {
+            next = timeOut;
+         }
+      }
+      if (next == NULL)
+      {
+         break;
+      }
+      current = *next;
+      next->handle = 0; //a time-out is called only once
+      if ((LONG)(current.due - host_time) > 0)
+      {
+         host_time = current.due;
+      }
+      if (host_critical)
+      {
+         fprintf(stderr, "time-out called within a critical section\n");
+         host_violations++;
+      }
+      host_interrupt = 1;
+      current.callback(current.refData);
+      host_interrupt = 0;
+      host_RunEvents();
+   }
+   host_time = end;
+}
+
+
+DWORD host_PendingTimeOuts(void)
+{
+   DWORD pending = 0;
+   unsigned int t;
+   for (t = 0; t < HOST_TIMEOUTS; ++t)
+   {
+      pending += (m_TimeOuts[t].handle != 0);
+   }
+   return pending;
+}
+
+
+static HostValue * m_RegistryValue(DWORD devNode, char * valueName)
+{
+   HostValue * unused = NULL;
+   unsigned int v;
+   for (v = 0; v < HOST_VALUES; ++v)
+   {
+      HostValue * const value = &m_Values[v];
+      if (value->name[0] && (value->devNode == devNode) &&
+          (strncmp(value->name, valueName, HOST_NAME_LENGTH) == 0))
+      {
+         return value;
+      }
+      if ((value->name[0] == 0) && (unused == NULL))
+      {
+         unused = value;
+      }
+   }
+   if (unused)
+   {
+      unused->devNode = devNode;
+      strncpy(unused->name, valueName, HOST_NAME_LENGTH - 1);
+   }
+   return unused;
+}
+
+
+//set a string value of the hardware branch of a device node (REG_SZ)
+void host_RegistryString(DWORD devNode, char * valueName, char * value)
+{
+   HostValue * const entry = m_RegistryValue(devNode, valueName);
+   DWORD const size = (DWORD)strlen(value) + 1;
+   if (entry && (size <= HOST_VALUE_SIZE))
+   {
+      entry->type = REG_SZ;
+      entry->size = size;
+      memcpy(entry->data, value, size);
+   }
+}
+
+
+//set a DWORD value of the hardware branch of a device node (REG_BINARY)
+void host_RegistryDword(DWORD devNode, char * valueName, DWORD value)
+{
+   HostValue * const entry = m_RegistryValue(devNode, valueName);
+   if (entry)
+   {
+      entry->type = REG_BINARY;
+      entry->size = sizeof(value);
+      memcpy(entry->data, &value, sizeof(value));
+   }
+}
+
+
+//VCOMM enumerates a device node: its driver control function adds the port (cf. VCOMM_AddPort)
+void host_AddDevice(DWORD devNode, char * portName)
+{
+   if (m_DriverControl)
+   {
+      m_DriverControl(DC_Initialize, devNode, devNode, 0, 0, portName);
+   }
+}
+
+
+//an application opens a port: VCOMM calls the open function of the driver, that added the port
+void * host_OpenPort(char * portName, long * error)
+{
+   unsigned int p;
+   for (p = 0; p < HOST_PORTS; ++p)
+   {
+      if (m_Ports[p].open && (strncmp(m_Ports[p].name, portName, HOST_NAME_LENGTH) == 0))
+      {
+         return m_Ports[p].open(portName, HOST_SYS_VM, error);
+      }
+   }
+   *error = IE_BADID;
+   return NULL;
+}
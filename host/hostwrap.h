@@ -0,0 +1,163 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Stand-ins of the VxD services for the host build (replaces wrapper.h).
+
+   src/wrapper.h includes this file instead of its own content, if MXVCP_HOST
+   is defined. The services are implemented by hostwrap.c on top of the C
+   library. A critical section only counts its nesting depth, so that tests
+   can check, that no callback is called with "interrupts disabled".
+
+   Time is virtual: System_GetTime returns host_time, which only advances
+   within host_Run. host_Run calls the expired time-outs in the order of
+   their expiry (as the VMM does at interrupt time) and the scheduled global
+   events in the order of scheduling (as the VMM does outside of interrupt
+   time). So hours of traffic are simulated in seconds, and each run with the
+   same input calls the driver in the same order.
+*/
+//-----------------------------------------------------------------------------
+#ifndef HOSTWRAP_H_
+#define HOSTWRAP_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#define ENTER_CRITICAL()   (host_critical++)
+#define LEAVE_CRITICAL()   (host_critical--)
+
+//result of a system control message (cf. MXVCP_DeviceInit)
+#define SET_CARRY()        (host_carry = 1)
+#define CLEAR_CARRY()      (host_carry = 0)
+
+//the host calls time-outs and events as C functions, with the reference data as parameter
+#define REGISTER_CALLBACK(name, handler) \
+   static void name(DWORD refData) \
+   { \
+      handler(refData); \
+   }
+
+//ring 0 file access (cf. wrapper.h)
+#define R0_ACCESS_READONLY    (0x00)
+#define R0_ACCESS_WRITEONLY   (0x01)
+#define R0_ACCESS_READWRITE   (0x02)
+#define R0_SHARE_DENYNONE     (0x40)
+#define R0_ACTION_OPENEXISTING      (0x01)
+#define R0_ACTION_REPLACEEXISTING   (0x02)
+#define R0_ACTION_CREATENEW         (0x10)
+
+//performance statistics (cf. wrapper.h)
+#define PERF_DEVICE_ID        (0x0048)
+#define PERF_STAT_FUNCPTR     (0x01)
+#define PERF_STAT_COUNT       (0x02)
+
+//error codes of CONFIGMG_ReadRegistryValue
+#define CR_SUCCESS            (0x00)
+#define CR_BUFFER_SMALL       (0x1A)
+#define CR_NO_SUCH_VALUE      (0x25)
+#define CR_WRONG_TYPE         (0x26)
+
+
+/* -- Types --------------------------------------------------------------- */
+typedef struct _PerfServer
+{
+   DWORD level;
+   DWORD flags;
+   char * name;
+   char * nodeName;
+   void * controlFunc;
+} PerfServer;
+
+typedef struct _PerfStat
+{
+   DWORD level;
+   DWORD flags;
+   char * name;
+   char * nodeName;
+   char * unitName;
+   char * description;
+   void * stat;
+   DWORD scaleType;
+} PerfStat;
+
+//time-out resp. global event (cf. REGISTER_CALLBACK)
+typedef void (* HostCallback)(DWORD refData);
+
+//driver control function resp. port open function, registered at VCOMM
+typedef void (* HostDriverControl)(DWORD fCode, DWORD devNode, DWORD refData,
+                                   DWORD allocBase, DWORD allocIrq, char * portName);
+typedef void * (* HostPortOpen)(char * portName, DWORD vmId, long * error);
+
+
+/* -- Global Variables ---------------------------------------------------- */
+extern int host_critical;        //nesting depth of critical sections
+extern int host_carry;           //carry flag, returned by the last system control message
+extern int host_interrupt;       //a time-out is running (interrupt time)
+extern DWORD host_violations;    //number of services, called at interrupt time or within a critical section,
+                                 //although they must not
+extern DWORD host_heapBytes;     //number of bytes allocated from the heap
+extern DWORD host_heapFail;      //the n-th heap allocation from now on fails (0: none fails)
+extern DWORD host_time;          //virtual system time [ms]
+extern DWORD host_completions;   //number of completed overlapped DeviceIoControl calls
+extern DWORD host_process;       //current Win32 process (caller of CreateFile resp. DeviceIoControl)
+extern DWORD host_userLocks;     //number of user buffers, locked by Page_LockUser and not yet unlocked
+extern DWORD host_userLockFail;  //the n-th Page_LockUser from now on fails (buffer not committed, 0: none fails)
+extern BOOL host_perfLoaded;     //the PERF VxD is loaded (System Monitor statistics can be registered)
+
+
+/* -- Function Prototypes ------------------------------------------------- */
+
+//VMM, VCOMM and other VxD services, used by the driver (cf. wrapper.h)
+void SHELL_SendMessage(HVM hvm, PCHAR pszCaption, PCHAR pszMessage);
+HVM Get_Sys_VM_Handle(void);
+WORD VCOMM_GetVersion(VOID);
+BOOL VCOMM_RegisterPortDriver(PFN pDriverControl);
+BOOL VCOMM_AddPort(DWORD refData, PFN pPortOpen, char * pPortName);
+void * Heap_Allocate(DWORD numOfBytes, DWORD flags);
+void Heap_Free(void * memory, DWORD flags);
+DWORD CONFIGMG_ReadRegistryValue(DWORD dnDevNode, char * pszSubKey, char * pszValueName,
+                                 DWORD ulExpectedType, void * pvBuffer, DWORD * pulLength,
+                                 DWORD ulFlags);
+void * Page_Allocate(DWORD pages, DWORD * handle);
+void Page_Free(DWORD handle);
+void * Page_MapGlobal(void * address, DWORD pages);
+void Page_UnmapGlobal(void * global, DWORD pages);
+BOOL Page_LockUser(void * buffer, DWORD length);
+void Page_UnlockUser(void * buffer, DWORD length);
+DWORD Timer_SetGlobalTimeOut(DWORD milliseconds, DWORD refData, void * callback);
+void Timer_CancelTimeOut(DWORD handle);
+DWORD Event_ScheduleGlobal(void * callback, DWORD refData);
+DWORD IFSMgr_OpenFile(char * path, DWORD mode, DWORD action);
+DWORD IFSMgr_ReadFile(DWORD handle, void * buffer, DWORD count, DWORD position);
+DWORD IFSMgr_WriteFile(DWORD handle, void * buffer, DWORD count, DWORD position);
+DWORD IFSMgr_GetFileSize(DWORD handle);
+void IFSMgr_CloseFile(DWORD handle);
+DWORD System_GetTime(void);
+void VWIN32_DIOCCompletion(DWORD event);
+DWORD VWIN32_GetCurrentProcess(void);
+void * VMM_GetDDB(DWORD deviceId);
+DWORD PERF_ServerRegister(PerfServer * server);
+DWORD PERF_ServerAddStat(DWORD server, PerfStat * stat);
+void PERF_ServerDeregister(DWORD server);
+
+//control of the host environment (tests and benchmarks)
+void host_Run(DWORD milliseconds);
+void host_RunEvents(void);
+DWORD host_PendingTimeOuts(void);
+void host_RegistryString(DWORD devNode, char * valueName, char * value);
+void host_RegistryDword(DWORD devNode, char * valueName, DWORD value);
+void host_AddDevice(DWORD devNode, char * portName);
+void * host_OpenPort(char * portName, long * error);
+BOOL host_PerfRead(char * statName, DWORD * value);
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
@@ -0,0 +1,491 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Linux pty daemon: the port pairs of the driver (src/driver.c) as pseudo terminals.
+
+   The daemon loads the driver against the stand-ins of hostwrap.c, with
+   pairs P0-P1, P2-P3, ... Each port is exposed as a pty; a symlink P<n> in
+   the link directory points to its slave device, so the applications open
+   the link like a serial port. No kernel module is needed.
+
+   All ports are served by one epoll loop. Per wakeup, the daemon reads up to
+   PTY_BATCH bytes from the pty master into the driver (m_PortWrite), and
+   drains the rx fifos, that signalled data (rx callback), into the masters
+   of their ptys. Data, that the pair port can't take, stays pending and the
+   master is not polled for input meanwhile (backpressure); likewise for
+   data, that the pty can't take (EPOLLOUT). The virtual system time of the
+   stand-ins follows the real time (the timer wheel is driven while time-outs
+   are pending).
+
+   The termios settings of the slave (speed, character size, parity, stop
+   bits) are mapped onto the DCB of the port, before each batch is written to
+   the pair (cf. m_LineSync).
+
+   Usage: ptyd [-n pairs] [-d link directory]
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define PTY_PORTS       (NUMBER_OF_PORTS)
+#define PTY_BATCH       (65536)     //max. number of bytes, read from a pty master per wakeup
+#define PTY_EVENTS      (256)       //max. number of epoll events per wakeup
+#define PTY_PATH        (256)
+#define ONESTOPBIT      (0)
+#define TWOSTOPBITS     (2)
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//a port of the driver, exposed as pty
+typedef struct _PtyPort
+{
+   PortInformation * hPort;
+   int master;
+   int slave;              //kept open, so that the master doesn't hang up while no application has the slave open
+   DWORD epollEvents;      //events, the master is polled for
+   BOOL ready;             //rx callback was called, the rx fifo was not drained yet
+   DWORD inCount;          //input, read from the master, not yet taken by the driver
+   DWORD inPos;
+   DWORD outCount;         //output, read from the driver, not yet taken by the master
+   DWORD outPos;
+   tcflag_t cflag;         //termios settings, mapped last onto the DCB
+   speed_t speed;
+   char link[PTY_PATH];
+   BYTE in[PTY_BATCH];
+   BYTE out[FIFO_SIZE_MAX];
+} PtyPort;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static PtyPort * m_Ports;
+static DWORD m_PortCount;
+static DWORD m_Ready[PTY_PORTS];       //ports, whose rx callback was called
+static DWORD m_ReadyCount;
+static int m_Epoll = -1;
+static volatile sig_atomic_t m_Stop;
+
+//termios speeds and their baud rates
+static const struct
+{
+   speed_t speed;
+   DWORD baudRate;
+} m_Speeds[] =
+{
+   { B50, 50 }, { B75, 75 }, { B110, 110 }, { B134, 134 }, { B150, 150 }, { B200, 200 }, { B300, 300 },
+   { B600, 600 }, { B1200, 1200 }, { B1800, 1800 }, { B2400, 2400 }, { B4800, 4800 }, { B9600, 9600 },
+   { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 }, { B115200, 115200 }, { B230400, 230400 },
+   { B460800, 460800 }, { B921600, 921600 }, { B1000000, 1000000 }, { B2000000, 2000000 },
+   { B4000000, 4000000 }
+};
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static PortFunctionTable * m_Functions(PortInformation * hPort)
+{
+   return (PortFunctionTable *)hPort->portData.PDfunctions;
+}
+
+
+static DWORD m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+
+static void m_Signal(int sig)
+{
+   m_Stop = 1;
+}
+
+
+//rx callback of all ports. the reference data is the number of the port
+static void _cdecl m_RxCallback(PortInformation * hPort, DWORD lReferenceData, DWORD lEvent, DWORD lSubEvent)
+{
+   PtyPort * const port = &m_Ports[lReferenceData];
+   if (!port->ready)
+   {
+      port->ready = 1;
+      m_Ready[m_ReadyCount++] = lReferenceData;
+   }
+}
+
+
+//poll the master of a port for the given events
+static void m_Poll(PtyPort * port, DWORD events)
+{
+   struct epoll_event ev;
+   if (port->epollEvents != events)
+   {
+      ev.events = events;
+      ev.data.u32 = (uint32_t)(port - m_Ports);
+      epoll_ctl(m_Epoll, EPOLL_CTL_MOD, port->master, &ev);
+      port->epollEvents = events;
+   }
+}
+
+
+//map the termios settings of the slave of a port onto the DCB of the port, if they were changed.
+//the master reports the termios settings of its slave
+static void m_LineSync(PtyPort * port)
+{
+   struct termios t;
+   _DCB dcb;
+   speed_t speed;
+   DWORD i;
+
+   if (tcgetattr(port->master, &t) != 0)
+   {
+      return;
+   }
+   speed = cfgetospeed(&t);
+   if ((speed == port->speed) && ((t.c_cflag & (CSIZE | PARENB | PARODD | CMSPAR | CSTOPB)) == port->cflag))
+   {
+      return;
+   }
+   port->speed = speed;
+   port->cflag = t.c_cflag & (CSIZE | PARENB | PARODD | CMSPAR | CSTOPB);
+   memset(&dcb, 0, sizeof(dcb));
+   dcb.BaudRate = CBR_9600;
+   for (i = 0; i < (sizeof(m_Speeds) / sizeof(m_Speeds[0])); ++i)
+   {
+      if (m_Speeds[i].speed == speed)
+      {
+         dcb.BaudRate = m_Speeds[i].baudRate;
+      }
+   }
+   switch (t.c_cflag & CSIZE)
+   {
+   case CS5: dcb.ByteSize = 5; break;
+   case CS6: dcb.ByteSize = 6; break;
+   case CS7: dcb.ByteSize = 7; break;
+   default:  dcb.ByteSize = 8; break;
+   }
+   if (!(t.c_cflag & PARENB))
+   {
+      dcb.Parity = NOPARITY;
+   }
+   else if (t.c_cflag & CMSPAR)
+   {
+      dcb.Parity = (t.c_cflag & PARODD) ? MARKPARITY : SPACEPARITY;
+   }
+   else
+   {
+      dcb.Parity = (t.c_cflag & PARODD) ? ODDPARITY : EVENPARITY;
+   }
+   dcb.StopBits = (t.c_cflag & CSTOPB) ? TWOSTOPBITS : ONESTOPBIT;
+   m_Functions(port->hPort)->pPortSetCommState(port->hPort, &dcb, fBaudRate | fByteSize | fbParity | fStopBits);
+}
+
+
+//pass the pending input of a port to the driver. return TRUE, if all of it was taken
+static BOOL m_Forward(PtyPort * port)
+{
+   DWORD written = 0;
+   if (port->inPos < port->inCount)
+   {
+      m_Functions(port->hPort)->pPortWrite(port->hPort, &port->in[port->inPos], port->inCount - port->inPos, &written);
+      port->inPos += written;
+   }
+   if (port->inPos < port->inCount)
+   {
+      return 0;
+   }
+   port->inPos = port->inCount = 0;
+   return 1;
+}
+
+
+//read a batch from the master of a port, and pass it to the driver
+static void m_Input(PtyPort * port)
+{
+   ssize_t num;
+   if (port->inCount)
+   {
+      return; //previous batch still pending
+   }
+   num = read(port->master, port->in, sizeof(port->in));
+   if (num <= 0)
+   {
+      return;
+   }
+   port->inCount = (DWORD)num;
+   //the line format of both ports applies to the transfer
+   m_LineSync(port);
+   m_LineSync(&m_Ports[(port - m_Ports) ^ 1]);
+   if (!m_Forward(port))
+   {
+      m_Poll(port, port->epollEvents & EPOLLOUT); //backpressure: the pair must drain first (pending output stays polled)
+   }
+}
+
+
+//drain the rx fifo of a port into its master. return TRUE, if the fifo was drained completely
+static BOOL m_Output(PtyPort * port)
+{
+   PtyPort * const pair = &m_Ports[(port - m_Ports) ^ 1];
+   for (;;)
+   {
+      ssize_t num;
+      if (port->outPos == port->outCount)
+      {
+         DWORD received = 0;
+         m_Functions(port->hPort)->pPortRead(port->hPort, port->out, sizeof(port->out), &received);
+         port->outPos = 0;
+         port->outCount = received;
+         if (received == 0)
+         {
+            return 1;
+         }
+         //room in the rx fifo: take the pending input of the pair
+         if (pair->inCount && m_Forward(pair))
+         {
+            m_Poll(pair, EPOLLIN | (pair->epollEvents & EPOLLOUT));
+         }
+      }
+      num = write(port->master, &port->out[port->outPos], port->outCount - port->outPos);
+      if (num <= 0)
+      {
+         if ((num < 0) && (errno == EAGAIN))
+         {
+            m_Poll(port, port->inCount ? EPOLLOUT : (EPOLLIN | EPOLLOUT));
+            return 0;
+         }
+         port->outPos = port->outCount; //discard (pty closed)
+         continue;
+      }
+      port->outPos += (DWORD)num;
+   }
+}
+
+
+//drain the ports, whose rx callback was called
+static void m_DrainReady(void)
+{
+   while (m_ReadyCount)
+   {
+      PtyPort * const port = &m_Ports[m_Ready[--m_ReadyCount]];
+      port->ready = 0;
+      if (!(port->epollEvents & EPOLLOUT))
+      {
+         m_Output(port);
+      }
+   }
+}
+
+
+//create the pty of a port, and its link
+static BOOL m_PtyOpen(PtyPort * port, const char * directory, const char * name)
+{
+   struct termios t;
+   struct epoll_event ev;
+   char * slaveName;
+
+   port->master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+   if ((port->master < 0) || (grantpt(port->master) != 0) || (unlockpt(port->master) != 0))
+   {
+      return 0;
+   }
+   slaveName = ptsname(port->master);
+   port->slave = slaveName ? open(slaveName, O_RDWR | O_NOCTTY) : -1;
+   if (port->slave < 0)
+   {
+      return 0;
+   }
+   tcgetattr(port->slave, &t);
+   cfmakeraw(&t);
+   tcsetattr(port->slave, TCSANOW, &t);
+   snprintf(port->link, sizeof(port->link), "%s/%s", directory, name);
+   unlink(port->link);
+   if (symlink(slaveName, port->link) != 0)
+   {
+      port->link[0] = 0;
+      return 0;
+   }
+   ev.events = EPOLLIN;
+   ev.data.u32 = (uint32_t)(port - m_Ports);
+   port->epollEvents = EPOLLIN;
+   if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, port->master, &ev) != 0)
+   {
+      return 0;
+   }
+   printf("%s %s\n", name, slaveName);
+   return 1;
+}
+
+
+//load the driver with the given number of pairs, and expose all ports as ptys
+static BOOL m_Load(DWORD pairs, const char * directory)
+{
+   char name[PORTNAME_LENGTH];
+   char pairName[PORTNAME_LENGTH];
+   struct rlimit limit;
+   DWORD p;
+
+   //two descriptors per port
+   getrlimit(RLIMIT_NOFILE, &limit);
+   if (limit.rlim_cur < (rlim_t)(4 * pairs + 64))
+   {
+      limit.rlim_cur = (limit.rlim_max < (rlim_t)(4 * pairs + 64)) ? limit.rlim_max : (rlim_t)(4 * pairs + 64);
+      setrlimit(RLIMIT_NOFILE, &limit);
+   }
+   m_PortCount = 2 * pairs;
+   m_Ports = calloc(m_PortCount, sizeof(PtyPort));
+   m_Epoll = epoll_create1(0);
+   if ((m_Ports == NULL) || (m_Epoll < 0))
+   {
+      return 0;
+   }
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   for (p = 0; p < m_PortCount; ++p)
+   {
+      snprintf(name, sizeof(name), "P%u", p);
+      snprintf(pairName, sizeof(pairName), "P%u", p ^ 1);
+      host_RegistryString(p + 1, "PairPortName", pairName);
+      host_RegistryDword(p + 1, "FifoSizeMax", FIFO_SIZE_MAX);
+      host_AddDevice(p + 1, name);
+   }
+   for (p = 0; p < m_PortCount; ++p)
+   {
+      PtyPort * const port = &m_Ports[p];
+      long error = 0;
+      port->master = port->slave = -1;
+      snprintf(name, sizeof(name), "P%u", p);
+      port->hPort = host_OpenPort(name, &error);
+      if (port->hPort == NULL)
+      {
+         fprintf(stderr, "ptyd: %s can't be opened (error %ld)\n", name, error);
+         return 0;
+      }
+      m_Functions(port->hPort)->pPortSetReadCallback(port->hPort, 1, m_RxCallback, p);
+      if (!m_PtyOpen(port, directory, name))
+      {
+         fprintf(stderr, "ptyd: pty of %s can't be created (%s)\n", name, strerror(errno));
+         return 0;
+      }
+      m_LineSync(port);
+   }
+   return 1;
+}
+
+
+static void m_Unload(void)
+{
+   DWORD p;
+   for (p = 0; p < m_PortCount; ++p)
+   {
+      PtyPort * const port = &m_Ports[p];
+      if (port->hPort)
+      {
+         m_Functions(port->hPort)->pPortClose(port->hPort);
+      }
+      if (port->link[0])
+      {
+         unlink(port->link);
+      }
+      if (port->master >= 0)
+      {
+         close(port->master);
+      }
+      if (port->slave >= 0)
+      {
+         close(port->slave);
+      }
+   }
+   MXVCP_DeviceExit(Get_Sys_VM_Handle());
+   free(m_Ports);
+   if (m_Epoll >= 0)
+   {
+      close(m_Epoll);
+   }
+}
+
+
+int main(int argc, char * argv[])
+{
+   struct epoll_event events[PTY_EVENTS];
+   const char * directory = ".";
+   DWORD pairs = 1;
+   DWORD last;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "n:d:")) != -1)
+   {
+      switch (opt)
+      {
+      case 'n': pairs = (DWORD)strtoul(optarg, NULL, 0); break;
+      case 'd': directory = optarg; break;
+      default:
+         fprintf(stderr, "usage: ptyd [-n pairs] [-d link directory]\n");
+         return 2;
+      }
+   }
+   if ((pairs == 0) || ((2 * pairs) > PTY_PORTS))
+   {
+      fprintf(stderr, "ptyd: 1 to %u pairs\n", PTY_PORTS / 2);
+      return 2;
+   }
+   signal(SIGINT, m_Signal);
+   signal(SIGTERM, m_Signal);
+   signal(SIGPIPE, SIG_IGN);
+   if (!m_Load(pairs, directory))
+   {
+      m_Unload();
+      return 1;
+   }
+   printf("ready\n");
+   fflush(stdout);
+
+   last = m_Now();
+   while (!m_Stop)
+   {
+      //the timer wheel needs a tick, while time-outs are pending only
+      int const timeout = host_PendingTimeOuts() ? WHEEL_PERIOD : -1;
+      int const num = epoll_wait(m_Epoll, events, PTY_EVENTS, timeout);
+      DWORD const now = m_Now();
+      int i;
+
+      if (now != last)
+      {
+         host_Run(now - last);
+         last = now;
+      }
+      for (i = 0; i < num; ++i)
+      {
+         PtyPort * const port = &m_Ports[events[i].data.u32];
+         if (events[i].events & EPOLLOUT)
+         {
+            if (m_Output(port))
+            {
+               m_Poll(port, port->inCount ? 0 : EPOLLIN);
+            }
+         }
+         if (events[i].events & (EPOLLIN | EPOLLHUP))
+         {
+            m_Input(port);
+         }
+      }
+      host_RunEvents();
+      m_DrainReady();
+   }
+   m_Unload();
+   return 0;
+}
@@ -0,0 +1,566 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host replayer of recorded port function calls (cf. MXVCP_CAPTURE_CALLS).
+
+   A capture file with call records (recorded on Windows 95 or on the host) is
+   replayed into the port functions of this build of the driver (src/driver.c),
+   on top of the VxD service stand-ins of hostwrap.c. The calls are issued in
+   their recorded order, at their recorded time. The time is virtual: the
+   time-outs of the driver expire in between as on the recording machine, but
+   the replay runs at full speed.
+
+   The result of each call (return value, value returned by reference, last
+   error, checksum of the read data, number of callbacks since the previous
+   call) is compared with the recording. With -o, the results are written to a
+   file; with -c, they are compared with such a file of another build.
+
+   usage: replay [-p A,B]... [-v PORT:Name=Value]... [-o results] [-c results] capture
+
+   -p   port pair. the pairs are added in the order of the port indices on the
+        recording machine (default: COM1,COM2)
+   -v   registry value of a port (DWORD, if the value is a number, else string)
+
+   The exit code is 1, if a result differs.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define REPLAY_PAIRS    (64)        //max. number of port pairs
+#define REPLAY_VALUES   (64)        //max. number of registry values
+#define REPLAY_PORTS    (256)       //port indices of a record (BYTE)
+#define REPORT_MAX      (10)        //max. number of reported differences per comparison
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//a recorded call, with its data (continuation records appended)
+typedef struct _ReplayCall
+{
+   DWORD time;
+   DWORD port;
+   MxvcpCallRecord call;
+   BYTE * data;
+   DWORD length;
+} ReplayCall;
+
+//result of a call
+typedef struct _ReplayResult
+{
+   DWORD function;
+   DWORD result;
+   DWORD out;
+   DWORD error;
+   DWORD crc;              //CRC-32 of the read data (0 if none)
+   DWORD callbacks;        //number of callbacks since the previous call (not recorded)
+} ReplayResult;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static ReplayCall * m_Calls;
+static DWORD m_CallCount;
+static PortInformation * m_Port[REPLAY_PORTS];     //open ports by port index
+static DWORD m_EventRegister[REPLAY_PORTS];        //event DWORDs of the ports (cf. SetEventMask)
+static BYTE m_Shadow[REPLAY_PORTS];                //modem status shadows of the ports
+static DWORD m_Callbacks;
+static BYTE * m_Buffer;
+static DWORD m_BufferSize;
+
+static const char * const m_Names[] =
+{
+   "SetCommState", "GetCommState", "Setup", "TransmitChar", "Close", "GetQueueStatus", "ClearError",
+   "SetModemStatusShadow", "GetProperties", "EscapeFunction", "Purge", "SetEventMask", "GetEventMask",
+   "Write", "Read", "EnableNotification", "SetReadCallback", "SetWriteCallback", "GetModemStatus",
+   "GetCommConfig", "SetCommConfig", "GetWin32Error"
+};
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static double m_Now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static const char * m_Name(DWORD function)
+{
+   if (function == MXVCP_CALL_OPEN)
+   {
+      return "Open";
+   }
+   return (function < (sizeof(m_Names) / sizeof(m_Names[0]))) ? m_Names[function] : "?";
+}
+
+
+//a buffer of at least the given size
+static BYTE * m_GetBuffer(DWORD size)
+{
+   if (size > m_BufferSize)
+   {
+      m_Buffer = realloc(m_Buffer, size);
+      m_BufferSize = size;
+   }
+   return m_Buffer;
+}
+
+
+static void _cdecl m_Notify(PortInformation * hPort, DWORD lReferenceData, DWORD lEvent, DWORD lSubEvent)
+{
+   m_Callbacks++;
+}
+
+
+//load the call records of a capture file. return FALSE on error
+static BOOL m_Load(const char * path)
+{
+   long last[REPLAY_PORTS];
+   MxvcpCaptureHeader * header;
+   BYTE * file;
+   long size;
+   DWORD pos;
+   FILE * f = fopen(path, "rb");
+
+   if (f == NULL)
+   {
+      printf("replay: %s can't be opened\n", path);
+      return 0;
+   }
+   fseek(f, 0, SEEK_END);
+   size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   file = malloc(size > 0 ? size : 1);
+   if ((size < (long)sizeof(MxvcpCaptureHeader)) || (fread(file, 1, size, f) != (size_t)size))
+   {
+      printf("replay: %s can't be read\n", path);
+      fclose(f);
+      return 0;
+   }
+   fclose(f);
+   header = (MxvcpCaptureHeader *)file;
+   if ((header->magic != MXVCP_CAPTURE_MAGIC) || (header->version < 2) || (header->version > MXVCP_CAPTURE_VERSION))
+   {
+      printf("replay: %s is no capture file with call records\n", path);
+      return 0;
+   }
+   memset(last, -1, sizeof(last));
+   for (pos = sizeof(MxvcpCaptureHeader); (pos + sizeof(MxvcpRecordHeader)) <= (DWORD)size; )
+   {
+      MxvcpRecordHeader * const record = (MxvcpRecordHeader *)&file[pos];
+      BYTE * const payload = &file[pos + sizeof(MxvcpRecordHeader)];
+      DWORD const end = pos + sizeof(MxvcpRecordHeader) + record->length;
+      if (end > (DWORD)size)
+      {
+         break; //truncated
+      }
+      if ((record->direction == MXVCP_DIR_CALL) && (record->length >= sizeof(MxvcpCallRecord)))
+      {
+         ReplayCall * call;
+         if ((m_CallCount & 1023) == 0)
+         {
+            m_Calls = realloc(m_Calls, (m_CallCount + 1024) * sizeof(ReplayCall));
+         }
+         call = &m_Calls[m_CallCount];
+         call->time = record->time;
+         call->port = record->port;
+         memcpy(&call->call, payload, sizeof(MxvcpCallRecord));
+         call->length = record->length - sizeof(MxvcpCallRecord);
+         call->data = malloc(call->length + 1);
+         memcpy(call->data, payload + sizeof(MxvcpCallRecord), call->length);
+         last[record->port] = (long)m_CallCount++;
+      }
+      else if ((record->direction == MXVCP_DIR_CALL_DATA) && (last[record->port] >= 0))
+      {
+         ReplayCall * const call = &m_Calls[last[record->port]];
+         call->data = realloc(call->data, call->length + record->length);
+         memcpy(call->data + call->length, payload, record->length);
+         call->length += record->length;
+      }
+      pos = end;
+   }
+   free(file);
+   return 1;
+}
+
+
+//the open port of a port index. a port, that was opened before the capture started, is opened now
+static PortInformation * m_PortOf(DWORD port)
+{
+   if ((m_Port[port] == NULL) && (port < m_NextFreePort))
+   {
+      long error = 0;
+      m_Port[port] = host_OpenPort(m_PortInformation[port].portName, &error);
+   }
+   return m_Port[port];
+}
+
+
+//issue a recorded call. return FALSE, if it is not replayed
+static BOOL m_Execute(const ReplayCall * c, ReplayResult * r)
+{
+   DWORD const arg0 = c->call.arg[0];
+   DWORD const arg1 = c->call.arg[1];
+   PortInformation * hPort;
+   PortFunctionTable * f;
+   _DCB dcb;
+   _COMSTAT comstat;
+   _COMMPROP prop;
+   DWORD escape[64];
+   DWORD value = 0;
+   BYTE * buffer;
+
+   memset(r, 0, sizeof(*r));
+   memset(&dcb, 0, sizeof(dcb));
+   memset(&comstat, 0, sizeof(comstat));
+   memset(escape, 0, sizeof(escape));
+   r->function = c->call.function;
+   if (c->call.function == MXVCP_CALL_OPEN)
+   {
+      long error = 0;
+      char name[PORTNAME_LENGTH + 1];
+      memset(name, 0, sizeof(name));
+      memcpy(name, c->data, (c->length < PORTNAME_LENGTH) ? c->length : PORTNAME_LENGTH);
+      m_Port[c->port] = host_OpenPort(name, &error);
+      r->result = (m_Port[c->port] != NULL);
+      r->error = m_Port[c->port] ? m_Port[c->port]->portData.dwLastError : (DWORD)error;
+      return 1;
+   }
+   hPort = m_PortOf(c->port);
+   if (hPort == NULL)
+   {
+      return 0;
+   }
+   f = (PortFunctionTable *)hPort->portData.PDfunctions;
+   if ((c->call.function == MXVCP_CALL_SET_COMM_STATE) || (c->call.function == MXVCP_CALL_SET_COMM_CONFIG))
+   {
+      memcpy(&dcb, c->data, (c->length < sizeof(dcb)) ? c->length : sizeof(dcb));
+   }
+   switch (c->call.function)
+   {
+   case MXVCP_CALL_SET_COMM_STATE:
+      r->result = f->pPortSetCommState(hPort, &dcb, arg0);
+      break;
+   case MXVCP_CALL_GET_COMM_STATE:
+      r->result = f->pPortGetCommState(hPort, &dcb);
+      break;
+   case MXVCP_CALL_SETUP:
+      r->result = f->pPortSetup(hPort, NULL, arg0, NULL, arg1);
+      break;
+   case MXVCP_CALL_TRANSMIT_CHAR:
+      r->result = f->pPortTransmitChar(hPort, arg0);
+      break;
+   case MXVCP_CALL_CLOSE:
+      r->result = f->pPortClose(hPort);
+      break;
+   case MXVCP_CALL_GET_QUEUE_STATUS:
+      r->result = f->pPortGetQueueStatus(hPort, &comstat);
+      r->out = comstat.cbInque;
+      break;
+   case MXVCP_CALL_CLEAR_ERROR:
+      r->result = f->pPortClearError(hPort, &comstat, &value);
+      r->out = value;
+      break;
+   case MXVCP_CALL_SET_MODEM_STATUS_SHADOW:
+      r->result = f->pPortSetModemStatusShadow(hPort, arg0, &m_Shadow[c->port]);
+      break;
+   case MXVCP_CALL_GET_PROPERTIES:
+      r->result = f->pPortGetProperties(hPort, &prop);
+      break;
+   case MXVCP_CALL_ESCAPE_FUNCTION:
+      //capture and replay need the files of the recording machine
+      if ((arg0 >= MXVCP_ESC_CAPTURE_START) && (arg0 <= MXVCP_ESC_REPLAY_STOP))
+      {
+         return 0;
+      }
+      r->result = f->pPortEscapeFunction(hPort, arg0, arg1, escape);
+      break;
+   case MXVCP_CALL_PURGE:
+      r->result = f->pPortPurge(hPort, arg0);
+      break;
+   case MXVCP_CALL_SET_EVENT_MASK:
+      r->result = f->pPortSetEventMask(hPort, arg0, &m_EventRegister[c->port]);
+      r->out = m_EventRegister[c->port];
+      break;
+   case MXVCP_CALL_GET_EVENT_MASK:
+      r->result = f->pPortGetEventMask(hPort, arg0, &value);
+      r->out = value;
+      break;
+   case MXVCP_CALL_WRITE:
+      //the recorded data, resp. zeros for the part, that wasn't written on the recording machine
+      buffer = m_GetBuffer(arg0 + 1);
+      memset(buffer, 0, arg0);
+      memcpy(buffer, c->data, (c->length < arg0) ? c->length : arg0);
+      r->result = f->pPortWrite(hPort, buffer, arg0, &value);
+      r->out = value;
+      break;
+   case MXVCP_CALL_READ:
+      buffer = m_GetBuffer(arg0 + 1);
+      r->result = f->pPortRead(hPort, buffer, arg0, &value);
+      r->out = value;
+      r->crc = value ? crc_crc32(CRC32_INIT, buffer, value) : 0;
+      break;
+   case MXVCP_CALL_ENABLE_NOTIFICATION:
+      r->result = f->pPortEnableNotification(hPort, arg0 ? m_Notify : NULL, c->port);
+      break;
+   case MXVCP_CALL_SET_READ_CALLBACK:
+      r->result = f->pPortSetReadCallback(hPort, (long)arg0, arg1 ? m_Notify : NULL, c->port);
+      break;
+   case MXVCP_CALL_SET_WRITE_CALLBACK:
+      r->result = f->pPortSetWriteCallback(hPort, (long)arg0, arg1 ? m_Notify : NULL, c->port);
+      break;
+   case MXVCP_CALL_GET_MODEM_STATUS:
+      r->result = f->pPortGetModemStatus(hPort, &value);
+      r->out = value;
+      break;
+   case MXVCP_CALL_GET_COMM_CONFIG:
+      value = sizeof(dcb);
+      r->result = f->pPortGetCommConfig(hPort, &dcb, &value);
+      break;
+   case MXVCP_CALL_SET_COMM_CONFIG:
+      value = sizeof(dcb);
+      r->result = f->pPortSetCommConfig(hPort, &dcb, &value);
+      break;
+   case MXVCP_CALL_GET_WIN32_ERROR:
+      r->result = f->pPortGetWin32Error(hPort, &value);
+      r->out = value;
+      break;
+   default:
+      return 0;
+   }
+   r->error = hPort->portData.dwLastError;
+   return 1;
+}
+
+
+//the result, as it was recorded
+static void m_Recorded(const ReplayCall * c, ReplayResult * r)
+{
+   memset(r, 0, sizeof(*r));
+   r->function = c->call.function;
+   r->result = c->call.result;
+   r->out = c->call.out;
+   r->error = c->call.error;
+   if ((c->call.function == MXVCP_CALL_READ) && c->call.out)
+   {
+      //(a record, dropped on the recording machine, makes the data incomplete)
+      r->crc = crc_crc32(CRC32_INIT, c->data, (c->length < c->call.out) ? c->length : c->call.out);
+   }
+}
+
+
+//compare two results. return TRUE, if they differ (and report the first differences)
+static BOOL m_Differ(const char * other, DWORD index, const ReplayResult * a, const ReplayResult * b, BOOL callbacks,
+                     DWORD * reported)
+{
+   if ((a->function == b->function) && (a->result == b->result) && (a->out == b->out) && (a->error == b->error) &&
+       (a->crc == b->crc) && (!callbacks || (a->callbacks == b->callbacks)))
+   {
+      return 0;
+   }
+   if ((*reported)++ < REPORT_MAX)
+   {
+      printf("call %u (%s): result %u/%u, out %u/%u, error %u/%u, crc %08x/%08x, callbacks %u/%u (replay/%s)\n",
+             index, m_Name(a->function), a->result, b->result, a->out, b->out, a->error, b->error,
+             a->crc, b->crc, a->callbacks, callbacks ? b->callbacks : 0, other);
+   }
+   return 1;
+}
+
+
+//load the driver and add the ports of the pairs (with their registry values)
+static void m_AddPorts(char ** pairs, DWORD pairCount, char ** values, DWORD valueCount)
+{
+   char name[2][PORTNAME_LENGTH];
+   DWORD p;
+   DWORD v;
+   int i;
+
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   for (p = 0; p < pairCount; ++p)
+   {
+      char * const comma = strchr(pairs[p], ',');
+      if (comma == NULL)
+      {
+         continue;
+      }
+      snprintf(name[0], sizeof(name[0]), "%.*s", (int)(comma - pairs[p]), pairs[p]);
+      snprintf(name[1], sizeof(name[1]), "%s", comma + 1);
+      for (i = 0; i < 2; ++i)
+      {
+         DWORD const devNode = 2 * p + i + 1;
+         host_RegistryString(devNode, "PairPortName", name[i ^ 1]);
+         for (v = 0; v < valueCount; ++v)
+         {
+            char valueName[64];
+            char * const colon = strchr(values[v], ':');
+            char * equal;
+            char * end;
+            unsigned long number;
+            if ((colon == NULL) || ((DWORD)(colon - values[v]) != strlen(name[i])) ||
+                (strncmp(values[v], name[i], colon - values[v]) != 0) || ((equal = strchr(colon, '=')) == NULL))
+            {
+               continue;
+            }
+            snprintf(valueName, sizeof(valueName), "%.*s", (int)(equal - colon - 1), colon + 1);
+            number = strtoul(equal + 1, &end, 0);
+            if ((*end == 0) && (end != (equal + 1)))
+            {
+               host_RegistryDword(devNode, valueName, (DWORD)number);
+            }
+            else
+            {
+               host_RegistryString(devNode, valueName, equal + 1);
+            }
+         }
+      }
+      host_AddDevice(2 * p + 1, name[0]);
+      host_AddDevice(2 * p + 2, name[1]);
+   }
+}
+
+
+int main(int argc, char ** argv)
+{
+   static char defaultPair[] = "COM1,COM2";
+   char * pairs[REPLAY_PAIRS];
+   char * values[REPLAY_VALUES];
+   DWORD pairCount = 0;
+   DWORD valueCount = 0;
+   char * output = NULL;
+   char * compare = NULL;
+   FILE * out = NULL;
+   FILE * in = NULL;
+   DWORD recordedDiffs = 0;
+   DWORD compareDiffs = 0;
+   DWORD reportedRecorded = 0;
+   DWORD reportedCompare = 0;
+   DWORD skipped = 0;
+   DWORD start = 0;
+   DWORD i;
+   double elapsed;
+   int a;
+
+   for (a = 1; a < (argc - 1); ++a)
+   {
+      if ((strcmp(argv[a], "-p") == 0) && (pairCount < REPLAY_PAIRS))
+      {
+         pairs[pairCount++] = argv[++a];
+      }
+      else if ((strcmp(argv[a], "-v") == 0) && (valueCount < REPLAY_VALUES))
+      {
+         values[valueCount++] = argv[++a];
+      }
+      else if (strcmp(argv[a], "-o") == 0)
+      {
+         output = argv[++a];
+      }
+      else if (strcmp(argv[a], "-c") == 0)
+      {
+         compare = argv[++a];
+      }
+      else
+      {
+         break;
+      }
+   }
+   if (a != (argc - 1))
+   {
+      printf("usage: replay [-p A,B]... [-v PORT:Name=Value]... [-o results] [-c results] capture\n");
+      return 2;
+   }
+   if (!m_Load(argv[a]))
+   {
+      return 2;
+   }
+   if (pairCount == 0)
+   {
+      pairs[pairCount++] = defaultPair;
+   }
+   if ((output && ((out = fopen(output, "w")) == NULL)) || (compare && ((in = fopen(compare, "r")) == NULL)))
+   {
+      printf("replay: %s can't be opened\n", (output && (out == NULL)) ? output : compare);
+      return 2;
+   }
+   //the time of the recording machine
+   if (m_CallCount)
+   {
+      start = m_Calls[0].time;
+      host_time = start;
+   }
+   m_AddPorts(pairs, pairCount, values, valueCount);
+
+   elapsed = m_Now();
+   for (i = 0; i < m_CallCount; ++i)
+   {
+      const ReplayCall * const c = &m_Calls[i];
+      ReplayResult result;
+      ReplayResult recorded;
+      //the time-outs, that expired before the call on the recording machine
+      if ((LONG)(c->time - host_time) > 0)
+      {
+         host_Run(c->time - host_time);
+      }
+      if (!m_Execute(c, &result))
+      {
+         skipped++;
+         continue;
+      }
+      host_RunEvents();
+      result.callbacks = m_Callbacks;
+      m_Callbacks = 0;
+      m_Recorded(c, &recorded);
+      recordedDiffs += m_Differ("recorded", i, &result, &recorded, 0, &reportedRecorded);
+      if (out)
+      {
+         fprintf(out, "%u %u %u %u %u %08x %u\n", i, result.function, result.result, result.out, result.error,
+                 result.crc, result.callbacks);
+      }
+      if (in)
+      {
+         ReplayResult other;
+         unsigned int index;
+         if (fscanf(in, "%u %u %u %u %u %x %u", &index, &other.function, &other.result, &other.out, &other.error,
+                    &other.crc, &other.callbacks) != 7)
+         {
+            printf("replay: %s ends before call %u\n", compare, i);
+            compareDiffs++;
+            fclose(in);
+            in = NULL;
+         }
+         else
+         {
+            compareDiffs += (index != i) || m_Differ(compare, i, &result, &other, 1, &reportedCompare);
+         }
+      }
+   }
+   elapsed = m_Now() - elapsed;
+
+   if (out)
+   {
+      fclose(out);
+   }
+   if (in)
+   {
+      fclose(in);
+   }
+   printf("replay: %u calls (%u skipped), %u s recorded, replayed in %.3f s (%.0f calls/s)\n",
+          m_CallCount, skipped, m_CallCount ? (m_Calls[m_CallCount - 1].time - start) / 1000 : 0,
+          elapsed, (elapsed > 0) ? ((m_CallCount - skipped) / elapsed) : 0);
+   printf("replay: %u calls differ from the recording", recordedDiffs);
+   if (compare)
+   {
+      printf(", %u from %s", compareDiffs, compare);
+   }
+   printf("\n");
+   return (recordedDiffs != 0) || (compareDiffs != 0);
+}
@@ -0,0 +1,192 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host test of the recording of port function calls (MXVCP_CAPTURE_CALLS).
+
+   A session of a pair is recorded into test_capture.mxc: the ports are opened
+   before the capture starts, blocks of data are written and read (also more
+   than fits into a record), with time-outs in between. The test checks the
+   records of the file: no record exceeds MXVCP_RECORD_CHUNK bytes of data, a
+   write call holds the written data only, and the data of a large read is
+   continued completely. "make test" replays the file afterwards (replay.c).
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define CAPTURE_FILE    "test_capture.mxc"
+#define BLOCKS          (50)        //number of small blocks
+#define BLOCK_SIZE      (300)
+#define LARGE_SIZE      (20000)     //size of the large write and read (more than the fifo takes)
+
+#define CHECK(cond, ...)   m_Checks++; if (!(cond)) { m_Failures++; if (m_Failures < 20) { printf(__VA_ARGS__); printf("\n"); } }
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned int m_Failures;
+static unsigned int m_Checks;
+static DWORD m_RxCallbacks;
+static BYTE m_Data[LARGE_SIZE];
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static PortFunctionTable * m_Functions(PortInformation * hPort)
+{
+   return (PortFunctionTable *)hPort->portData.PDfunctions;
+}
+
+
+static void _cdecl m_RxCallback(PortInformation * hPort, DWORD lReferenceData, DWORD lEvent, DWORD lSubEvent)
+{
+   m_RxCallbacks++;
+}
+
+
+//record the session. return the number of bytes of the large write resp. read
+static void m_Record(PortInformation * com1, PortInformation * com2, DWORD * largeWritten, DWORD * largeRead)
+{
+   _DCB dcb;
+   _COMSTAT comstat;
+   DWORD num;
+   unsigned int i;
+
+   CHECK(m_Functions(com1)->pPortEscapeFunction(com1, MXVCP_ESC_CAPTURE_START, MXVCP_CAPTURE_CALLS, NULL),
+         "capture can't be started");
+   m_Functions(com2)->pPortGetCommState(com2, &dcb);
+   dcb.BaudRate = 19200;
+   m_Functions(com2)->pPortSetCommState(com2, &dcb, 0xFFFFFFFF);
+   m_Functions(com2)->pPortSetReadCallback(com2, 100, m_RxCallback, 2);
+   for (i = 0; i < sizeof(m_Data); ++i)
+   {
+      m_Data[i] = (BYTE)(i * 7);
+   }
+   for (i = 0; i < BLOCKS; ++i)
+   {
+      m_Functions(com1)->pPortWrite(com1, &m_Data[i], BLOCK_SIZE, &num);
+      host_Run(10 + (i % 7) * 10); //the rx interval expires now and then
+      m_Functions(com2)->pPortGetQueueStatus(com2, &comstat);
+      m_Functions(com2)->pPortRead(com2, m_Data, (i % 3) ? 512 : 100, &num);
+   }
+   m_Functions(com2)->pPortPurge(com2, 1);
+
+   //more than a record takes: the fifo grows under pressure (the slab grows by a global event)
+   for (i = 0; i < 32; ++i)
+   {
+      m_Functions(com1)->pPortWrite(com1, m_Data, 1024, &num);
+      host_Run(1);
+   }
+   m_Functions(com2)->pPortPurge(com2, 1);
+   m_Functions(com1)->pPortWrite(com1, m_Data, LARGE_SIZE, largeWritten);
+   host_Run(10);
+   m_Functions(com2)->pPortRead(com2, m_Data, LARGE_SIZE, largeRead);
+   host_Run(10);
+   m_Functions(com1)->pPortEscapeFunction(com1, MXVCP_ESC_CAPTURE_STOP, 0, NULL);
+   CHECK(m_Capture.dropped == 0, "%u records dropped", m_Capture.dropped);
+}
+
+
+//check the records of the capture file
+static void m_CheckFile(DWORD largeWritten, DWORD largeRead)
+{
+   static BYTE file[256 * 1024];
+   MxvcpCaptureHeader * const header = (MxvcpCaptureHeader *)file;
+   MxvcpCallRecord * call = NULL;
+   DWORD callData = 0;
+   DWORD calls = 0;
+   DWORD largeWriteData = 0;
+   DWORD largeReadData = 0;
+   size_t size;
+   DWORD pos;
+   FILE * f = fopen(CAPTURE_FILE, "rb");
+
+   CHECK(f != NULL, CAPTURE_FILE " not written");
+   if (f == NULL)
+   {
+      return;
+   }
+   size = fread(file, 1, sizeof(file), f);
+   fclose(f);
+   CHECK((size >= sizeof(*header)) && (header->magic == MXVCP_CAPTURE_MAGIC) && (header->version == MXVCP_CAPTURE_VERSION),
+         "no capture file of version %u", MXVCP_CAPTURE_VERSION);
+   for (pos = sizeof(*header); pos <= size; )
+   {
+      MxvcpRecordHeader * const record = (MxvcpRecordHeader *)&file[pos];
+      DWORD data = record->length;
+      if ((pos == size) || (record->direction == MXVCP_DIR_CALL))
+      {
+         //the data of the previous call is complete
+         if (call && (call->function == MXVCP_CALL_WRITE) && (call->arg[0] == LARGE_SIZE))
+         {
+            largeWriteData = callData;
+         }
+         if (call && (call->function == MXVCP_CALL_READ) && (call->arg[0] == LARGE_SIZE))
+         {
+            largeReadData = callData;
+         }
+         if ((pos + sizeof(MxvcpRecordHeader)) > size)
+         {
+            break;
+         }
+         call = (MxvcpCallRecord *)&file[pos + sizeof(*record)];
+         data -= sizeof(MxvcpCallRecord);
+         callData = data;
+         calls++;
+         CHECK((call->function != MXVCP_CALL_WRITE) || (data <= call->out),
+               "write call with %u bytes of data, %u written", data, call->out);
+      }
+      else if (record->direction == MXVCP_DIR_CALL_DATA)
+      {
+         callData += data;
+      }
+      CHECK(data <= MXVCP_RECORD_CHUNK, "record of %u bytes", data);
+      pos += sizeof(*record) + record->length;
+   }
+   CHECK(pos == size, "capture file truncated");
+   CHECK(calls > (3 * BLOCKS), "%u calls recorded", calls);
+   CHECK((largeWritten > MXVCP_RECORD_CHUNK) && (largeWritten < LARGE_SIZE), "large write of %u bytes", largeWritten);
+   CHECK(largeWriteData == largeWritten, "large write recorded with %u bytes (%u written)", largeWriteData, largeWritten);
+   CHECK((largeRead == largeWritten) && (largeReadData == largeRead), "large read recorded with %u bytes (%u read)",
+         largeReadData, largeRead);
+}
+
+
+int main(void)
+{
+   PortInformation * com1;
+   PortInformation * com2;
+   DWORD largeWritten = 0;
+   DWORD largeRead = 0;
+   long error = 0;
+
+   host_RegistryString(1, "PairPortName", "COM2");
+   host_RegistryString(1, "CaptureFile", CAPTURE_FILE);
+   host_RegistryString(2, "PairPortName", "COM1");
+   host_RegistryDword(2, "ReadIntervalTimeout", 20);
+   host_RegistryDword(2, "FifoSizeMax", FIFO_SIZE_MAX);
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   host_AddDevice(1, "COM1");
+   host_AddDevice(2, "COM2");
+   com1 = host_OpenPort("COM1", &error);
+   com2 = host_OpenPort("COM2", &error);
+   CHECK(com1 && com2, "ports can't be opened (error %ld)", error);
+   if (com1 && com2)
+   {
+      m_Record(com1, com2, &largeWritten, &largeRead);
+      m_CheckFile(largeWritten, largeRead);
+      m_Functions(com1)->pPortClose(com1);
+      m_Functions(com2)->pPortClose(com2);
+   }
+   host_Run(60 * 1000);
+   MXVCP_DeviceExit(Get_Sys_VM_Handle());
+   CHECK(host_heapBytes == 0, "%u bytes of heap not released", host_heapBytes);
+   CHECK(host_violations == 0, "%u services called at interrupt time or within a critical section", host_violations);
+   printf("test_capture: %u checks, %u failures\n", m_Checks, m_Failures);
+   return (m_Failures != 0);
+}
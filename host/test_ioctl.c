@@ -0,0 +1,331 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host test of the Win32 interface of the driver (src/driver.c): DeviceIoControl
+   calls, the shared ring and the statistics, published to System Monitor. Also the
+   span interface for ring 0 clients (MXVCP_ESC_GET_SPAN_API).
+
+   The test acts as VCOMM, as the Win32 clients (they call MXVCP_DeviceIOControl
+   with their process tag), as a ring 0 client and as System Monitor (host_PerfRead).
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define PROCESS_A       (0x1000)    //process tag of the first Win32 client
+#define PROCESS_B       (0x2000)    //process tag of another Win32 client
+
+#define CHECK(cond, ...)   m_Checks++; if (!(cond)) { m_Failures++; if (m_Failures < 20) { printf(__VA_ARGS__); printf("\n"); } }
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned int m_Failures;
+static unsigned int m_Checks;
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static PortFunctionTable * m_Functions(PortInformation * hPort)
+{
+   return (PortFunctionTable *)hPort->portData.PDfunctions;
+}
+
+
+static PortInformation * m_Open(char * portName)
+{
+   long error = 0;
+   PortInformation * const hPort = host_OpenPort(portName, &error);
+   CHECK(hPort != NULL, "%s can't be opened (error %ld)", portName, error);
+   return hPort;
+}
+
+
+static DWORD m_Write(PortInformation * hPort, const void * data, DWORD count)
+{
+   DWORD written = 0;
+   m_Functions(hPort)->pPortWrite(hPort, (void *)data, count, &written);
+   return written;
+}
+
+
+static DWORD m_Read(PortInformation * hPort, void * data, DWORD count)
+{
+   DWORD received = 0;
+   m_Functions(hPort)->pPortRead(hPort, data, count, &received);
+   return received;
+}
+
+
+//DeviceIoControl of a Win32 client. return the win32 error code
+static DWORD m_Ioctl(DWORD process, DWORD code, void * in, DWORD cbIn, void * out, DWORD cbOut, DWORD * returned)
+{
+   DIOCPARAMETERS params;
+   memset(&params, 0, sizeof(params));
+   params.dwIoControlCode = code;
+   params.lpvInBuffer = (DIOCADDRESS)in;
+   params.cbInBuffer = cbIn;
+   params.lpvOutBuffer = (DIOCADDRESS)out;
+   params.cbOutBuffer = cbOut;
+   params.lpcbBytesReturned = (DIOCADDRESS)returned;
+   params.tagProcess = process;
+   host_process = process;
+   return MXVCP_DeviceIOControl(&params);
+}
+
+
+//value of a statistic of a port, as System Monitor reads it
+static DWORD m_Stat(char * portName, char * item)
+{
+   char name[PERF_NAME_LENGTH];
+   DWORD value = 0;
+   snprintf(name, sizeof(name), "%s %s", portName, item);
+   CHECK(host_PerfRead(name, &value), "statistic \"%s\" isn't registered", name);
+   return value;
+}
+
+
+//load the driver with the pair COM1-COM2
+static void m_Load(void)
+{
+   host_perfLoaded = 1;
+   host_RegistryString(1, "PairPortName", "COM2");
+   host_RegistryString(2, "PairPortName", "COM1");
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   CHECK(host_carry == 0, "driver can't be loaded");
+   host_AddDevice(1, "COM1");
+   host_AddDevice(2, "COM2");
+}
+
+
+//the rx fifo fill is published as statistic, also while the rx fifo is a shared ring
+static void m_TestRxFillStat(PortInformation * com1, PortInformation * com2)
+{
+   BYTE data[256];
+   MxvcpRing * ring = NULL;
+   MxvcpRingSignal signal;
+   DWORD returned = 0;
+   DWORD bytesRead;
+
+   memset(data, 0x55, sizeof(data));
+   bytesRead = m_Stat("COM2", "Bytes read");
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 0, "COM2: rx fifo fill not 0 after open");
+   m_Write(com1, data, 100);
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 100, "COM2: rx fifo fill %u (expected 100)", m_Stat("COM2", "Rx fifo fill"));
+   CHECK(m_Read(com2, data, 30) == 30, "COM2: 30 bytes expected");
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 70, "COM2: rx fifo fill %u (expected 70)", m_Stat("COM2", "Rx fifo fill"));
+
+   //the rx fifo moves into the shared arena
+   CHECK(m_Ioctl(PROCESS_A, MXVCP_IOCTL_RING_MAP, "COM2", 4, &ring, sizeof(ring), &returned) == ERROR_SUCCESS,
+         "COM2: ring can't be mapped");
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 70, "COM2: rx fifo fill %u after ring map (expected 70)", m_Stat("COM2", "Rx fifo fill"));
+   m_Write(com1, data, 10);
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 80, "COM2: rx fifo fill %u of the shared ring (expected 80)", m_Stat("COM2", "Rx fifo fill"));
+
+   //the client consumes from the ring, and signals it
+   memset(&signal, 0, sizeof(signal));
+   strcpy(signal.portName, "COM2");
+   signal.consumed = 50;
+   CHECK(m_Ioctl(PROCESS_A, MXVCP_IOCTL_RING_SIGNAL, &signal, sizeof(signal), NULL, 0, &returned) == ERROR_SUCCESS,
+         "COM2: ring signal failed");
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 30, "COM2: rx fifo fill %u after the client read (expected 30)", m_Stat("COM2", "Rx fifo fill"));
+   CHECK(m_Read(com2, data, sizeof(data)) == 30, "COM2: 30 bytes expected");
+   CHECK(m_Stat("COM2", "Rx fifo fill") == 0, "COM2: rx fifo fill %u (expected 0)", m_Stat("COM2", "Rx fifo fill"));
+   CHECK((m_Stat("COM2", "Bytes read") - bytesRead) == 110, "COM2: %u bytes read (expected 110)", m_Stat("COM2", "Bytes read") - bytesRead);
+}
+
+
+//signal of a shared ring by a client. return the win32 error code
+static DWORD m_RingSignal(DWORD process, char * portName, DWORD produced, DWORD consumed)
+{
+   MxvcpRingSignal signal;
+   DWORD returned = 0;
+   memset(&signal, 0, sizeof(signal));
+   strcpy(signal.portName, portName);
+   signal.produced = produced;
+   signal.consumed = consumed;
+   return m_Ioctl(process, MXVCP_IOCTL_RING_SIGNAL, &signal, sizeof(signal), NULL, 0, &returned);
+}
+
+
+//the shared ring: only the header with the indices is shared, the driver checks the numbers of the client.
+//only the process, that opened the port, maps and signals the ring
+static void m_TestRing(PortInformation * com1, PortInformation * com2)
+{
+   BYTE data[256];
+   MxvcpRing * ring1 = NULL;
+   MxvcpRing * ring2 = NULL;
+   DWORD returned = 0;
+   DWORD i;
+
+   CHECK(m_Ioctl(PROCESS_B, MXVCP_IOCTL_RING_MAP, "COM1", 4, &ring1, sizeof(ring1), &returned) == ERROR_ACCESS_DENIED,
+         "COM1: ring mapped by another process");
+   CHECK(m_Ioctl(PROCESS_A, MXVCP_IOCTL_RING_MAP, "COM1", 4, &ring1, sizeof(ring1), &returned) == ERROR_SUCCESS,
+         "COM1: ring can't be mapped");
+   CHECK(m_Ioctl(PROCESS_A, MXVCP_IOCTL_RING_MAP, "COM2", 4, &ring2, sizeof(ring2), &returned) == ERROR_SUCCESS,
+         "COM2: ring can't be mapped");
+   if ((ring1 == NULL) || (ring2 == NULL))
+   {
+      return;
+   }
+   CHECK((ring1->size == com1->rxFifo->QxSize) && (ring1->count == 0), "COM1: ring header %u/%u", ring1->size, ring1->count);
+
+   //the client produces into the ring of COM1 (data from COM2)
+   for (i = 0; i < 100; ++i)
+   {
+      MXVCP_RING_DATA(ring1)[(ring1->put + i) % ring1->size] = (BYTE)i;
+   }
+   CHECK(m_RingSignal(PROCESS_B, "COM1", 100, 0) == ERROR_ACCESS_DENIED, "COM1: ring signalled by another process");
+   CHECK(m_RingSignal(PROCESS_A, "COM1", ring1->size + 1, 0) == ERROR_INVALID_PARAMETER, "COM1: ring overfilled");
+   CHECK(m_RingSignal(PROCESS_A, "COM1", 100, 0) == ERROR_SUCCESS, "COM1: ring signal failed");
+   CHECK(ring1->count == 100, "COM1: ring count %u (expected 100)", ring1->count);
+   CHECK(m_Read(com1, data, sizeof(data)) == 100, "COM1: 100 bytes expected");
+   for (i = 0; i < 100; ++i)
+   {
+      CHECK(data[i] == (BYTE)i, "COM1: byte %u is %u", i, data[i]);
+   }
+   CHECK((ring1->count == 0) && (ring1->get == ring1->put), "COM1: ring header not published after read");
+
+   //a client, that corrupts the header, can't make the driver consume more than there is
+   m_Write(com1, data, 20);
+   CHECK(ring2->count == 20, "COM2: ring count %u (expected 20)", ring2->count);
+   ring2->count = 0xFFFFFFF0;
+   ring2->get = 0x7FFFFFF0;
+   CHECK(m_RingSignal(PROCESS_A, "COM2", 0, 30) == ERROR_INVALID_PARAMETER, "COM2: more consumed than there is");
+   CHECK(ring2->count == 20, "COM2: corrupted ring header not restored");
+   CHECK(m_RingSignal(PROCESS_A, "COM2", 0, 20) == ERROR_SUCCESS, "COM2: ring signal failed");
+   CHECK(m_FifoCount(com2) == 0, "COM2: %u bytes left in the rx fifo", m_FifoCount(com2));
+   CHECK(ring2->count == 0, "COM2: ring count %u (expected 0)", ring2->count);
+}
+
+
+//a batch of transfers, on the ports of the calling process only, with valid buffers only
+static void m_TestTransfer(PortInformation * com1, PortInformation * com2)
+{
+   BYTE data[64];
+   BYTE received[64];
+   MxvcpTransfer transfer[4];
+   MxvcpTransferResult result[4];
+   DWORD returned = 0;
+   DWORD i;
+
+   for (i = 0; i < sizeof(data); ++i)
+   {
+      data[i] = (BYTE)(i * 7);
+   }
+   memset(received, 0, sizeof(received));
+   memset(transfer, 0, sizeof(transfer));
+   strcpy(transfer[0].portName, "COM1");
+   transfer[0].operation = MXVCP_TRANSFER_WRITE;
+   transfer[0].buffer = data;
+   transfer[0].length = sizeof(data);
+   strcpy(transfer[1].portName, "COM2");
+   transfer[1].operation = MXVCP_TRANSFER_READ;
+   transfer[1].buffer = (void *)0x1000;   //not in the private arena
+   transfer[1].length = sizeof(received);
+   strcpy(transfer[2].portName, "COM2");
+   transfer[2].operation = MXVCP_TRANSFER_READ;
+   transfer[2].buffer = received;
+   transfer[2].length = sizeof(received);
+   strcpy(transfer[3].portName, "COM3");
+   transfer[3].operation = MXVCP_TRANSFER_READ;
+   transfer[3].buffer = received;
+   transfer[3].length = sizeof(received);
+   CHECK(m_Ioctl(PROCESS_A, MXVCP_IOCTL_TRANSFER, transfer, sizeof(transfer), result, sizeof(result), &returned) == ERROR_SUCCESS,
+         "transfer failed");
+   CHECK((result[0].error == 0) && (result[0].count == sizeof(data)), "transfer: write %u bytes, error %ld", result[0].count, result[0].error);
+   CHECK((result[1].error == IE_DEFAULT) && (result[1].count == 0), "transfer: invalid buffer accepted");
+   CHECK((result[2].error == 0) && (result[2].count == sizeof(data)) && (memcmp(data, received, sizeof(data)) == 0),
+         "transfer: read %u bytes, error %ld", result[2].count, result[2].error);
+   CHECK(result[3].error == IE_NOPEN, "transfer: unknown port accepted");
+   CHECK(host_userLocks == 0, "transfer: %u user buffers left locked", host_userLocks);
+
+   //another process must not access the ports
+   m_Write(com1, data, 10);
+   transfer[0] = transfer[2];
+   CHECK(m_Ioctl(PROCESS_B, MXVCP_IOCTL_TRANSFER, transfer, sizeof(MxvcpTransfer), result, sizeof(MxvcpTransferResult), &returned) == ERROR_SUCCESS,
+         "transfer of another process failed");
+   CHECK((result[0].error == IE_NOPEN) && (result[0].count == 0), "transfer: port of another process accessed");
+   CHECK(m_Read(com2, received, sizeof(received)) == 10, "COM2: 10 bytes expected");
+
+   //the arrays must be committed memory too
+   host_userLockFail = 2;
+   CHECK(m_Ioctl(PROCESS_A, MXVCP_IOCTL_TRANSFER, transfer, sizeof(MxvcpTransfer), result, sizeof(MxvcpTransferResult), &returned) == ERROR_INVALID_PARAMETER,
+         "transfer: uncommitted result array accepted");
+   CHECK(host_userLocks == 0, "transfer: %u user buffers left locked", host_userLocks);
+   host_userLockFail = 0;
+}
+
+
+//reserved space is published where it was reserved, other writers are held off meanwhile
+static void m_TestSpan(PortInformation * com1, PortInformation * com2)
+{
+   MxvcpSpanApi api;
+   MxvcpSpan span[2];
+   BYTE data[16];
+   DWORD reserved;
+
+   memset(&api, 0, sizeof(api));
+   CHECK(m_Functions(com1)->pPortEscapeFunction(com1, MXVCP_ESC_GET_SPAN_API, 0, (DWORD *)&api) && (api.reserve != NULL),
+         "span: interface not returned");
+   if (api.reserve == NULL)
+   {
+      return;
+   }
+   m_Functions(com2)->pPortPurge(com2, 1); //receive queue
+   reserved = api.reserve(api.port, 8, span);
+   CHECK(reserved == 8, "span: %u bytes reserved", reserved);
+   memcpy(span[0].data, "spandata", span[0].length);
+   memcpy(span[1].data, "spandata" + span[0].length, span[1].length);
+   CHECK(api.reserve(api.port, 8, span) == 0, "span: second reservation granted");
+   CHECK(m_Write(com1, "xyz", 3) == 0, "span: write into the reserved fifo accepted");
+   api.publish(api.port, 100); //more than reserved
+   CHECK(m_Read(com2, data, sizeof(data)) == 8, "span: not the reserved number of bytes published");
+   CHECK(memcmp(data, "spandata", 8) == 0, "span: data not published at the reserved offset");
+   CHECK(m_Write(com1, "xyz", 3) == 3, "span: write refused after publish");
+   CHECK(m_Read(com2, data, sizeof(data)) == 3, "span: data written after publish lost");
+
+   //a purge voids the reservation
+   reserved = api.reserve(api.port, 4, span);
+   CHECK(reserved == 4, "span: %u bytes reserved", reserved);
+   m_Functions(com2)->pPortPurge(com2, 1);
+   api.publish(api.port, 4);
+   CHECK(m_Read(com2, data, sizeof(data)) == 0, "span: purged reservation published");
+}
+
+
+int main(void)
+{
+   PortInformation * com1;
+   PortInformation * com2;
+   DWORD value;
+
+   m_Load();
+   host_process = PROCESS_A;
+   com1 = m_Open("COM1");
+   com2 = m_Open("COM2");
+   if ((com1 == NULL) || (com2 == NULL))
+   {
+      printf("test_ioctl: %u checks, %u failures\n", m_Checks, m_Failures);
+      return 1;
+   }
+   m_TestTransfer(com1, com2);
+   m_TestRxFillStat(com1, com2);
+   m_TestRing(com1, com2);
+   m_TestSpan(com1, com2);
+
+   m_Functions(com1)->pPortClose(com1);
+   m_Functions(com2)->pPortClose(com2);
+   host_Run(60 * 1000);
+   MXVCP_DeviceExit(Get_Sys_VM_Handle());
+   CHECK(!host_PerfRead("COM2 Rx fifo fill", &value), "statistics still registered after unload");
+   CHECK(host_heapBytes == 0, "%u bytes of heap not released", host_heapBytes);
+   CHECK(host_violations == 0, "%u services called at interrupt time or within a critical section", host_violations);
+   printf("test_ioctl: %u checks, %u failures\n", m_Checks, m_Failures);
+   return (m_Failures != 0);
+}
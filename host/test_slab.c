@@ -0,0 +1,251 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host test of the slab allocator (src/slab.c).
+
+   The heap is the stand-in of hostwrap.c, which can simulate a shortage of
+   memory. Every allocated object is filled with a pattern of its own, that is
+   verified when it is freed, so that overlapping objects are detected.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostwrap.h"
+#include "slab.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define MAX_OBJECTS     (1024)      //max. number of objects alive at once
+#define RANDOM_OBJECTS  (12)        //max. number of objects alive at once in the random test (below the limits of the classes)
+
+#define CHECK(cond, ...)   m_Checks++; if (!(cond)) { m_Failures++; if (m_Failures < 20) { printf(__VA_ARGS__); printf("\n"); } }
+
+
+/* -- Types --------------------------------------------------------------- */
+typedef struct _TestObject
+{
+   unsigned char * memory;
+   DWORD size;
+   unsigned char pattern;
+} TestObject;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned int m_Failures;
+static unsigned int m_Checks;
+static TestObject m_Object[MAX_OBJECTS];
+static unsigned int m_Objects;
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//allocate an object (growing the size class, if grow is set) and fill it with its pattern.
+//return FALSE if there was none
+static BOOL m_AllocGrow(DWORD size, BOOL grow)
+{
+   TestObject * const object = &m_Object[m_Objects];
+   object->memory = grow ? slab_alloc_grow(size) : slab_alloc(size);
+   if (object->memory == NULL)
+   {
+      return 0;
+   }
+   CHECK(((size_t)object->memory & 3) == 0, "object %p of size %u is not aligned", object->memory, size);
+   object->size = size;
+   object->pattern = (unsigned char)(m_Objects * 37 + 11);
+   memset(object->memory, object->pattern, size);
+   m_Objects++;
+   return 1;
+}
+
+
+static BOOL m_Alloc(DWORD size)
+{
+   return m_AllocGrow(size, 0);
+}
+
+
+//verify the pattern of an object and free it
+static void m_Free(unsigned int index)
+{
+   TestObject * const object = &m_Object[index];
+   DWORD i;
+   for (i = 0; i < object->size; ++i)
+   {
+      if (object->memory[i] != object->pattern)
+      {
+         break;
+      }
+   }
+   CHECK(i == object->size, "object %u (size %u) was overwritten at offset %u", index, object->size, i);
+   slab_free(object->memory);
+   *object = m_Object[--m_Objects];
+}
+
+
+static void m_FreeAll(void)
+{
+   while (m_Objects)
+   {
+      m_Free(m_Objects - 1);
+   }
+}
+
+
+static DWORD m_Used(unsigned int sizeClass)
+{
+   SlabStats stats;
+   slab_stats(sizeClass, &stats);
+   return stats.used;
+}
+
+
+//a size class, whose memory can't be allocated, fails on every allocation
+static void m_TestInitFailure(void)
+{
+   SlabStats stats;
+
+   host_heapFail = 2; //second size class
+   CHECK(!slab_init(), "slab_init succeeded without memory");
+   host_heapFail = 0;
+   CHECK(slab_stats(1, &stats) && (stats.total == 0), "size class without memory has %u objects", stats.total);
+   slab_exit();
+   CHECK(host_heapBytes == 0, "%u bytes left on the heap after slab_exit", host_heapBytes);
+}
+
+
+//objects are taken from the next larger size class, if the fitting one is exhausted
+static void m_TestFallback(void)
+{
+   SlabStats small;
+   SlabStats stats;
+   DWORD total = 0;
+   DWORD i;
+   unsigned int c;
+
+   slab_init();
+   slab_stats(0, &small);
+   for (i = 0; i < small.total; ++i)
+   {
+      m_Alloc(1);
+   }
+   CHECK(m_Used(0) == small.total, "%u of %u small objects used", m_Used(0), small.total);
+   CHECK(m_Alloc(small.size) && (m_Used(1) == 1), "no fallback into the next larger class");
+   slab_stats(0, &stats);
+   CHECK(stats.failures == 0, "fallback counted as failure");
+   //exhaust all classes: every object fits a byte
+   for (c = 0; slab_stats(c, &stats); ++c)
+   {
+      total += stats.total;
+   }
+   while (m_Alloc(1))
+   {
+   }
+   CHECK(m_Objects == total, "%u of %u objects allocated", m_Objects, total);
+   slab_stats(0, &stats);
+   CHECK(stats.failures == 1, "%u failures counted", stats.failures);
+   m_FreeAll();
+   for (c = 0; slab_stats(c, &stats); ++c)
+   {
+      CHECK(stats.used == 0, "class %u: %u objects used after all were freed", c, stats.used);
+      CHECK(stats.peak == stats.total, "class %u: peak %u of %u", c, stats.peak, stats.total);
+   }
+   slab_exit();
+}
+
+
+//the size classes grow on demand (up to their limit) and return unused blocks to the heap
+static void m_TestGrowTrim(void)
+{
+   SlabStats stats;
+   DWORD reserve;
+   DWORD total;
+   unsigned int c;
+
+   slab_init();
+   reserve = host_heapBytes;
+   CHECK(reserve <= 4096, "reserve of %u bytes", reserve);
+   //the largest class has no reserve: it fails without growth
+   for (c = 0; slab_stats(c, &stats); ++c)
+   {
+   }
+   slab_stats(--c, &stats);
+   CHECK(!m_Alloc(stats.size), "allocation from an empty class succeeded");
+   while (m_AllocGrow(stats.size, 1))
+   {
+   }
+   slab_stats(c, &stats);
+   total = stats.total;
+   CHECK((m_Objects == total) && (total > 0), "%u of %u objects allocated with growth", m_Objects, total);
+   CHECK(stats.failures == 2, "%u failures counted", stats.failures);
+   //a block with an object in use is kept
+   m_Free(0);
+   slab_trim();
+   slab_stats(c, &stats);
+   CHECK(stats.total == (total - 1), "%u objects after trim with %u objects in use (block size 1)", stats.total, m_Objects);
+   m_FreeAll();
+   slab_trim();
+   slab_stats(c, &stats);
+   CHECK(stats.total == 0, "%u objects after trim", stats.total);
+   CHECK(host_heapBytes == reserve, "%u bytes on the heap after trim, reserve is %u", host_heapBytes, reserve);
+   //the objects of the trimmed blocks are not handed out any more
+   CHECK(m_AllocGrow(stats.size, 1), "no growth after trim");
+   m_FreeAll();
+   slab_exit();
+   CHECK(host_heapBytes == 0, "%u bytes left on the heap after slab_exit", host_heapBytes);
+}
+
+
+//random allocations and frees of random sizes (also sizes, that don't fit any class), at task time
+static void m_TestRandom(void)
+{
+   SlabStats largest;
+   unsigned int c;
+   unsigned int n;
+
+   slab_init();
+   for (c = 0; slab_stats(c, &largest); ++c)
+   {
+   }
+   slab_stats(c - 1, &largest);
+   srand(1);
+   for (n = 0; n < 200000; ++n)
+   {
+      if ((m_Objects < RANDOM_OBJECTS) && (rand() & 1))
+      {
+         DWORD const size = 1 + rand() % (largest.size + 16);
+         if (!m_AllocGrow(size, 1))
+         {
+            CHECK(size > largest.size, "allocation of %u bytes failed with %u objects in use", size, m_Objects);
+         }
+         else
+         {
+            CHECK(size <= largest.size, "allocation of %u bytes succeeded", size);
+         }
+      }
+      else if (m_Objects)
+      {
+         m_Free(rand() % m_Objects);
+      }
+      if ((n % 1000) == 0)
+      {
+         slab_trim();
+      }
+   }
+   m_FreeAll();
+   slab_exit();
+   CHECK(host_heapBytes == 0, "%u bytes left on the heap after slab_exit", host_heapBytes);
+}
+
+
+int main(void)
+{
+   m_TestInitFailure();
+   m_TestFallback();
+   m_TestGrowTrim();
+   m_TestRandom();
+   printf("test_slab: %u checks, %u failures\n", m_Checks, m_Failures);
+   return (m_Failures != 0);
+}
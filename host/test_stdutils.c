@@ -0,0 +1,280 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host test of the stdutils kernels (src/stdutils.c).
+
+   Each kernel is compared with the C library, for all combinations of alignment
+   (0..7) and length (0..TEST_LENGTH). The buffers are surrounded by guard bytes,
+   so that any access outside of the given range is detected.
+   The host build uses the portable C implementation of the kernels (the inline
+   assembly is only compiled for the VxD).
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <string.h>
+#include "stdutils.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define TEST_LENGTH     (67)        //max. length tested
+#define TEST_ALIGN      (8)         //alignments tested
+#define BUFFER_SIZE     (TEST_LENGTH + 2*TEST_ALIGN + 16)
+#define GUARD           (0xA5)
+
+#define CHECK(cond, ...)   if (!(cond)) { m_Failures++; if (m_Failures < 20) { printf(__VA_ARGS__); printf("\n"); } }
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned int m_Failures;
+static unsigned int m_Checks;
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//fill buffer with a pattern, that differs for each byte and each seed
+static void m_Fill(unsigned char * buffer, unsigned int size, unsigned int seed)
+{
+   unsigned int i;
+   for (i = 0; i < size; ++i)
+   {
+      buffer[i] = (unsigned char)(i * 7 + seed * 13 + 1);
+   }
+}
+
+
+static void m_TestMemclr(void)
+{
+   unsigned char buffer[BUFFER_SIZE];
+   unsigned char expected[BUFFER_SIZE];
+   unsigned int align;
+   unsigned int len;
+
+   for (align = 0; align < TEST_ALIGN; ++align)
+   {
+      for (len = 0; len <= TEST_LENGTH; ++len)
+      {
+         memset(buffer, GUARD, sizeof(buffer));
+         memset(expected, GUARD, sizeof(expected));
+         stdutils_memclr(&buffer[8 + align], len);
+         memset(&expected[8 + align], 0, len);
+         m_Checks++;
+         CHECK(memcmp(buffer, expected, sizeof(buffer)) == 0, "memclr: align %u, length %u", align, len);
+      }
+   }
+}
+
+
+static void m_TestMemcpy(void)
+{
+   unsigned char source[BUFFER_SIZE];
+   unsigned char buffer[BUFFER_SIZE];
+   unsigned char expected[BUFFER_SIZE];
+   unsigned int srcAlign;
+   unsigned int destAlign;
+   unsigned int len;
+
+   m_Fill(source, sizeof(source), 1);
+   for (srcAlign = 0; srcAlign < TEST_ALIGN; ++srcAlign)
+   {
+      for (destAlign = 0; destAlign < TEST_ALIGN; ++destAlign)
+      {
+         for (len = 0; len <= TEST_LENGTH; ++len)
+         {
+            memset(buffer, GUARD, sizeof(buffer));
+            memset(expected, GUARD, sizeof(expected));
+            stdutils_memcpy(&buffer[8 + destAlign], &source[8 + srcAlign], len);
+            memcpy(&expected[8 + destAlign], &source[8 + srcAlign], len);
+            m_Checks++;
+            CHECK(memcmp(buffer, expected, sizeof(buffer)) == 0, "memcpy: source align %u, destination align %u, length %u",
+                  srcAlign, destAlign, len);
+         }
+      }
+   }
+}
+
+
+//overlapping and non overlapping moves within one buffer, in both directions
+static void m_TestMemmove(void)
+{
+   unsigned char buffer[BUFFER_SIZE];
+   unsigned char expected[BUFFER_SIZE];
+   unsigned int src;
+   unsigned int dest;
+   unsigned int len;
+
+   for (src = 0; src < 2*TEST_ALIGN; ++src)
+   {
+      for (dest = 0; dest < 2*TEST_ALIGN; ++dest)
+      {
+         for (len = 0; len <= TEST_LENGTH; ++len)
+         {
+            m_Fill(buffer, sizeof(buffer), 2);
+            m_Fill(expected, sizeof(expected), 2);
+            stdutils_memmove(&buffer[8 + dest], &buffer[8 + src], len);
+            memmove(&expected[8 + dest], &expected[8 + src], len);
+            m_Checks++;
+            CHECK(memcmp(buffer, expected, sizeof(buffer)) == 0, "memmove: source %u, destination %u, length %u",
+                  src, dest, len);
+         }
+      }
+   }
+}
+
+
+static void m_TestMemchr(void)
+{
+   unsigned char buffer[BUFFER_SIZE];
+   unsigned int align;
+   unsigned int len;
+   int pos;
+
+   for (align = 0; align < TEST_ALIGN; ++align)
+   {
+      for (len = 0; len <= TEST_LENGTH; ++len)
+      {
+         //char at each position, not at all, and right behind the range
+         for (pos = -1; pos <= (int)len; ++pos)
+         {
+            unsigned char * const mem = &buffer[8 + align];
+            memset(buffer, 0x11, sizeof(buffer));
+            if (pos >= 0)
+            {
+               mem[pos] = 0x80; //detects false positives of the zero byte test, too
+               if (pos + 1 < (int)len)
+               {
+                  mem[pos + 1] = 0x80; //the first occurence must be found
+               }
+            }
+            m_Checks++;
+            CHECK(stdutils_memchr(mem, 0x80, len) == memchr(mem, 0x80, len), "memchr: align %u, length %u, position %d",
+                  align, len, pos);
+         }
+      }
+   }
+}
+
+
+//sign of a comparison result
+static int m_Sign(int value)
+{
+   return (value > 0) - (value < 0);
+}
+
+
+static void m_TestStrncmp(void)
+{
+   static const char * const strings[] =
+   {
+      "", "C", "COM", "COM1", "COM10", "COM2", "Monitor", "Monitor1", "abcdefgh", "abcdefgi", "abcdefghijklmnopq",
+      "abcdefghijklmnopr", "\x80\x81", "\x01"
+   };
+   char str1[BUFFER_SIZE];
+   char str2[BUFFER_SIZE];
+   unsigned int i;
+   unsigned int j;
+   unsigned int align1;
+   unsigned int align2;
+   unsigned int num;
+
+   for (i = 0; i < sizeof(strings)/sizeof(strings[0]); ++i)
+   {
+      for (j = 0; j < sizeof(strings)/sizeof(strings[0]); ++j)
+      {
+         for (align1 = 0; align1 < TEST_ALIGN; align1 += 3)
+         {
+            for (align2 = 0; align2 < TEST_ALIGN; align2 += 4)
+            {
+               //garbage behind the terminator must not matter
+               memset(str1, 'x', sizeof(str1));
+               memset(str2, 'y', sizeof(str2));
+               strcpy(&str1[8 + align1], strings[i]);
+               strcpy(&str2[8 + align2], strings[j]);
+               for (num = 0; num < 24; ++num)
+               {
+                  int const result = stdutils_strncmp(&str1[8 + align1], &str2[8 + align2], num);
+                  int const expected = strncmp(&str1[8 + align1], &str2[8 + align2], num);
+                  m_Checks++;
+                  CHECK(m_Sign(result) == m_Sign(expected), "strncmp: \"%s\", \"%s\", num %u: %d instead of %d",
+                        strings[i], strings[j], num, result, expected);
+               }
+            }
+         }
+      }
+   }
+}
+
+
+static void m_TestStrncpy(void)
+{
+   static const char * const strings[] = { "", "COM3", "Monitor", "abcdefghijklmnopq" };
+   char buffer[BUFFER_SIZE];
+   char expected[BUFFER_SIZE];
+   unsigned int i;
+   unsigned int num;
+
+   for (i = 0; i < sizeof(strings)/sizeof(strings[0]); ++i)
+   {
+      for (num = 0; num < 24; ++num)
+      {
+         unsigned int const len = (unsigned int)strlen(strings[i]);
+         unsigned int const copied = (num == 0) ? 0 : ((len < num - 1) ? len : num - 1);
+         memset(buffer, GUARD, sizeof(buffer));
+         memset(expected, GUARD, sizeof(expected));
+         if (num)
+         {
+            memcpy(&expected[8], strings[i], copied);
+            expected[8 + copied] = 0;
+         }
+         m_Checks++;
+         CHECK((stdutils_strncpy(&buffer[8], strings[i], num) == copied) && (memcmp(buffer, expected, sizeof(buffer)) == 0),
+               "strncpy: \"%s\", num %u", strings[i], num);
+      }
+   }
+}
+
+
+static void m_TestUitoa(void)
+{
+   static const DWORD values[] =
+   {
+      0, 1, 9, 10, 11, 42, 99, 100, 101, 999, 1000, 9999, 10000, 12345, 65535, 99999, 100000, 999999, 1000000,
+      9999999, 10000000, 99999999, 100000000, 999999999, 1000000000, 2147483647, 2147483648u, 4294967295u
+   };
+   char buffer[BUFFER_SIZE];
+   char reference[16];
+   unsigned int i;
+   unsigned int num;
+
+   for (i = 0; i < sizeof(values)/sizeof(values[0]); ++i)
+   {
+      unsigned int const len = (unsigned int)sprintf(reference, "%lu", (unsigned long)values[i]);
+      for (num = 0; num < 16; ++num)
+      {
+         //if the buffer is too small, the lower digits are kept
+         unsigned int const kept = (num == 0) ? 0 : ((len < num - 1) ? len : num - 1);
+         unsigned int result;
+         memset(buffer, GUARD, sizeof(buffer));
+         result = stdutils_uitoa(&buffer[8], values[i], num);
+         m_Checks++;
+         CHECK((result == kept) && ((num == 0) || (strcmp(&buffer[8], &reference[len - kept]) == 0)) &&
+               ((unsigned char)buffer[8 + num] == GUARD) && ((unsigned char)buffer[7] == GUARD),
+               "uitoa: %s, num %u", reference, num);
+      }
+   }
+}
+
+
+int main(void)
+{
+   m_TestMemclr();
+   m_TestMemcpy();
+   m_TestMemmove();
+   m_TestMemchr();
+   m_TestStrncmp();
+   m_TestStrncpy();
+   m_TestUitoa();
+   printf("test_stdutils: %u checks, %u failures\n", m_Checks, m_Failures);
+   return m_Failures ? 1 : 0;
+}
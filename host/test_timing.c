@@ -0,0 +1,354 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Host test of the timed behavior of the driver (src/driver.c).
+
+   The driver runs against the VMM and VCOMM stand-ins of hostwrap.c, with a
+   virtual system time. The test acts as VCOMM (it adds the ports, configured
+   in the registry stand-in) and as the applications (they open the ports and
+   call the port functions). Two hours of traffic at 9600 baud run in a few
+   seconds.
+
+   The scenario runs twice, each time in a process of its own (i.e. with a
+   freshly loaded driver). Both runs must call the callbacks at the same
+   virtual times, with the same data.
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../src/driver.c"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define TRAFFIC_TIME    (2 * 3600 * 1000)    //duration [ms] of the traffic at 9600 baud
+#define TRAFFIC_RATE    (960)                //bytes per second at 9600 baud (8n1)
+#define TRAFFIC_TICK    (10)                 //period [ms] of the writing application
+#define SOURCE_READ     (100)                //period [ms] of the application, reading the source port
+#define RX_INTERVAL     (20)                 //ReadIntervalTimeout [ms] of COM6
+#define IMPAIR_DELAY    (50)                 //ImpairDelay [ms] of COM9
+#define MODBUS_GAP      (4)                  //FrameGap [ms] of COM8
+
+#define CHECK(cond, ...)   m_Checks++; if (!(cond)) { m_Failures++; if (m_Failures < 20) { printf(__VA_ARGS__); printf("\n"); } }
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//result of a run of the scenario
+typedef struct _RunResult
+{
+   unsigned int checks;
+   unsigned int failures;
+   DWORD trace;         //checksum of all callbacks (virtual time, port, event) and of all data read
+} RunResult;
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned int m_Failures;
+static unsigned int m_Checks;
+static DWORD m_Trace;
+static DWORD m_RxCallbacks;
+static DWORD m_RxCallbackTime;
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+static void m_TraceAdd(const void * data, DWORD count)
+{
+   m_Trace = crc_crc32(m_Trace, (const unsigned char *)data, count);
+}
+
+
+//rx callback of the applications. the reference data is the number of the port
+static void _cdecl m_RxCallback(PortInformation * hPort, DWORD lReferenceData, DWORD lEvent, DWORD lSubEvent)
+{
+   DWORD const trace[3] = { host_time, lReferenceData, lEvent };
+   CHECK(host_critical == 0, "rx callback of COM%u called within a critical section", lReferenceData);
+   m_TraceAdd(trace, sizeof(trace));
+   m_RxCallbacks++;
+   m_RxCallbackTime = host_time;
+}
+
+
+static PortFunctionTable * m_Functions(PortInformation * hPort)
+{
+   return (PortFunctionTable *)hPort->portData.PDfunctions;
+}
+
+
+static PortInformation * m_Open(char * portName)
+{
+   long error = 0;
+   PortInformation * const hPort = host_OpenPort(portName, &error);
+   CHECK(hPort != NULL, "%s can't be opened (error %ld)", portName, error);
+   return hPort;
+}
+
+
+static DWORD m_Write(PortInformation * hPort, const void * data, DWORD count)
+{
+   DWORD written = 0;
+   m_Functions(hPort)->pPortWrite(hPort, (void *)data, count, &written);
+   return written;
+}
+
+
+static DWORD m_Read(PortInformation * hPort, void * data, DWORD count)
+{
+   DWORD received = 0;
+   m_Functions(hPort)->pPortRead(hPort, data, count, &received);
+   m_TraceAdd(data, received);
+   return received;
+}
+
+
+static DWORD m_InQueue(PortInformation * hPort)
+{
+   _COMSTAT comstat;
+   m_Functions(hPort)->pPortGetQueueStatus(hPort, &comstat);
+   return comstat.cbInque;
+}
+
+
+//load the driver, and let VCOMM add the ports configured in the registry
+static void m_Load(void)
+{
+   host_RegistryString(1, "PairPortName", "COM6");
+   host_RegistryString(2, "PairPortName", "COM5");
+   host_RegistryDword(2, "ReadIntervalTimeout", RX_INTERVAL);
+   host_RegistryString(3, "PortType", "Source");
+   host_RegistryString(3, "Pattern", "Counter");
+   host_RegistryDword(3, "Rate", TRAFFIC_RATE);
+   host_RegistryString(4, "PairPortName", "COM9");
+   host_RegistryString(4, "Framing", "Modbus");
+   host_RegistryDword(4, "FrameGap", MODBUS_GAP);
+   host_RegistryString(5, "PairPortName", "COM8");
+   host_RegistryDword(5, "ImpairDelay", IMPAIR_DELAY);
+
+   MXVCP_DeviceInit(Get_Sys_VM_Handle());
+   CHECK(host_carry == 0, "driver can't be loaded");
+   host_AddDevice(1, "COM5");
+   host_AddDevice(2, "COM6");
+   host_AddDevice(3, "COM7");
+   host_AddDevice(4, "COM8");
+   host_AddDevice(5, "COM9");
+}
+
+
+//the rx interval signals received data below the rx trigger level, after the line was idle
+static void m_TestRxInterval(PortInformation * com5, PortInformation * com6)
+{
+   BYTE data[16];
+   DWORD start;
+
+   m_Functions(com6)->pPortSetReadCallback(com6, 100, m_RxCallback, 6);
+   m_RxCallbacks = 0;
+   start = host_time;
+   CHECK(m_Write(com5, "0123456789", 10) == 10, "COM5: write failed");
+   CHECK(m_RxCallbacks == 0, "rx callback below the trigger level");
+   host_Run(RX_INTERVAL / 2);
+   CHECK(m_RxCallbacks == 0, "rx callback before the rx interval");
+   host_Run(RX_INTERVAL + WHEEL_PERIOD);
+   CHECK(m_RxCallbacks == 1, "%u rx callbacks after the rx interval (expected 1)", m_RxCallbacks);
+   CHECK((m_RxCallbackTime >= (start + RX_INTERVAL)) && (m_RxCallbackTime <= (start + RX_INTERVAL + WHEEL_PERIOD)),
+         "rx interval callback after %u ms (expected %u ms)", m_RxCallbackTime - start, RX_INTERVAL);
+   CHECK(m_Read(com6, data, sizeof(data)) == 10, "COM6: 10 bytes expected");
+   host_Run(10 * RX_INTERVAL);
+   CHECK(m_RxCallbacks == 1, "rx interval callback repeated, though no data was received");
+}
+
+
+//hours of continuous traffic at 9600 baud. the line is never idle, so the rx interval never elapses.
+//meanwhile, an application reads the source port, that produces data at 9600 baud
+static void m_TestTraffic(PortInformation * com5, PortInformation * com6, PortInformation * com7)
+{
+   BYTE data[FIFO_SIZE_1BY];
+   BYTE txCounter = 0;
+   BYTE rxCounter = 0;
+   BYTE sourceCounter = 0;
+   DWORD credit = 0;
+   DWORD transmitted = 0;
+   DWORD received = 0;
+   DWORD sourced = 0;
+   DWORD sequenceErrors = 0;
+   DWORD sourceErrors = 0;
+   DWORD expected;
+   DWORD t;
+   DWORD i;
+
+   m_RxCallbacks = 0;
+   for (t = 0; t < TRAFFIC_TIME; t += TRAFFIC_TICK)
+   {
+      DWORD num;
+      credit += TRAFFIC_RATE * TRAFFIC_TICK;
+      for (num = 0; credit >= 1000; credit -= 1000)
+      {
+         data[num++] = txCounter++;
+      }
+      transmitted += m_Write(com5, data, num);
+      host_Run(TRAFFIC_TICK);
+      num = m_Read(com6, data, sizeof(data));
+      for (i = 0; i < num; ++i)
+      {
+         sequenceErrors += (data[i] != rxCounter++);
+      }
+      received += num;
+      if ((t % SOURCE_READ) == 0)
+      {
+         num = m_Read(com7, data, sizeof(data));
+         for (i = 0; i < num; ++i)
+         {
+            sourceErrors += (data[i] != sourceCounter++);
+         }
+         sourced += num;
+      }
+   }
+   CHECK(transmitted == (TRAFFIC_RATE / 1000.0 * TRAFFIC_TIME), "%u bytes transmitted", transmitted);
+   CHECK(received == transmitted, "%u bytes transmitted, but %u received", transmitted, received);
+   CHECK(sequenceErrors == 0, "%u bytes received out of sequence", sequenceErrors);
+   CHECK(m_RxCallbacks == 0, "%u rx interval callbacks during continuous traffic", m_RxCallbacks);
+   //the source produces its data since it was opened, once per tick
+   sourced += m_InQueue(com7);
+   expected = TRAFFIC_RATE / 1000.0 * (host_time - com7->synthetic.startTime);
+   CHECK((sourced <= expected) && ((sourced + (TRAFFIC_RATE * SOURCE_TICK_TIME / 1000)) >= expected),
+         "source COM7 produced %u bytes (expected %u)", sourced, expected);
+   CHECK(sourceErrors == 0, "%u bytes of the source out of sequence", sourceErrors);
+}
+
+
+//Modbus RTU: a frame is complete after the gap. pieces of a frame within the gap belong to the frame
+static void m_TestModbus(PortInformation * com8, PortInformation * com9)
+{
+   BYTE frame[8] = { 0x11, 0x03, 0x00, 0x6B, 0x00, 0x03 };
+   BYTE data[32];
+   WORD const crc = crc_crc16(CRC16_INIT, frame, 6);
+   DWORD const frames = com8->frame.frames;
+
+   frame[6] = (BYTE)crc;
+   frame[7] = (BYTE)(crc >> 8);
+   m_Functions(com8)->pPortSetReadCallback(com8, 1, m_RxCallback, 8);
+
+   //a frame in two pieces, 2 ms apart
+   m_RxCallbacks = 0;
+   m_Write(com9, frame, 3);
+   host_Run(MODBUS_GAP / 2);
+   m_Write(com9, &frame[3], 5);
+   CHECK(com8->frame.frames == frames, "frame complete within the gap");
+   host_Run(MODBUS_GAP + 1);
+   CHECK(com8->frame.frames == (frames + 1), "%u frames after the gap (expected 1)", com8->frame.frames - frames);
+   CHECK(com8->frame.corruptFrames == 0, "frame is corrupt");
+   CHECK(m_RxCallbacks == 1, "%u rx callbacks for one frame", m_RxCallbacks);
+   CHECK(m_Read(com8, data, sizeof(data)) == 8, "COM8: frame expected");
+
+   //the same pieces, 6 ms apart: two (corrupt) frames
+   m_Write(com9, frame, 3);
+   host_Run(MODBUS_GAP + 2);
+   m_Write(com9, &frame[3], 5);
+   host_Run(MODBUS_GAP + 1);
+   CHECK(com8->frame.frames == (frames + 3), "%u frames after a split frame (expected 3)", com8->frame.frames - frames);
+   CHECK(com8->frame.corruptFrames == 2, "%u corrupt frames (expected 2)", com8->frame.corruptFrames);
+   CHECK(m_Read(com8, data, sizeof(data)) == 8, "COM8: data of the split frame expected");
+   m_Functions(com8)->pPortSetReadCallback(com8, 0, NULL, 0);
+}
+
+
+//impairment: the data is received by COM9 after the delay
+static void m_TestImpairDelay(PortInformation * com8, PortInformation * com9)
+{
+   BYTE data[16];
+   DWORD const start = host_time;
+
+   CHECK(m_Write(com8, "hello", 5) == 5, "COM8: write failed");
+   host_Run(IMPAIR_DELAY - 1);
+   CHECK(m_InQueue(com9) == 0, "data received %u ms before the delay elapsed", start + IMPAIR_DELAY - host_time);
+   host_Run(WHEEL_PERIOD + 1);
+   CHECK(m_InQueue(com9) == 5, "data not received %u ms after the delay", host_time - start - IMPAIR_DELAY);
+   CHECK(m_Read(com9, data, sizeof(data)) == 5, "COM9: 5 bytes expected");
+}
+
+
+static void m_RunScenario(RunResult * result)
+{
+   PortInformation * com5;
+   PortInformation * com6;
+   PortInformation * com7;
+   PortInformation * com8;
+   PortInformation * com9;
+
+   m_Trace = CRC32_INIT;
+   m_Load();
+   com5 = m_Open("COM5");
+   com6 = m_Open("COM6");
+   com7 = m_Open("COM7");
+   com8 = m_Open("COM8");
+   com9 = m_Open("COM9");
+   if (com5 && com6 && com7 && com8 && com9)
+   {
+      m_TestRxInterval(com5, com6);
+      m_TestTraffic(com5, com6, com7);
+      m_TestModbus(com8, com9);
+      m_TestImpairDelay(com8, com9);
+      m_Functions(com5)->pPortClose(com5);
+      m_Functions(com6)->pPortClose(com6);
+      m_Functions(com7)->pPortClose(com7);
+      m_Functions(com8)->pPortClose(com8);
+      m_Functions(com9)->pPortClose(com9);
+   }
+   host_Run(FIFO_RELEASE_TIME + 1);
+   MXVCP_DeviceExit(Get_Sys_VM_Handle());
+   CHECK(host_PendingTimeOuts() == 0, "%u time-outs pending after the driver was unloaded", host_PendingTimeOuts());
+   CHECK(host_heapBytes == 0, "%u bytes of heap not freed", host_heapBytes);
+   CHECK(host_violations == 0, "%u services called at interrupt time or within a critical section", host_violations);
+   result->checks = m_Checks;
+   result->failures = m_Failures;
+   result->trace = m_Trace;
+}
+
+
+//run the scenario in a process of its own (i.e. with a freshly loaded driver)
+static BOOL m_Run(RunResult * result)
+{
+   int pipeFd[2];
+   pid_t child;
+   int status;
+
+   if (pipe(pipeFd) != 0)
+   {
+      return 0;
+   }
+   fflush(stdout);
+   child = fork();
+   if (child == 0)
+   {
+      m_RunScenario(result);
+      fflush(stdout);
+      _exit(write(pipeFd[1], result, sizeof(*result)) != sizeof(*result));
+   }
+   close(pipeFd[1]);
+   status = (read(pipeFd[0], result, sizeof(*result)) == sizeof(*result));
+   close(pipeFd[0]);
+   waitpid(child, NULL, 0);
+   return status;
+}
+
+
+int main(void)
+{
+   RunResult first;
+   RunResult second;
+
+   if (!m_Run(&first) || !m_Run(&second))
+   {
+      printf("test_timing: scenario aborted\n");
+      return 1;
+   }
+   m_Checks = first.checks + second.checks;
+   m_Failures = first.failures + second.failures;
+   CHECK(first.trace == second.trace, "runs differ: trace %08X vs %08X", first.trace, second.trace);
+   printf("test_timing: %u checks, %u failures\n", m_Checks, m_Failures);
+   return (m_Failures != 0);
+}
@@ -0,0 +1,207 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Stand-in of the DDK header vcomm.h for the host build.
+
+   Only the types and constants, the driver uses, are declared. The layout of
+   PortData corresponds to the DDK, as the driver overlays its fifo on it
+   (cf. PortFifo in driver.c). The VCOMM services are declared by hostwrap.h.
+*/
+//-----------------------------------------------------------------------------
+#ifndef VCOMM_H_
+#define VCOMM_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#define DC_Initialize      (0)      //function code of the driver control function
+
+//error codes of a port open function
+#define IE_BADID           (-1)
+#define IE_OPEN            (-2)
+#define IE_NOPEN           (-3)
+#define IE_MEMORY          (-4)
+#define IE_DEFAULT         (-5)
+#define IE_HARDWARE        (-10)
+#define IE_BYTESIZE        (-11)
+#define IE_BAUDRATE        (-12)
+
+//events
+#define EV_RXCHAR          (0x0001)
+#define EV_RXFLAG          (0x0002)
+#define EV_TXEMPTY         (0x0004)
+#define EV_CTS             (0x0008)
+#define EV_DSR             (0x0010)
+#define EV_RLSD            (0x0020)
+#define EV_BREAK           (0x0040)
+#define EV_ERR             (0x0080)
+#define EV_RING            (0x0100)
+#define EV_CTSS            (0x0400)
+#define EV_DSRS            (0x0800)
+#define EV_TXCHAR          (0x4000)
+
+//notification codes
+#define CN_RECEIVE         (1)
+#define CN_TRANSMIT        (2)
+#define CN_EVENT           (4)
+
+//communication errors
+#define CE_RXOVER          (0x0001)
+#define CE_OVERRUN         (0x0002)
+#define CE_RXPARITY        (0x0004)
+#define CE_FRAME           (0x0008)
+#define CE_BREAK           (0x0010)
+#define CE_TXFULL          (0x0100)
+#define CE_MODE            (0x8000)
+
+//properties
+#define SP_SERIALCOMM      (1)
+#define BAUD_USER          (0x10000000)
+#define PST_RS232          (1)
+#define CBR_9600           (9600)
+
+//modem status
+#define MS_CTS_ON          (0x0010)
+#define MS_DSR_ON          (0x0020)
+
+//registry value types
+#define REG_SZ             (1)
+#define REG_BINARY         (3)
+
+//parity
+#define NOPARITY           (0)
+#define ODDPARITY          (1)
+#define EVENPARITY         (2)
+#define MARKPARITY         (3)
+#define SPACEPARITY        (4)
+
+//action mask of PortSetCommState
+#define fBaudRate          (0x00000001)
+#define fBitMask           (0x00000002)
+#define fXonLim            (0x00000004)
+#define fXoffLim           (0x00000008)
+#define fByteSize          (0x00000010)
+#define fbParity           (0x00000020)
+#define fStopBits          (0x00000040)
+#define fXonChar           (0x00000080)
+#define fXoffChar          (0x00000100)
+#define fErrorChar         (0x00000200)
+#define fEofChar           (0x00000400)
+#define fEvtChar1          (0x00000800)
+#define fEvtChar2          (0x00001000)
+
+//bits of _DCB.BitMask
+#define fParity            (0x00000002)
+
+
+/* -- Types --------------------------------------------------------------- */
+typedef struct PortFunctions PortFunctions; //the driver defines its own table (cf. PortFunctionTable)
+
+typedef struct _COMMTIMEOUTS
+{
+   DWORD ReadIntervalTimeout;
+   DWORD ReadTotalTimeoutMultiplier;
+   DWORD ReadTotalTimeoutConstant;
+   DWORD WriteTotalTimeoutMultiplier;
+   DWORD WriteTotalTimeoutConstant;
+} _COMMTIMEOUTS;
+
+typedef struct PortData
+{
+   WORD PDLength;
+   WORD PDVersion;
+   PortFunctions * PDfunctions;
+   DWORD PDNumFunctions;
+   DWORD dwLastError;
+   DWORD dwClientRefData;
+   DWORD dwCallerVMId;
+   DWORD dwDetectedEvents;
+   DWORD dwCommError;
+   BYTE bMSRShadow;
+   WORD wFlags;
+   BYTE LossByte;
+   DWORD QInAddr;
+   DWORD QInSize;
+   DWORD QOutAddr;
+   DWORD QOutSize;
+   DWORD QInCount;
+   DWORD QInGet;
+   DWORD QInPut;
+   DWORD QOutCount;
+   DWORD QOutGet;
+   DWORD QOutPut;
+   DWORD ValidPortData;
+   DWORD lpLoadHandle;
+   _COMMTIMEOUTS cmto;
+   DWORD lpReadRequestQueue;
+   DWORD lpWriteRequestQueue;
+   DWORD dwLastReceiveTime;
+   DWORD dwReserved1;
+   DWORD dwReserved2;
+} PortData;
+
+typedef struct _DCB
+{
+   ULONG DCBLength;
+   ULONG BaudRate;
+   ULONG BitMask;
+   ULONG XonLim;
+   ULONG XoffLim;
+   WORD wReserved;
+   BYTE ByteSize;
+   BYTE Parity;
+   BYTE StopBits;
+   char XonChar;
+   char XoffChar;
+   char ErrorChar;
+   char EofChar;
+   char EvtChar1;
+   char EvtChar2;
+   BYTE bReserved;
+   ULONG RlsTimeout;
+   ULONG CtsTimeout;
+   ULONG DsrTimeout;
+   ULONG TxDelay;
+} _DCB;
+
+typedef struct _COMSTAT
+{
+   DWORD BitMask;
+   DWORD cbInque;
+   DWORD cbOutque;
+} _COMSTAT;
+
+typedef struct _COMMPROP
+{
+   WORD wPacketLength;
+   WORD wPacketVersion;
+   DWORD dwServiceMask;
+   DWORD dwReserved1;
+   DWORD dwMaxTxQueue;
+   DWORD dwMaxRxQueue;
+   DWORD dwMaxBaud;
+   DWORD dwProvSubType;
+   DWORD dwProvCapabilities;
+   DWORD dwSettableParams;
+   DWORD dwSettableBaud;
+   WORD wSettableData;
+   WORD wSettableStopParity;
+   DWORD dwCurrentTxQueue;
+   DWORD dwCurrentRxQueue;
+   DWORD dwProvSpec1;
+   DWORD dwProvSpec2;
+   BYTE wcProvChar[1];
+} _COMMPROP;
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
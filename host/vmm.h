@@ -0,0 +1,16 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Stand-in of the DDK header vmm.h for the host build.
+
+   The VMM services, the driver uses, are declared by hostwrap.h (the host
+   counterpart of wrapper.h).
+*/
+//-----------------------------------------------------------------------------
+#ifndef VMM_H_
+#define VMM_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+#endif
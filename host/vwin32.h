@@ -0,0 +1,49 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Stand-in of the DDK header vwin32.h for the host build.
+*/
+//-----------------------------------------------------------------------------
+#ifndef VWIN32_H_
+#define VWIN32_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#define DIOC_OPEN          (0)         //a Win32 application opened the driver (CreateFile)
+#define DIOC_CLOSEHANDLE   (-1)        //a Win32 application closed its handle of the driver
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//the addresses are DWORDs on Windows 95. on the host they must hold a pointer of the test (also on LP64 hosts)
+typedef uintptr_t DIOCADDRESS;
+
+typedef struct DIOCParams
+{
+   DWORD Internal1;
+   DWORD VMHandle;
+   DWORD Internal2;
+   DWORD dwIoControlCode;
+   DIOCADDRESS lpvInBuffer;
+   DWORD cbInBuffer;
+   DIOCADDRESS lpvOutBuffer;
+   DWORD cbOutBuffer;
+   DIOCADDRESS lpcbBytesReturned;
+   DIOCADDRESS lpoOverlapped;
+   DWORD hDevice;
+   DWORD tagProcess;
+} DIOCPARAMETERS;
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
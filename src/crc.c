@@ -0,0 +1,102 @@
+/* -- Includes ------------------------------------------------------------ */
+#include "crc.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define CRC32_POLYNOMIAL      (0xEDB88320)   //reversed representation of 0x04C11DB7
+#define CRC16_POLYNOMIAL      (0xA001)       //reversed representation of 0x8005 (Modbus)
+#define FCS16_POLYNOMIAL      (0x8408)       //reversed representation of 0x1021 (CCITT, RFC 1662)
+#define CRC8_POLYNOMIAL       (0xE0)         //reversed representation of 0x07 (27.010)
+
+
+/* -- Types --------------------------------------------------------------- */
+
+
+/* -- Module Global Function Prototypes ----------------------------------- */
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static unsigned long m_Crc32Table[256];
+static unsigned short m_Crc16Table[256];
+static unsigned short m_Fcs16Table[256];
+static unsigned char m_Crc8Table[256];
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//calculate the lookup tables. must be called once, before any CRC is calculated.
+void crc_init(void)
+{
+   unsigned int i;
+   unsigned int bit;
+
+   for (i = 0; i < 256; ++i)
+   {
+      unsigned long crc32 = i;
+      unsigned short crc16 = (unsigned short)i;
+      unsigned short fcs16 = (unsigned short)i;
+      unsigned char crc8 = (unsigned char)i;
+      for (bit = 0; bit < 8; ++bit)
+      {
+         crc32 = (crc32 & 1) ? ((crc32 >> 1) ^ CRC32_POLYNOMIAL) : (crc32 >> 1);
+         crc16 = (crc16 & 1) ? ((crc16 >> 1) ^ CRC16_POLYNOMIAL) : (crc16 >> 1);
+         fcs16 = (fcs16 & 1) ? ((fcs16 >> 1) ^ FCS16_POLYNOMIAL) : (fcs16 >> 1);
+         crc8 = (crc8 & 1) ? ((crc8 >> 1) ^ CRC8_POLYNOMIAL) : (crc8 >> 1);
+      }
+      m_Crc32Table[i] = crc32;
+      m_Crc16Table[i] = crc16;
+      m_Fcs16Table[i] = fcs16;
+      m_Crc8Table[i] = crc8;
+   }
+}
+
+
+
+//update the given crc by num bytes of data. start with CRC32_INIT. the final CRC-32 is the inverted result.
+unsigned long crc_crc32(unsigned long crc, const unsigned char * data, unsigned int num)
+{
+   while (num--)
+   {
+      crc = (crc >> 8) ^ m_Crc32Table[(crc ^ *data++) & 0xFF];
+   }
+   return crc;
+}
+
+
+
+//update the given crc by num bytes of data. start with CRC16_INIT.
+//the CRC over a Modbus RTU frame, including its CRC (low byte first), is 0.
+unsigned short crc_crc16(unsigned short crc, const unsigned char * data, unsigned int num)
+{
+   while (num--)
+   {
+      crc = (unsigned short)((crc >> 8) ^ m_Crc16Table[(crc ^ *data++) & 0xFF]);
+   }
+   return crc;
+}
+
+
+
+//update the given fcs by num bytes of data. start with FCS16_INIT.
+//the FCS over a HDLC frame, including its (inverted) FCS, is FCS16_GOOD.
+unsigned short crc_fcs16(unsigned short crc, const unsigned char * data, unsigned int num)
+{
+   while (num--)
+   {
+      crc = (unsigned short)((crc >> 8) ^ m_Fcs16Table[(crc ^ *data++) & 0xFF]);
+   }
+   return crc;
+}
+
+
+
+//update the given crc by num bytes of data. start with CRC8_INIT.
+//the FCS of a 27.010 frame is 0xFF minus the CRC over its header. the CRC over header and FCS is CRC8_GOOD.
+unsigned char crc_crc8(unsigned char crc, const unsigned char * data, unsigned int num)
+{
+   while (num--)
+   {
+      crc = m_Crc8Table[crc ^ *data++];
+   }
+   return crc;
+}
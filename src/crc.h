@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Table driven checksum calculation (CRC).
+
+*/
+//-----------------------------------------------------------------------------
+#ifndef CRC_H_
+#define CRC_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#define CRC32_INIT      (0xFFFFFFFF)   //start value of CRC-32 calculation
+#define CRC16_INIT      (0xFFFF)       //start value of CRC-16 (Modbus) calculation
+#define FCS16_INIT      (0xFFFF)       //start value of FCS-16 (HDLC) calculation
+#define FCS16_GOOD      (0xF0B8)       //FCS-16 over data and its (appended) FCS of a valid frame
+#define CRC8_INIT       (0xFF)         //start value of CRC-8 (27.010) calculation
+#define CRC8_GOOD       (0xCF)         //CRC-8 over the header and its (appended) FCS of a valid 27.010 frame
+
+
+/* -- Types --------------------------------------------------------------- */
+
+/* -- Global Variables ---------------------------------------------------- */
+
+/* -- Function Prototypes ------------------------------------------------- */
+void crc_init(void);
+unsigned long crc_crc32(unsigned long crc, const unsigned char * data, unsigned int num);
+unsigned short crc_crc16(unsigned short crc, const unsigned char * data, unsigned int num);
+unsigned short crc_fcs16(unsigned short crc, const unsigned char * data, unsigned int num);
+unsigned char crc_crc8(unsigned char crc, const unsigned char * data, unsigned int num);
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
@@ -3,14 +3,111 @@
 // #include "vxdwraps.h"
 #include "vmm.h"
 #include "vcomm.h"
+#include "vwin32.h"
 #include "wrapper.h"
 #include "stdutils.h"
+#include "crc.h"
+#include "slab.h"
+#include "wheel.h"
+#include "mxvcp.h"
 
 
 /* -- Defines ------------------------------------------------------------- */
 #define FIFO_SIZE_1BY         (512) //size of fifo buffer
+#define FIFO_SIZE_MIN         (256)    //min. size of a fifo buffer (cf. MXVCP_ESC_FIFO_RESIZE)
+#define FIFO_SIZE_MAX         (8192)   //max. size of a grown fifo buffer (largest size class of the slab)
+#define FIFO_IDLE_TIME        (10000)  //default idle time [ms], after that a grown fifo shrinks back
+#define FIFO_RELEASE_TIME     (5000)   //grace period [ms], the fifo buffer is kept after the port was closed
+#define FIFO_GROW_PRESSURE    (4)      //number of consecutive writes, filling the fifo above 75%, that grow it
+#ifndef NUMBER_OF_PORTS
 #define NUMBER_OF_PORTS       (6)   //shall be a multiple of 2 (as we build pairs!)
+#endif
 #define PORTNAME_LENGTH       (16)
+#define MONITOR_CHUNK_SIZE    (FIFO_SIZE_1BY/4) //max. number of data bytes per monitor record
+#define FILENAME_LENGTH       (128)
+#define CAPTURE_BUFFER_SIZE   (16*1024)   //size of each of the two capture buffers
+#define REPLAY_FILE_SIZE_MAX  (1024*1024) //max. size of a file to replay (it's loaded completely)
+#define REPLAY_RETRY_TIME     (10)        //retry period [ms], if the fifo is full during a timed replay
+#define SOURCE_TICK_TIME      (10)        //period [ms] of a rate limited source port
+#define SOURCE_BLOCK_SIZE     (64)        //number of bytes generated at once by a source port
+#define PRBS_SEED             (0x7FFF)    //start value of the PRBS-15 shift register
+#define IMPAIR_BUFFER_SIZE    (4096)      //size of the delay line of an impairment stage
+#define IMPAIR_CHUNKS         (64)        //max. number of chunks within the delay line
+#define PPM                   (1000000)   //probabilities are given in parts per million
+#define PAGE_SIZE             (4096)
+#define READY_SETS            (4)         //max. number of readiness sets (one per client handle of the driver)
+#define READY_WORDS           ((NUMBER_OF_PORTS + 31) / 32) //number of DWORDs of the ready bits of a set
+#define PERF_STATS            (5)         //number of System Monitor statistics per port
+#define PERF_NAME_LENGTH      (PORTNAME_LENGTH + 24)
+#define LINE_BYTES            (0x01010101)   //one bit per byte of a DWORD (line format transform)
+#define FRAME_GAP_DEFAULT     (4)         //min. gap [ms] between two Modbus RTU frames (3.5 chars at 9600 baud)
+
+//port types (registry value "PortType")
+#define PORT_TYPE_NORMAL      (0)   //port is connected to its pair port
+#define PORT_TYPE_MONITOR     (1)   //port receives a copy of the traffic of a pair (read only)
+#define PORT_TYPE_SOURCE      (2)   //port produces a data pattern. written data is dropped
+#define PORT_TYPE_SINK        (3)   //port consumes and checks written data. nothing to read
+#define PORT_TYPE_MUX         (4)   //port carries the frames of all its channel ports (27.010 basic option)
+#define PORT_TYPE_CHANNEL     (5)   //port is a logical channel of a multiplexer port
+
+//data patterns of source and sink ports (registry value "Pattern")
+#define PATTERN_NONE          (0)   //sink only: no sequence check
+#define PATTERN_COUNTER       (1)   //8-bit counter
+#define PATTERN_PRBS          (2)   //PRBS-15 (x^15 + x^14 + 1)
+#define PATTERN_FILE          (3)   //source only: content of a file, repeated
+
+//framing of received data
+#define FRAMING_NONE          (0)   //byte stream. rx is signaled for each chunk of data
+#define FRAMING_SLIP          (1)   //SLIP (RFC 1055): frames terminated by END (0xC0)
+#define FRAMING_HDLC          (2)   //HDLC-like (RFC 1662): frames delimited by flags (0x7E), with FCS-16
+#define FRAMING_MODBUS        (3)   //Modbus RTU: frames separated by an inter-character gap, with CRC-16
+
+//special characters of SLIP and HDLC framing
+#define SLIP_END              (0xC0)
+#define SLIP_ESC              (0xDB)
+#define SLIP_ESC_END          (0xDC)
+#define SLIP_ESC_ESC          (0xDD)
+#define HDLC_FLAG             (0x7E)
+#define HDLC_ESC              (0x7D)
+#define HDLC_XOR              (0x20)
+
+//line format transform (data received from the pair port, cf. m_LineUpdate)
+#define LINE_TRANSFORM_DATA   (0x01)   //byte size differs: mask resp. fill data bits
+#define LINE_TRANSFORM_PARITY (0x02)   //parity differs: check parity (CE_RXPARITY)
+#define LINE_TRANSFORM_BAUD   (0x04)   //baud rate differs: framing errors (CE_FRAME)
+
+//spans of a fifo, held by a ring 0 client (cf. MXVCP_ESC_GET_SPAN_API). the fifo buffer must not be exchanged meanwhile
+#define SPAN_LOCK_READ        (0x01)   //the port has peeked into its rx fifo, until commit
+#define SPAN_LOCK_WRITE       (0x02)   //the pair port has reserved space in the rx fifo, until publish
+
+//multiplexer (27.010 basic option, with credit based flow control)
+#define MUX_FLAG              (0xF9)
+#define MUX_SABM              (0x2F)   //control field: start channel
+#define MUX_DISC              (0x43)   //control field: stop channel
+#define MUX_UIH               (0xEF)   //control field: data
+#define MUX_UA                (0x63)   //control field: acknowledge (of SABM resp. DISC)
+#define MUX_DM                (0x0F)   //control field: channel is disconnected
+#define MUX_PF                (0x10)   //poll/final bit. UIH frame: first byte of information field are credits
+#define MUX_FRAME_SIZE        (64)     //max. number of data bytes per frame (a credit allows to send one frame)
+#define MUX_INFO_SIZE         (127)    //max. size of the information field (one byte length field)
+#define MUX_CHANNELS          (63)     //max. channel number (DLCI)
+#define MUX_CREDIT_BATCH      (2)      //min. number of credits to grant at once (unless the peer has none)
+#define MUX_STATE_HUNT        (0)      //receive states: wait for flag
+#define MUX_STATE_ADDRESS     (1)
+#define MUX_STATE_CONTROL     (2)
+#define MUX_STATE_LENGTH      (3)
+#define MUX_STATE_INFO        (4)
+#define MUX_STATE_FCS         (5)
+#define MUX_STATE_END         (6)      //wait for closing flag
+
+//win32 error codes (returned by MXVCP_DeviceIOControl)
+#define ERROR_SUCCESS               (0)
+#define ERROR_INVALID_FUNCTION      (1)
+#define ERROR_FILE_NOT_FOUND        (2)
+#define ERROR_ACCESS_DENIED         (5)
+#define ERROR_INVALID_PARAMETER     (87)
+#define ERROR_NOT_ENOUGH_MEMORY     (8)
+#define ERROR_IO_PENDING            (997)
 
 /* -- Types --------------------------------------------------------------- */
 typedef struct _PortInformation PortInformation; //forward declaration
@@ -34,6 +131,169 @@ typedef void (_cdecl * PCommNotifyProc)(PortInformation * hPort, DWORD lReferenc
 
 
 
+/*----------------------------------------------------------------------------
+   Additional state of a synthetic port (source or sink).
+----------------------------------------------------------------------------*/
+typedef struct _SyntheticPort
+{
+   DWORD pattern;                   //PATTERN_xxx
+   DWORD rate;                      //source only: bytes per second (0: as fast as the port is read)
+   DWORD counter;                   //counter pattern: next byte to produce (source) or expected byte (sink)
+   DWORD prbs;                      //PRBS pattern: shift register (source) or received bits (sink)
+   DWORD prbsBits;                  //PRBS pattern, sink only: number of received bits (until 15)
+   DWORD checksum;                  //sink only: CRC-32 of consumed bytes
+   DWORD sequenceErrors;            //sink only: number of bytes not matching the pattern
+   DWORD bytes;                     //number of produced (source) or consumed (sink) bytes
+   DWORD startTime;                 //system time, the port was opened
+   DWORD credit;                    //rate limited source only: number of bytes (x 1000) to be produced
+   DWORD lastTick;                  //rate limited source only: system time of last tick
+   DWORD timeout;                   //rate limited source only: handle of tick time-out (0 if none)
+   BYTE * fileData;                 //file pattern: content of the file
+   DWORD fileSize;                  //file pattern: size of the file
+   DWORD filePos;                   //file pattern: offset of next byte to produce
+   char fileName[FILENAME_LENGTH];  //file pattern: name of the file
+} SyntheticPort;
+
+
+/*----------------------------------------------------------------------------
+   Configuration of the impairment stage of a port. It impairs the data received
+   from the pair port. All probabilities are given in ppm, per byte.
+----------------------------------------------------------------------------*/
+typedef struct _ImpairConfig
+{
+   DWORD delay;               //fixed delay [ms]
+   DWORD jitter;              //max. additional random delay [ms]
+   DWORD dropRate;            //probability of a byte being dropped
+   DWORD bitErrorRate;        //probability of a bit flip within a byte
+   DWORD frameErrorRate;      //probability of a framing error
+   DWORD outageRate;          //probability of an outage to start
+   DWORD outageTime;          //duration [ms] of an outage. all bytes are dropped during an outage
+   DWORD seed;                //seed of the pseudo random number generator
+} ImpairConfig;
+
+
+//a chunk of data within the delay line
+typedef struct _ImpairChunk
+{
+   DWORD due;                 //system time, the chunk is released into the fifo
+   WORD  length;              //number of bytes
+   WORD  frameErrors;         //number of bytes with framing error
+   BOOL  message;             //the chunk is a message: it is released into the fifo as a whole only
+} ImpairChunk;
+
+
+/*----------------------------------------------------------------------------
+   Delay line of an active impairment stage (allocated, while the port is open).
+----------------------------------------------------------------------------*/
+typedef struct _ImpairLine
+{
+   DWORD random;              //state of the pseudo random number generator (xorshift32)
+   DWORD outageEnd;           //system time, the current outage ends
+   DWORD lastDue;             //release time of the youngest chunk (chunks must not overtake each other)
+   DWORD timeout;             //handle of the release time-out (0 if none)
+   DWORD put;                 //byte ring: offset to put bytes in
+   DWORD get;                 //byte ring: offset to get bytes from
+   DWORD count;               //byte ring: number of bytes
+   DWORD chunkPut;            //chunk ring: index to put chunks in
+   DWORD chunkGet;            //chunk ring: index to get chunks from
+   DWORD chunkCount;          //chunk ring: number of chunks
+   ImpairChunk chunk[IMPAIR_CHUNKS];
+   BYTE buffer[IMPAIR_BUFFER_SIZE];
+} ImpairLine;
+
+
+/*----------------------------------------------------------------------------
+   Framing stage of a port. It tracks the frame boundaries within the data received
+   from the pair port. The data itself is passed unchanged into the rx fifo, but rx
+   is signaled only once per complete frame.
+----------------------------------------------------------------------------*/
+typedef struct _FrameState
+{
+   DWORD gap;                 //Modbus only: min. gap [ms] between two frames
+   DWORD length;              //number of (unstuffed) bytes of the current frame
+   WORD  crc;                 //checksum of the current frame (FCS-16 or CRC-16)
+   BYTE  escape;              //previous byte was the escape character
+   BYTE  error;               //current frame is corrupt (e.g. invalid escape sequence)
+   DWORD lastTime;            //Modbus only: system time of the last received byte
+   DWORD timeout;             //Modbus only: handle of the gap time-out (0 if none)
+   DWORD frames;              //number of complete frames, since the port was opened
+   DWORD corruptFrames;       //number of corrupt frames (bad checksum, invalid escape sequence, too short)
+} FrameState;
+
+
+//thats an overlay for the PortData->QInAddr resp. PortData->QOutAddr.
+//it stays in the driver, also while the buffer is shared (cf. MxvcpRing)
+typedef struct _PortFifo
+{
+   BYTE * QxAddr;       // Address of the queue
+   DWORD QxSize;        // Length of queue in bytes
+   DWORD reserved[2];
+   DWORD QxCount;       // # of bytes currently in queue
+   DWORD QxGet;         // Offset into q to get bytes from
+   DWORD QxPut;         // Offset into q to put bytes in
+} PortFifo;
+
+
+/*----------------------------------------------------------------------------
+   Transformation of the data, a port receives from its pair port, if the line formats
+   (DCB) of both ends differ. All masks hold the same value in each of the four bytes,
+   so that a DWORD of data is transformed at once.
+----------------------------------------------------------------------------*/
+typedef struct _LineTransform
+{
+   DWORD flags;               //LINE_TRANSFORM_xxx (0: same line format on both ends)
+   DWORD txMask;              //data bits of the sender
+   DWORD rxMask;              //data bits of the receiver
+   DWORD fill;                //data bits of the receiver, the sender doesn't send (read as mark level)
+   BYTE txParity;             //parity of the sender (NOPARITY, ODDPARITY, ...)
+   BYTE rxParity;             //parity of the receiver
+} LineTransform;
+
+
+/*----------------------------------------------------------------------------
+   Traffic counters of a port, published to System Monitor (cf. m_PerfAddPort).
+   The counters wrap around.
+----------------------------------------------------------------------------*/
+typedef struct _PortStatistics
+{
+   DWORD bytesIn;             //number of bytes read by the application
+   DWORD bytesOut;            //number of bytes written by the application
+   DWORD overruns;            //number of writes into the rx fifo, that didn't fit completely
+   DWORD callbacks;           //number of event, rx and tx callbacks
+   DWORD rxFill;              //number of bytes in the rx fifo, as of the last rx event resp. read (also for a shared ring)
+} PortStatistics;
+
+
+/*----------------------------------------------------------------------------
+   Description of a System Monitor statistic of a port.
+----------------------------------------------------------------------------*/
+typedef struct _PerfItem
+{
+   char * name;               //name, appended to the port name
+   char * unit;
+   char * description;
+   DWORD flags;               //PERF_STAT_xxx
+} PerfItem;
+
+
+/*----------------------------------------------------------------------------
+   Receive state of a multiplexer port. It parses the frames, written by the
+   application of the multiplexer port.
+----------------------------------------------------------------------------*/
+typedef struct _MuxState
+{
+   DWORD state;               //MUX_STATE_xxx
+   DWORD count;               //number of received bytes of the information field
+   DWORD errors;              //number of discarded frames (bad FCS, unknown channel, data beyond a credit, ...)
+   BOOL  credits;             //credit based flow control is used
+   BYTE  address;             //address field of the current frame
+   BYTE  control;             //control field of the current frame
+   BYTE  length;              //length of the information field of the current frame
+   BYTE  crc;                 //checksum of the current frame
+   BYTE  info[MUX_INFO_SIZE]; //information field of the current frame
+} MuxState;
+
+
 /*----------------------------------------------------------------------------
    Contains information about an open port. The first field must be a PORTDATA_t structure; additional fields can
    contain information specific to a particular port driver. The PortOpen function returns the address of this
@@ -41,23 +301,118 @@ typedef void (_cdecl * PCommNotifyProc)(PortInformation * hPort, DWORD lReferenc
 ----------------------------------------------------------------------------*/
 struct _PortInformation
 {
-   PortData portData;   //port data: has to be first
-   char portName[PORTNAME_LENGTH];
-   char pairPortName[PORTNAME_LENGTH];
-   PortInformation * pairPort;
+   PortData portData;   //port data: has to be first (its end contains the fifo indices and dwLastReceiveTime)
+   PortFifo * rxFifo;   //rx fifo: overlay on portData.QInAddr
+   //hot: fields touched by every read and write (of this port or its pair port). keep them together,
+   //directly behind the port data, so that they share as few cache lines as possible (cf. host/bench_ports.c).
+   //the fifo buffer is a slab object of its own (cf. m_FifoOpen)
    BOOL  isOpen;
    DWORD eventMask;
+   PortInformation * pairPort;
    DWORD * eventRegister;
    PCommNotifyProc eventCallback;
-   PCommNotifyProc txCallback;
-   DWORD txCallbackParameter;
-   long txCallbackTriggerLevel;
    PCommNotifyProc rxCallback;
    DWORD rxCallbackParameter;
    long rxCallbackTriggerLevel;
+   PCommNotifyProc txCallback;
+   DWORD txCallbackParameter;
+   long txCallbackTriggerLevel;
+   ImpairLine * impairLine;         //delay line of impairment stage (NULL if stage is not active)
+   PortInformation * monitorPort;   //monitor port, that gets a copy of the data written by this port
+   DWORD portType;
+   BYTE evtChar;                    //event character (cf. EV_RXFLAG)
+   BOOL messageMode;                //a write is delivered completely or not at all
+   DWORD framing;                   //FRAMING_xxx of received data (checked on every write, cf. m_FrameScan)
+   DWORD fifoSizeBase;              //configured size of the fifo (FIFO_SIZE_1BY, unless resized)
+   DWORD fifoSizeMax;               //the fifo grows up to this size, under overrun pressure
+   DWORD fifoIdleTime;              //a grown fifo shrinks back after this time [ms] without pressure
+   DWORD fifoBusyTime;              //system time, the fifo was filled more than fifoSizeBase/2 the last time
+   DWORD fifoPressure;              //number of consecutive writes, that filled the fifo above 75% (reset below 50%)
+   PortStatistics stats;            //traffic counters (cf. System Monitor)
+   LineTransform rxTransform;       //line format transform of data received from the pair port
+   DWORD readyInterest;             //MXVCP_READY_xxx, any readiness set is interested in
+   DWORD spanLock;                  //SPAN_LOCK_xxx: a ring 0 client holds a span of the rx fifo
+   MxvcpRing * ring;                //header of the shared ring, the indices are published to (NULL if not shared)
+   DWORD rxIntervalTime;            //rx callback, if no data is received for this time [ms] (0: off)
+   WheelTimer rxIntervalTimer;      //checks the rx interval, while there is data below the rx trigger level
+   //cold: configuration and state of optional features, names (used on open and close only)
+   DWORD fifoReleaseTimeout;        //handle of the time-out to release the fifo buffer, after the port was closed
+   BOOL  fifoAdaptPending;          //a change of the fifo size is scheduled (cf. m_FifoAdapt)
+   DWORD fifoNeeded;                //free space [bytes], the scheduled change shall provide (0: shrink, if idle)
+   DWORD ringHandle;                //memory handle of the shared ring (0 if the rx fifo is not shared)
+   DWORD ringPages;                 //number of pages of the shared ring
+   DWORD ownerProcess;              //Win32 process, that opened the port (cf. MXVCP_IOCTL_TRANSFER, _RING_MAP)
+   DWORD spanPut;                   //SPAN_LOCK_WRITE only: offset of the reserved space in the rx fifo
+   DWORD spanLength;                //SPAN_LOCK_WRITE only: number of reserved bytes
+   FrameState frame;                //framing stage (framing ports only)
+   PortInformation * monitoredPort; //monitor port only: a port of the monitored pair
+   DWORD monitorDropped;            //monitor port only: number of records dropped due to a full fifo
+   ImpairConfig impairConfig;       //impairment of received data (all zero: no impairment)
+   SyntheticPort synthetic;         //source and sink ports only
+   PortInformation * muxPort;       //channel port only: its multiplexer port
+   DWORD muxChannel;                //channel port only: channel number (DLCI)
+   DWORD muxTxCredits;              //channel port only: number of frames, the port may send
+   DWORD muxRxCredits;              //channel port only: number of frames, the peer may send
+   MuxState mux;                    //multiplexer port only
+   _DCB dcb;                        //line format and settings (cf. m_PortSetCommState)
+   PerfStat perfStat[PERF_STATS];   //System Monitor statistics (perfStat[0].name is NULL, if not registered)
+   char perfName[PERF_STATS][PERF_NAME_LENGTH];
+   char portName[PORTNAME_LENGTH];
+   char pairPortName[PORTNAME_LENGTH];
 };
 
 
+/*----------------------------------------------------------------------------
+   State of the traffic capture. The records are collected in one buffer (at any time),
+   while the other one is written to file (outside of interrupt time).
+----------------------------------------------------------------------------*/
+typedef struct _CaptureState
+{
+   DWORD file;                //ring 0 file handle (0 if capture is not active)
+   DWORD filePos;             //current write position within the file
+   BYTE * buffer[2];          //double buffer
+   DWORD fill[2];             //number of bytes in buffer
+   DWORD active;              //index of the buffer, that is currently filled
+   DWORD flushPending;        //an event to write the other buffer is scheduled
+   DWORD dropped;             //number of records dropped, as both buffers were full
+   BOOL  calls;               //the port function calls are recorded too (cf. MXVCP_CAPTURE_CALLS)
+} CaptureState;
+
+
+/*----------------------------------------------------------------------------
+   Readiness set of a client (cf. MXVCP_IOCTL_READY_SET). The ready bits are set at the
+   points, where rx data arrives resp. tx space is freed. They are only a hint, the
+   readiness is checked again when the client retrieves the ready ports.
+----------------------------------------------------------------------------*/
+typedef struct _ReadySet
+{
+   DWORD hDevice;                      //handle of the driver, owning the set (0 if the set is unused)
+   DWORD tagProcess;                   //process, owning the set
+   DWORD interest[NUMBER_OF_PORTS];    //MXVCP_READY_xxx per port (index as in m_PortInformation)
+   DWORD ready[READY_WORDS];           //bit per port index: port may be ready
+   DWORD waitEvent;                    //event of pending overlapped wait (0 if none)
+   BOOL  wakePending;                  //completion of the wait is scheduled
+} ReadySet;
+
+
+/*----------------------------------------------------------------------------
+   State of the replay of a capture file into a port.
+----------------------------------------------------------------------------*/
+typedef struct _ReplayState
+{
+   PortInformation * port;    //port, the data is replayed into (NULL if replay is not active)
+   BYTE * data;               //content of the capture file
+   DWORD size;                //size of the capture file
+   DWORD pos;                 //offset of the current record
+   DWORD offset;              //number of data bytes of the current record, already replayed
+   DWORD flags;               //MXVCP_REPLAY_xxx
+   BOOL  started;             //the timing base (startTime, firstRecordTime) is set
+   DWORD startTime;           //system time, the replay was started
+   DWORD firstRecordTime;     //time stamp of the first replayed record
+   DWORD timeout;             //handle of pending time-out (0 if none)
+} ReplayState;
+
+
 /*----------------------------------------------------------------------------
    Contains the addresses of port-driver functions. If a port driver
    does not provide a particular function, the corresponding field
@@ -72,7 +427,7 @@ typedef struct _PortFunctionTable
    BOOL (_cdecl *pPortTransmitChar)(PortInformation * hPort, DWORD ch);
    BOOL (_cdecl *pPortClose)(PortInformation * hPort); //address of PortClose
    BOOL (_cdecl *pPortGetQueueStatus)(PortInformation * hPort, _COMSTAT * cmst);
-   BOOL (_cdecl *pPortClearError)(PortInformation * hPort, _COMSTAT * cmst);
+   BOOL (_cdecl *pPortClearError)(PortInformation * hPort, _COMSTAT * cmst, DWORD * lpErrors);
    BOOL (_cdecl *pPortSetModemStatusShadow)(PortInformation * hPort, DWORD dwEventMask, BYTE * MSRShadow);
    BOOL (_cdecl *pPortGetProperties)(PortInformation * hPort, _COMMPROP * cmmp);
    BOOL (_cdecl *pPortEscapeFunction)(PortInformation * hPort, DWORD lFunc, DWORD InData, DWORD * OutData);
@@ -124,10 +479,13 @@ static BOOL _cdecl m_PortSetCommState(PortInformation * hPort, _DCB * dcbPort, D
 static BOOL _cdecl m_PortGetModemStatus(PortInformation * hPort, DWORD * dwModemStatus);
 static BOOL _cdecl m_PortSetModemStatusShadow(PortInformation * hPort, DWORD dwEventMask, BYTE * MSRShadow);
 
-static BOOL _cdecl m_PortClearError(PortInformation * hPort, _COMSTAT * cmst);
+static BOOL _cdecl m_PortClearError(PortInformation * hPort, _COMSTAT * cmst, DWORD * lpErrors);
 static BOOL _cdecl m_PortGetWin32Error(PortInformation * hPort, DWORD * dwError);
 static BOOL _cdecl m_PortEscapeFunction(PortInformation * hPort, DWORD lFunc, DWORD InData, DWORD * OutData);
 
+static void m_ReadyNotify(PortInformation * hPort, DWORD events);
+static void m_PortReadDone(PortInformation * hPort, DWORD fifoCountBefore, DWORD received);
+
 
 
 
@@ -160,8 +518,22 @@ static PortFunctionTable m_PortFunctionTable =
    NULL
 };
 static PortInformation m_PortInformation[NUMBER_OF_PORTS];
-static BYTE m_FifoBuffer[NUMBER_OF_PORTS][FIFO_SIZE_1BY]; //each port has only an input (receive) buffer.
 static unsigned int m_NextFreePort;
+static char m_CaptureFileName[FILENAME_LENGTH];
+static char m_ReplayFileName[FILENAME_LENGTH];
+static CaptureState m_Capture;
+static ReplayState m_Replay;
+static ReadySet m_ReadySets[READY_SETS];
+static DWORD m_PerfServer; //handle of the System Monitor server (0 if PERF VxD is not loaded)
+static PerfServer m_PerfServerInfo = { 0, 0, "Virtual COM-Ports (MXVCP)", "MXVCP", NULL };
+static PerfItem const m_PerfItems[PERF_STATS] =
+{
+   { "Bytes read",      "Bytes/s",  "Bytes read by the application per second",                     PERF_STAT_COUNT },
+   { "Bytes written",   "Bytes/s",  "Bytes written by the application per second",                  PERF_STAT_COUNT },
+   { "Rx fifo fill",    "Bytes",    "Number of bytes in the receive buffer",                        0 },
+   { "Overruns",        "1/s",      "Writes into the receive buffer per second, that didn't fit",   PERF_STAT_COUNT },
+   { "Callbacks",       "1/s",      "Event, receive and transmit callbacks per second",             PERF_STAT_COUNT },
+};
 
 //for debugging purpose in combination with SHELL_SendMessage
 #if 0
@@ -176,27 +548,34 @@ static unsigned int m_NextFreePort;
 
 /* -- Implementation ------------------------------------------------------ */
 
-
-//thats an overlay for the PortData->QInAddr resp. PortData->QOutAddr
-typedef struct _PortFifo
+//publish the indices of the rx fifo of a port to the client of its shared ring (cf. MxvcpRing).
+//the client only reads them, the driver uses its own ones
+static __inline void m_RingPublish(PortInformation * hPort)
 {
-   BYTE * QxAddr;       // Address of the queue
-   DWORD QxSize;        // Length of queue in bytes
-   DWORD reserved[2];
-   DWORD QxCount;       // # of bytes currently in queue
-   DWORD QxGet;         // Offset into q to get bytes from
-   DWORD QxPut;         // Offset into q to put bytes in
-} PortFifo;
+   MxvcpRing * const ring = hPort->ring;
+   if (ring)
+   {
+      PortFifo * const fifo = hPort->rxFifo;
+      //a writer (at interrupt time) must not change the indices in between
+      ENTER_CRITICAL();
+      ring->get = fifo->QxGet;
+      ring->put = fifo->QxPut;
+      ring->count = fifo->QxCount;
+      LEAVE_CRITICAL();
+   }
+}
+
 
 static __inline void m_FifoInit(PortInformation * hPort, BYTE * buffer, DWORD size)
 {
    //initialize input (receive) buffer
-   PortFifo * fifo = (PortFifo *)&(hPort->portData.QInAddr);
+   PortFifo * fifo = hPort->rxFifo;
    fifo->QxAddr = buffer;
    fifo->QxSize = size;
    fifo->QxCount = 0;
    fifo->QxGet = 0;
    fifo->QxPut = 0;
+   hPort->stats.rxFill = 0;
    /*initialize output (send) buffer
    //there is no need for output (send) buffer, as we will write directly into the fifo of pair port
    fifo = (PortFifo *)&(hPort->portData.QOutAddr);
@@ -211,10 +590,13 @@ static __inline void m_FifoInit(PortInformation * hPort, BYTE * buffer, DWORD si
 static __inline void m_FifoFlush(PortInformation * hPort)
 {
    //flush input (receive) buffer
-   PortFifo * fifo = (PortFifo *)&(hPort->portData.QInAddr);
+   PortFifo * fifo = hPort->rxFifo;
    fifo->QxCount = 0;
    fifo->QxGet = 0;
    fifo->QxPut = 0;
+   hPort->spanLength = 0; //a reserved span is void (no other writer until it is published)
+   hPort->stats.rxFill = 0;
+   m_RingPublish(hPort);
    /*flush output (send) buffer
    fifo = (PortFifo *)&(hPort->portData.QOutAddr);
    fifo->QxCount = 0;
@@ -223,11 +605,167 @@ static __inline void m_FifoFlush(PortInformation * hPort)
    */
 }
 
+//replace the fifo buffer by another one (of different size). the buffered bytes are migrated
+//to the start of the new buffer, which must be large enough. callable at interrupt time.
+//readers and writers access the buffer within a critical section only, so none of them is
+//interrupted while it copies from resp. into the old buffer.
+static void m_FifoMigrate(PortInformation * hPort, BYTE * buffer, DWORD size)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   BYTE * old;
+   DWORD num;
+
+   ENTER_CRITICAL();
+   old = fifo->QxAddr;
+   num = fifo->QxSize - fifo->QxGet;
+   if (num > fifo->QxCount) num = fifo->QxCount;
+   stdutils_memcpy(buffer, &old[fifo->QxGet], num);
+   stdutils_memcpy(&buffer[num], old, fifo->QxCount - num);
+   fifo->QxAddr = buffer;
+   fifo->QxSize = size;
+   fifo->QxGet = 0;
+   fifo->QxPut = fifo->QxCount;
+   LEAVE_CRITICAL();
+   slab_free(old);
+}
+
+
+static void _cdecl m_FifoAdapt(DWORD refData);
+static void m_ImpairRelease(PortInformation * hPort);
+
+//register based event callback (reference data in EDX)
+REGISTER_CALLBACK(m_FifoAdaptEvent, m_FifoAdapt)
+
+
+//schedule a change of the fifo size (outside of interrupt time, as the slab may have to grow).
+//needed: free space [bytes] to provide, 0 to shrink back. callable at interrupt time.
+static void m_FifoAdaptLater(PortInformation * hPort, DWORD needed)
+{
+   ENTER_CRITICAL();
+   if (needed > hPort->fifoNeeded)
+   {
+      hPort->fifoNeeded = needed;
+   }
+   if (!hPort->fifoAdaptPending)
+   {
+      hPort->fifoAdaptPending = 1;
+      Event_ScheduleGlobal(&m_FifoAdaptEvent, (DWORD)(hPort - m_PortInformation));
+   }
+   LEAVE_CRITICAL();
+}
+
+
+//request to double the size of the fifo buffer (up to the limit of the port), until there is space for
+//count bytes. callable at interrupt time.
+static void m_FifoGrow(PortInformation * hPort, DWORD count)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   if ((fifo->QxSize < hPort->fifoSizeMax) && (fifo->QxAddr != NULL) && !hPort->ringHandle && !hPort->spanLock)
+   {
+      m_FifoAdaptLater(hPort, count);
+   }
+}
+
+
+//return the size, the fifo of a port can reach (a shared ring keeps its size)
+static DWORD m_FifoSizeLimit(PortInformation * hPort)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   return (hPort->ringHandle || (fifo->QxSize > hPort->fifoSizeMax)) ? fifo->QxSize : hPort->fifoSizeMax;
+}
+
+
+//return TRUE if a grown fifo shall shrink back to its configured size (it was idle for a while)
+static BOOL m_FifoIdle(PortInformation * hPort)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   return (fifo->QxSize > hPort->fifoSizeBase) && (fifo->QxCount <= hPort->fifoSizeBase/2) &&
+          ((System_GetTime() - hPort->fifoBusyTime) >= hPort->fifoIdleTime);
+}
+
+
+//request to shrink a grown fifo back to its configured size, if it was idle for a while. callable at interrupt time.
+static void m_FifoShrink(PortInformation * hPort)
+{
+   if (m_FifoIdle(hPort) && !hPort->fifoAdaptPending && !hPort->ringHandle && !hPort->spanLock)
+   {
+      m_FifoAdaptLater(hPort, 0);
+   }
+}
+
+
+//change the fifo size as requested by m_FifoGrow resp. m_FifoShrink.
+//called as global event (outside of interrupt time). see m_FifoAdaptEvent.
+static void _cdecl m_FifoAdapt(DWORD refData)
+{
+   PortInformation * const hPort = &m_PortInformation[refData];
+   PortFifo * fifo = hPort->rxFifo;
+   DWORD size = fifo->QxSize;
+   DWORD needed;
+   BYTE * buffer;
+
+   ENTER_CRITICAL();
+   needed = hPort->fifoNeeded;
+   hPort->fifoNeeded = 0;
+   hPort->fifoAdaptPending = 0;
+   LEAVE_CRITICAL();
+   if (!hPort->isOpen || (fifo->QxAddr == NULL) || hPort->ringHandle || hPort->spanLock)
+   {
+      return; //the client of the shared ring resp. of a span relies on the address and size of the buffer
+   }
+   if (needed)
+   {
+      while ((size < hPort->fifoSizeMax) && ((size - fifo->QxCount) < needed))
+      {
+         size *= 2;
+      }
+      if (size > hPort->fifoSizeMax)
+      {
+         size = hPort->fifoSizeMax;
+      }
+   }
+   else if (m_FifoIdle(hPort))
+   {
+      size = hPort->fifoSizeBase;
+   }
+   if (size == fifo->QxSize)
+   {
+      return;
+   }
+   buffer = slab_alloc_grow(size);
+   if (buffer == NULL)
+   {
+      return;
+   }
+   //the buffered bytes may have changed meanwhile
+   ENTER_CRITICAL();
+   if ((fifo->QxCount > size) || hPort->ringHandle || hPort->spanLock)
+   {
+      LEAVE_CRITICAL();
+      slab_free(buffer);
+      return;
+   }
+   m_FifoMigrate(hPort, buffer, size);
+   hPort->fifoPressure = 0;
+   LEAVE_CRITICAL();
+   //a message, that waits in the delay line for space, may fit now
+   if (hPort->impairLine)
+   {
+      m_ImpairRelease(hPort);
+   }
+   if (needed && hPort->pairPort)
+   {
+      m_ReadyNotify(hPort->pairPort, MXVCP_READY_TX);
+   }
+}
+
+
 //return number of written bytes
 static __inline DWORD m_FifoWrite(PortInformation * hPort, BYTE * data, DWORD count)
 {
-   PortFifo * fifo = (PortFifo *)&(hPort->portData.QInAddr);
-   DWORD space = fifo->QxSize - fifo->QxCount;
+   PortFifo * fifo = hPort->rxFifo;
+   DWORD space;
+   DWORD fill;
    DWORD written = 0;
 
    //normaly this should always be false
@@ -237,26 +775,64 @@ static __inline DWORD m_FifoWrite(PortInformation * hPort, BYTE * data, DWORD co
       return 0;
    }
 
-   //
+   //another writer or a reader (at interrupt time) must not interrupt the copy (cf. m_FifoMigrate)
+   ENTER_CRITICAL();
+   //space, that a ring 0 client has reserved at the put offset, is filled in place (cf. m_SpanReserve).
+   //no other writer until it is published
+   if (hPort->spanLock & SPAN_LOCK_WRITE)
+   {
+      hPort->stats.overruns++;
+      LEAVE_CRITICAL();
+      return 0;
+   }
+
+   //grow the fifo, if consecutive writes would fill it more than 75% (i.e. keep 25% headroom),
+   //without being read below 50% in between
+   fill = fifo->QxCount + count;
+   if (fill > (fifo->QxSize - fifo->QxSize/4))
+   {
+      if (++hPort->fifoPressure >= FIFO_GROW_PRESSURE)
+      {
+         m_FifoGrow(hPort, count + fifo->QxSize/4);
+      }
+   }
+   else if (fill <= fifo->QxSize/2)
+   {
+      hPort->fifoPressure = 0;
+   }
+   space = fifo->QxSize - fifo->QxCount;
+
+   //copy in (at most) two blocks: up to the end of the buffer, and after wrap around
    while (count && space)
    {
-      fifo->QxAddr[fifo->QxPut++] = *data++;
+      DWORD num = fifo->QxSize - fifo->QxPut;
+      if (num > space) num = space;
+      if (num > count) num = count;
+      stdutils_memcpy(&fifo->QxAddr[fifo->QxPut], data, num);
+      fifo->QxPut += num;
       if (fifo->QxPut >= fifo->QxSize) //wrap around
       {
          fifo->QxPut = 0;
       }
-      written++;
-      space--;
-      count--;
+      data += num;
+      written += num;
+      space -= num;
+      count -= num;
    }
    if (written) fifo->QxCount += written; //increment by number of written chars
+   if (count) hPort->stats.overruns++; //not all data did fit
+   if (fifo->QxCount > hPort->fifoSizeBase/2)
+   {
+      hPort->fifoBusyTime = System_GetTime();
+   }
+   LEAVE_CRITICAL();
    return written;
 }
 
 //return number of read bytes
 static __inline DWORD m_FifoRead(PortInformation * hPort, BYTE * buffer, DWORD size)
 {
-   PortFifo * fifo = (PortFifo *)&(hPort->portData.QInAddr);
+   PortFifo * fifo = hPort->rxFifo;
    DWORD count = fifo->QxCount;
    DWORD read = 0;
 
@@ -267,98 +843,3328 @@ static __inline DWORD m_FifoRead(PortInformation * hPort, BYTE * buffer, DWORD s
       return 0;
    }
 
-   //
+   //a writer (at interrupt time) must not exchange the buffer (cf. m_FifoMigrate), while it is read
+   ENTER_CRITICAL();
+
+   //copy out (at most) two blocks: up to the end of the buffer, and after wrap around
    while (count && size)
    {
-      *buffer++ = fifo->QxAddr[fifo->QxGet++];
+      DWORD num = fifo->QxSize - fifo->QxGet;
+      if (num > count) num = count;
+      if (num > size) num = size;
+      stdutils_memcpy(buffer, &fifo->QxAddr[fifo->QxGet], num);
+      fifo->QxGet += num;
       if (fifo->QxGet >= fifo->QxSize) //wrap around
       {
          fifo->QxGet = 0;
       }
-      count--;
-      read++;
-      size--;
+      buffer += num;
+      count -= num;
+      read += num;
+      size -= num;
    }
    if (read) fifo->QxCount -= read; //decrement by number of read chars
+   LEAVE_CRITICAL();
+   m_FifoShrink(hPort);
    return read;
 }
 
 //return number of bytes in RX fifo
 static __inline DWORD m_FifoCount(PortInformation * hPort)
 {
-   PortFifo * fifo = (PortFifo *)&(hPort->portData.QInAddr);
+   PortFifo * fifo = hPort->rxFifo;
    return fifo->QxCount;
 }
 
+//return current size of RX fifo
+static __inline DWORD m_FifoSize(PortInformation * hPort)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   return fifo->QxSize;
+}
 
+//return the fill state of the tx fifo of the pair port, that is "emulated" by the rx fifo of this port (with fifoCount
+//bytes): the bytes above half of the configured size. a grown fifo takes more, but doesn't make the tx fifo larger
+static __inline DWORD m_TxFifoCount(PortInformation * hPort, DWORD fifoCount)
+{
+   DWORD const halfSize = hPort->fifoSizeBase/2;
+   return (fifoCount > halfSize) ? (fifoCount - halfSize) : 0;
+}
 
 
+static void _cdecl m_FifoReleaseTimeout(DWORD refData);
 
+//time-out callback (register based). the reference data is passed in edx
+REGISTER_CALLBACK(m_FifoReleaseTimeoutCallback, m_FifoReleaseTimeout)
 
 
+//return the fifo buffer of a port to the slab. the port must be closed
+static void m_FifoRelease(PortInformation * hPort)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   if (hPort->ringHandle)
+   {
+      //the buffer of a shared ring is part of its pages
+      MxvcpRing * const ring = hPort->ring;
+      hPort->ring = NULL;
+      Page_UnmapGlobal(ring, hPort->ringPages);
+      Page_Free(hPort->ringHandle);
+      hPort->ringHandle = 0;
+      m_FifoInit(hPort, NULL, 0);
+   }
+   else if (fifo->QxAddr)
+   {
+      slab_free(fifo->QxAddr);
+      m_FifoInit(hPort, NULL, 0);
+   }
+}
 
 
 /*----------------------------------------------------------------------------
-   \brief Initialize port driver.
+   \brief Move the rx fifo buffer of an open port into pages of the shared arena, so that a Win32
+   client can access it directly (cf. MXVCP_IOCTL_RING_MAP). The buffered bytes are migrated.
 
-   This function gets called from the VxDs control function "MXVCP_Control"
-   on reception of a system message.
-   It registers itself as a port driver with VCOMM. VCOMM will call back the given
-   function (m_DriverControl) to complete initialization by initialization
-   of the available ports.
+   The pages start with a header (MxvcpRing), the indices are published to. The address, size
+   and indices, the driver uses, stay in the driver (rx fifo overlay), as any process can write
+   to the shared arena. The shared ring keeps its size (no growth or shrinking), until the port
+   is closed. Must not be called at interrupt time.
+
+   \param   hPort    port
+
+   \retval  TRUE     if successful (or the ring is already shared)
+   \retval  FALSE    if there is no memory
+----------------------------------------------------------------------------*/
+static BOOL m_RingMap(PortInformation * hPort)
+{
+   PortFifo * const fifo = hPort->rxFifo;
+   MxvcpRing * ring;
+   BYTE * data;
+   BYTE * old;
+   DWORD handle;
+   DWORD pages;
+   DWORD size;
+   DWORD num;
+   void * memory;
+
+   if (hPort->ringHandle)
+   {
+      return 1;
+   }
+   if (hPort->spanLock)
+   {
+      return 0; //the buffer is in use by a ring 0 client
+   }
+   for (;;)
+   {
+      size = m_FifoSize(hPort);
+      pages = (sizeof(MxvcpRing) + size + PAGE_SIZE - 1) / PAGE_SIZE;
+      memory = Page_Allocate(pages, &handle);
+      if (memory == NULL)
+      {
+         return 0;
+      }
+      ring = (MxvcpRing *)Page_MapGlobal(memory, pages);
+      if (ring == NULL)
+      {
+         Page_Free(handle);
+         return 0;
+      }
+      //a writer (at interrupt time) must not access the fifo in between
+      ENTER_CRITICAL();
+      if ((fifo->QxSize == size) && !hPort->ringHandle && !hPort->spanLock)
+      {
+         break;
+      }
+      //the fifo was resized (cf. m_FifoAdapt), shared or reserved, while the pages were allocated
+      LEAVE_CRITICAL();
+      Page_UnmapGlobal(ring, pages);
+      Page_Free(handle);
+      if (hPort->ringHandle || hPort->spanLock)
+      {
+         return (hPort->ringHandle != 0);
+      }
+   }
+   //the data follows the header
+   data = MXVCP_RING_DATA(ring);
+   ring->size = size;
+   old = fifo->QxAddr;
+   num = fifo->QxSize - fifo->QxGet;
+   if (num > fifo->QxCount)
+   {
+      num = fifo->QxCount;
+   }
+   stdutils_memcpy(data, &old[fifo->QxGet], num);
+   stdutils_memcpy(&data[num], old, fifo->QxCount - num);
+   fifo->QxAddr = data;
+   fifo->QxGet = 0;
+   fifo->QxPut = (fifo->QxCount < size) ? fifo->QxCount : 0;
+   hPort->ring = ring;
+   hPort->ringHandle = handle;
+   hPort->ringPages = pages;
+   m_RingPublish(hPort);
+   LEAVE_CRITICAL();
+   slab_free(old);
+   return 1;
+}
+
+
+//the grace period after the port was closed has elapsed
+static void _cdecl m_FifoReleaseTimeout(DWORD refData)
+{
+   PortInformation * const hPort = &m_PortInformation[refData];
+   hPort->fifoReleaseTimeout = 0;
+   if (!hPort->isOpen)
+   {
+      m_FifoRelease(hPort);
+   }
+}
+
+
+//get a fifo buffer, when the port is opened. return FALSE if there is no memory.
+//the buffer of a port, that was closed recently, is still there (cf. m_FifoClose)
+static BOOL m_FifoOpen(PortInformation * hPort)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   BYTE * buffer;
+
+   //the release time-out must not elapse in between
+   ENTER_CRITICAL();
+   if (hPort->fifoReleaseTimeout)
+   {
+      Timer_CancelTimeOut(hPort->fifoReleaseTimeout);
+      hPort->fifoReleaseTimeout = 0;
+   }
+   LEAVE_CRITICAL();
+   hPort->spanLock = 0; //spans of the previous session are void
+   hPort->fifoPressure = 0;
+   if (fifo->QxAddr)
+   {
+      m_FifoFlush(hPort);
+      m_FifoShrink(hPort);
+      return 1;
+   }
+   buffer = slab_alloc_grow(hPort->fifoSizeBase);
+   if (buffer == NULL)
+   {
+      return 0;
+   }
+   m_FifoInit(hPort, buffer, hPort->fifoSizeBase);
+   return 1;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Resize the fifo of an open port. The buffered bytes are preserved.
+
+   The new size is the configured size of the fifo from now on (it still grows
+   temporarily up to its limit, under overrun pressure). The rx trigger level of
+   the port and the tx trigger level of its pair port (whose tx fifo is emulated
+   by this fifo) are limited to the new size. Callable at interrupt time.
+
+   \param   hPort    port
+   \param   size     new size of the fifo [bytes]
+
+   \retval  TRUE     if successful
+   \retval  FALSE    if the size is invalid, there is no memory or the buffered
+                     bytes don't fit into the new size
+----------------------------------------------------------------------------*/
+static BOOL m_FifoResize(PortInformation * hPort, DWORD size)
+{
+   PortFifo * fifo = hPort->rxFifo;
+   BYTE * buffer;
+
+   if ((size < FIFO_SIZE_MIN) || (size > FIFO_SIZE_MAX) || (fifo->QxAddr == NULL) || hPort->ringHandle ||
+       hPort->spanLock)
+   {
+      return 0;
+   }
+   buffer = slab_alloc(size);
+   if (buffer == NULL)
+   {
+      return 0;
+   }
+   //no write must happen between the check, the migration and the update of the trigger levels
+   ENTER_CRITICAL();
+   if (fifo->QxCount > size)
+   {
+      LEAVE_CRITICAL();
+      slab_free(buffer);
+      return 0;
+   }
+   m_FifoMigrate(hPort, buffer, size);
+   hPort->fifoSizeBase = size;
+   if (hPort->fifoSizeMax < size)
+   {
+      hPort->fifoSizeMax = size;
+   }
+   if (hPort->rxCallbackTriggerLevel > (long)size)
+   {
+      hPort->rxCallbackTriggerLevel = size;
+   }
+   if (hPort->pairPort && (hPort->pairPort->txCallbackTriggerLevel > (long)(size/2 - 1)))
+   {
+      hPort->pairPort->txCallbackTriggerLevel = size/2 - 1;
+   }
+   LEAVE_CRITICAL();
+   return 1;
+}
+
+
+//release the fifo buffer of a port, that is closed (after a grace period, to avoid churn on re-open).
+//a shared ring is released at once: its pages must not be freed at interrupt time, and it is void anyway
+static void m_FifoClose(PortInformation * hPort)
+{
+   if (hPort->ringHandle)
+   {
+      m_FifoRelease(hPort);
+      return;
+   }
+   hPort->fifoReleaseTimeout = Timer_SetGlobalTimeOut(FIFO_RELEASE_TIME, (DWORD)(hPort - m_PortInformation),
+                                                      &m_FifoReleaseTimeoutCallback);
+   if (hPort->fifoReleaseTimeout == 0)
+   {
+      m_FifoRelease(hPort);
+   }
+}
+
+
+//scan data, that is put into the rx fifo of a port, for the event character.
+//return EV_RXFLAG if found (and the event is enabled), otherwise 0
+static __inline DWORD m_EventCharScan(PortInformation * hPort, BYTE * data, DWORD count)
+{
+   if ((hPort->eventMask & EV_RXFLAG) && stdutils_memchr(data, hPort->evtChar, count))
+   {
+      return EV_RXFLAG;
+   }
+   return 0;
+}
+
+
+//return the number of bytes, a port can receive at once (into its rx fifo, resp. the delay line of its impairment stage).
+//the rx fifo is grown (later), if needed bytes don't fit in
+static DWORD m_PortRxSpace(PortInformation * hPort, DWORD needed)
+{
+   ImpairLine * const line = hPort->impairLine;
+   if (line)
+   {
+      return (line->chunkCount < IMPAIR_CHUNKS) ? (IMPAIR_BUFFER_SIZE - line->count) : 0;
+   }
+   if ((m_FifoSize(hPort) - m_FifoCount(hPort)) < needed)
+   {
+      m_FifoGrow(hPort, needed);
+   }
+   return m_FifoSize(hPort) - m_FifoCount(hPort);
+}
+
+
+//timer of the rx interval of a port (cf. registry value "ReadIntervalTimeout"): if no data was received
+//for the interval, the rx callback is called, even though the rx trigger level is not reached (like the
+//character time-out of a 16550). called at interrupt time (cf. wheel.h), like a UART calls the rx callback
+//from its interrupt handler
+static void m_PortRxInterval(DWORD refData)
+{
+   PortInformation * const hPort = &m_PortInformation[refData];
+   DWORD const due = hPort->portData.dwLastReceiveTime + hPort->rxIntervalTime;
+   DWORD fifoCount;
+
+   if (!hPort->isOpen || (hPort->rxCallback == NULL))
+   {
+      return;
+   }
+   if ((LONG)(due - System_GetTime()) > 0)
+   {
+      wheel_arm(&hPort->rxIntervalTimer, due, m_PortRxInterval, refData); //data was received meanwhile
+      return;
+   }
+   fifoCount = m_FifoCount(hPort);
+   if (fifoCount && (fifoCount < (DWORD)(hPort->rxCallbackTriggerLevel)))
+   {
+      hPort->stats.callbacks++;
+      hPort->rxCallback(hPort, hPort->rxCallbackParameter, CN_RECEIVE, 0);
+   }
+}
+
+
+//issue rx events (and rx callback) of a port, after data was put into its rx fifo
+//(events: additional rx events, like EV_RXFLAG)
+static void m_PortSignalReceive(PortInformation * hPort, DWORD events)
+{
+   m_ReadyNotify(hPort, MXVCP_READY_RX);
+   hPort->stats.rxFill = m_FifoCount(hPort);
+   m_RingPublish(hPort);
+   hPort->portData.dwLastReceiveTime = System_GetTime();
+   //the interval timer is armed once. on expiry, it checks the time of the last reception
+   if (hPort->rxIntervalTime && !wheel_armed(&hPort->rxIntervalTimer))
+   {
+      wheel_arm(&hPort->rxIntervalTimer, hPort->portData.dwLastReceiveTime + hPort->rxIntervalTime,
+                m_PortRxInterval, (DWORD)(hPort - m_PortInformation));
+   }
+   events |= EV_RXCHAR;
+   *hPort->eventRegister |= events;
+   if (hPort->eventCallback)
+   {
+      events &= hPort->eventMask;
+      if (events)
+      {
+         hPort->stats.callbacks++;
+         hPort->eventCallback(hPort, hPort->portData.dwClientRefData, CN_EVENT, events);
+      }
+   }
+   if (hPort->rxCallback)
+   {
+      DWORD fifoCount = m_FifoCount(hPort);
+      if (fifoCount >= (DWORD)(hPort->rxCallbackTriggerLevel))
+      {
+         hPort->stats.callbacks++;
+         hPort->rxCallback(hPort, hPort->rxCallbackParameter, CN_RECEIVE, 0);
+      }
+   }
+}
+
+//report line errors (CE_xxx) of received data (cf. m_PortClearError)
+static void m_PortSignalError(PortInformation * hPort, DWORD errors)
+{
+   hPort->portData.dwCommError |= errors;
+   *hPort->eventRegister |= EV_ERR;
+   if ((hPort->eventMask & EV_ERR) && hPort->eventCallback)
+   {
+      hPort->stats.callbacks++;
+      hPort->eventCallback(hPort, hPort->portData.dwClientRefData, CN_EVENT, EV_ERR);
+   }
+}
+
+
+//return the parity bit, the given parity type yields for each byte of data (bit 0 of each byte)
+static __inline DWORD m_LineParity(DWORD data, BYTE parity)
+{
+   //fold all bits of each byte into its bit 0 (the bytes don't mix, as only their bit 0 is kept)
+   data ^= data >> 4;
+   data ^= data >> 2;
+   data ^= data >> 1;
+   data &= LINE_BYTES;
+   switch (parity)
+   {
+   case EVENPARITY:  return data;
+   case ODDPARITY:   return data ^ LINE_BYTES;
+   case SPACEPARITY: return 0;
+   default:          return LINE_BYTES; //mark parity, or stop bit instead of a parity bit
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Transform data, sent with the line format of the pair port, to the line format
+   of the receiving port. The data is processed a DWORD at once.
+
+   A receiver with more data bits than the sender reads the missing bits as mark level
+   (i.e. 1). Parity bits and stop bits of the sender are not shifted into the data bits
+   of the receiver.
+
+   \param   transform   transform of the receiving port
+   \param   data        data to transform (in place)
+   \param   count       number of bytes
+
+   \return  line errors (CE_RXPARITY, CE_FRAME)
+----------------------------------------------------------------------------*/
+static DWORD m_LineTransform(LineTransform const * transform, BYTE * data, DWORD count)
+{
+   DWORD const mask = transform->txMask & transform->rxMask;
+   DWORD parityErrors = 0;
+
+   while (count)
+   {
+      DWORD const num = (count < 4) ? count : 4;
+      DWORD const valid = 0xFFFFFFFF >> ((4 - num) * 8); //bytes of the DWORD holding data
+      DWORD sent = 0;
+      DWORD received;
+
+      if (num == 4)
+      {
+         sent = *(DWORD *)data; //x86 tolerates unaligned access
+      }
+      else
+      {
+         stdutils_memcpy(&sent, data, num);
+      }
+      received = (sent & mask) | transform->fill;
+      if (transform->flags & LINE_TRANSFORM_PARITY)
+      {
+         parityErrors |= (m_LineParity(sent & transform->txMask, transform->txParity) ^
+                          m_LineParity(received, transform->rxParity)) & valid;
+      }
+      if (num == 4)
+      {
+         *(DWORD *)data = received;
+      }
+      else
+      {
+         stdutils_memcpy(data, &received, num);
+      }
+      data += num;
+      count -= num;
+   }
+   return (parityErrors ? CE_RXPARITY : 0) | ((transform->flags & LINE_TRANSFORM_BAUD) ? CE_FRAME : 0);
+}
+
+
+//compute the transform of data, received by hPort from a sender with the given line format
+static void m_LineCompute(PortInformation * hPort, _DCB const * sender)
+{
+   LineTransform * const transform = &hPort->rxTransform;
+   _DCB const * const receiver = &hPort->dcb;
+   BOOL const checkParity = (receiver->BitMask & fParity) && (receiver->Parity != NOPARITY);
+   LineTransform t;
+
+   t.txMask = LINE_BYTES * (BYTE)((1 << sender->ByteSize) - 1);
+   t.rxMask = LINE_BYTES * (BYTE)((1 << receiver->ByteSize) - 1);
+   t.fill = t.rxMask & ~t.txMask;
+   t.txParity = sender->Parity;
+   t.rxParity = receiver->Parity;
+   t.flags = 0;
+   if (t.txMask != t.rxMask)
+   {
+      t.flags |= LINE_TRANSFORM_DATA;
+   }
+   if (checkParity && ((t.txParity != t.rxParity) || (t.txMask != t.rxMask)))
+   {
+      t.flags |= LINE_TRANSFORM_PARITY;
+   }
+   if (sender->BaudRate != receiver->BaudRate)
+   {
+      t.flags |= LINE_TRANSFORM_BAUD;
+   }
+   //the flags are checked on every write without lock. switch them off, while the transform is updated
+   transform->flags = 0;
+   transform->txMask = t.txMask;
+   transform->rxMask = t.rxMask;
+   transform->fill = t.fill;
+   transform->txParity = t.txParity;
+   transform->rxParity = t.rxParity;
+   transform->flags = t.flags;
+}
+
+
+//update the line format transforms of both directions of a pair, after the line format of hPort was changed
+static void m_LineUpdate(PortInformation * hPort)
+{
+   PortInformation * const pair = hPort->pairPort;
+   if (pair)
+   {
+      ENTER_CRITICAL();
+      m_LineCompute(hPort, &pair->dcb);
+      m_LineCompute(pair, &hPort->dcb);
+      LEAVE_CRITICAL();
+   }
+}
+
+
+//fill the (at most) two spans of count bytes of a fifo, from offset on (up to the end of the buffer, and after wrap around)
+static void m_SpanSplit(PortFifo * fifo, DWORD offset, DWORD count, MxvcpSpan * span)
+{
+   DWORD num = fifo->QxSize - offset;
+   if (num > count)
+   {
+      num = count;
+   }
+   span[0].data = &fifo->QxAddr[offset];
+   span[0].length = num;
+   span[1].data = fifo->QxAddr;
+   span[1].length = count - num;
+}
+
+
+//transform the count bytes, that were put last into the rx fifo of a port, to its line format.
+//the caller must hold the critical section. return the line errors (CE_xxx) of the data
+static DWORD m_LineTransformFifo(PortInformation * hPort, DWORD count)
+{
+   PortFifo * const fifo = hPort->rxFifo;
+   DWORD errors = 0;
+   DWORD start;
+   DWORD num;
+
+   if ((hPort->rxTransform.flags == 0) || (count == 0))
+   {
+      return 0;
+   }
+   //transform in (at most) two blocks: up to the end of the buffer, and after wrap around
+   start = (fifo->QxPut + fifo->QxSize - count) % fifo->QxSize;
+   num = fifo->QxSize - start;
+   if (num > count)
+   {
+      num = count;
+   }
+   errors = m_LineTransform(&hPort->rxTransform, &fifo->QxAddr[start], num);
+   if (count > num)
+   {
+      errors |= m_LineTransform(&hPort->rxTransform, fifo->QxAddr, count - num);
+   }
+   return errors;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Write data, received from the pair port, into the rx fifo of a port.
+
+   If the line formats of both ends differ, the data in the fifo is transformed to the
+   line format of the port. The written data is returned as spans of the fifo, i.e. as
+   the port receives it (to be scanned for events, cf. m_ReceiveScan). Must be callable
+   at interrupt time.
+
+   \param   hPort    receiving port
+   \param   data     data written by the pair port
+   \param   count    number of bytes
+   \param   span     receives the (at most) two spans of the written data in the fifo
+   \param   errors   receives the line errors (CE_xxx) of the data
+
+   \return  number of written bytes
+----------------------------------------------------------------------------*/
+static DWORD m_LineReceive(PortInformation * hPort, BYTE * data, DWORD count, MxvcpSpan * span, DWORD * errors)
+{
+   PortFifo * const fifo = hPort->rxFifo;
+   DWORD offset;
+   DWORD written;
+
+   //the reader must not see the data, before it is transformed. another writer must not
+   //put data behind it, before the spans are taken
+   ENTER_CRITICAL();
+   offset = fifo->QxPut;
+   written = m_FifoWrite(hPort, data, count);
+   *errors = m_LineTransformFifo(hPort, written);
+   m_SpanSplit(fifo, offset, written, span);
+   LEAVE_CRITICAL();
+   return written;
+}
+
+
+
+//direction of a record (monitor, capture) of the data, written by hPort to its pair port.
+//"A" is the port of the pair with the lower port index
+static __inline BYTE m_RecordDirection(PortInformation * hPort)
+{
+   return (BYTE)((hPort < hPort->pairPort) ? MXVCP_DIR_A_TO_B : MXVCP_DIR_B_TO_A);
+}
+
+
+//put a copy of the data, written by hPort into the rx fifo of its pair, into the fifo of the monitor port.
+//the data is split into records. a record, that doesn't fit completely into the monitors fifo is dropped,
+//as the monitor shall never slow down the pair.
+static void m_MonitorMirror(PortInformation * hPort, BYTE * data, DWORD count)
+{
+   PortInformation * const monitor = hPort->monitorPort;
+   MxvcpRecordHeader header;
+   DWORD signal = 0;
+
+   if ((monitor == NULL) || (!monitor->isOpen))
+   {
+      return;
+   }
+   header.time = System_GetTime();
+   header.port = (BYTE)(hPort - m_PortInformation);
+   header.direction = m_RecordDirection(hPort);
+   while (count)
+   {
+      DWORD chunk = (count > MONITOR_CHUNK_SIZE) ? MONITOR_CHUNK_SIZE : count;
+      PortFifo * fifo = monitor->rxFifo;
+      if ((fifo->QxSize - fifo->QxCount) < (sizeof(header) + chunk))
+      {
+         //no space left. drop record
+         monitor->monitorDropped++;
+         monitor->portData.dwCommError |= CE_RXOVER;
+      }
+      else
+      {
+         header.length = (WORD)chunk;
+         m_FifoWrite(monitor, (BYTE *)&header, sizeof(header));
+         m_FifoWrite(monitor, data, chunk);
+         signal = 1;
+      }
+      data += chunk;
+      count -= chunk;
+   }
+   if (signal)
+   {
+      m_PortSignalReceive(monitor, 0);
+   }
+}
+
+
+
+//write the buffer, that is not filled at the moment, into the capture file.
+//called as global event (outside of interrupt time). see m_CaptureFlushEvent.
+static void _cdecl m_CaptureFlush(DWORD refData)
+{
+   DWORD other;
+
+   m_Capture.flushPending = 0;
+   if (m_Capture.file == 0) //capture stopped in the meantime
+   {
+      return;
+   }
+   other = m_Capture.active ^ 1;
+   if (m_Capture.fill[other])
+   {
+      m_Capture.filePos += IFSMgr_WriteFile(m_Capture.file, m_Capture.buffer[other], m_Capture.fill[other],
+                                            m_Capture.filePos);
+      m_Capture.fill[other] = 0; //buffer can be used again
+   }
+}
+
+
+//register based event callback (reference data in EDX)
+REGISTER_CALLBACK(m_CaptureFlushEvent, m_CaptureFlush)
+
+
+//append a record (prefix and data) of a port to the capture buffer. must be callable at interrupt time.
+static void m_CaptureAppend(PortInformation * hPort, BYTE direction, void * prefix, DWORD prefixSize,
+                            void * data, DWORD count)
+{
+   MxvcpRecordHeader header;
+   DWORD const size = sizeof(header) + prefixSize + count;
+   DWORD active;
+   BYTE * dest;
+
+   if (m_Capture.file == 0)
+   {
+      return; //capture not active
+   }
+   header.time = System_GetTime();
+   header.port = (BYTE)(hPort - m_PortInformation);
+   header.direction = direction;
+   header.length = (WORD)(prefixSize + count);
+
+   //another appender (at interrupt time) must not interleave with the record, and the capture
+   //must not stop (cf. m_CaptureStop), while the record is copied
+   ENTER_CRITICAL();
+   active = m_Capture.active;
+   if (m_Capture.file == 0)
+   {
+      LEAVE_CRITICAL();
+      return;
+   }
+   if ((m_Capture.fill[active] + size) > CAPTURE_BUFFER_SIZE)
+   {
+      //buffer full. switch to the other buffer, if it was already written to file
+      if ((m_Capture.fill[active ^ 1] != 0) || (size > CAPTURE_BUFFER_SIZE))
+      {
+         m_Capture.dropped++;
+         LEAVE_CRITICAL();
+         return;
+      }
+      active ^= 1;
+      m_Capture.active = active;
+      if (!m_Capture.flushPending)
+      {
+         m_Capture.flushPending = 1;
+         Event_ScheduleGlobal(&m_CaptureFlushEvent, 0);
+      }
+   }
+   dest = &m_Capture.buffer[active][m_Capture.fill[active]];
+   stdutils_memcpy(dest, &header, sizeof(header));
+   stdutils_memcpy(dest + sizeof(header), prefix, prefixSize);
+   stdutils_memcpy(dest + sizeof(header) + prefixSize, data, count);
+   m_Capture.fill[active] += size;
+   LEAVE_CRITICAL();
+}
+
+
+//append the traffic of a port to the capture buffer (records of up to MXVCP_RECORD_CHUNK bytes).
+//must be callable at interrupt time.
+static void m_CaptureRecord(PortInformation * hPort, BYTE * data, DWORD count)
+{
+   BYTE const direction = m_RecordDirection(hPort);
+   while (count)
+   {
+      DWORD const chunk = (count > MXVCP_RECORD_CHUNK) ? MXVCP_RECORD_CHUNK : count;
+      m_CaptureAppend(hPort, direction, NULL, 0, data, chunk);
+      data += chunk;
+      count -= chunk;
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Append the record of a port function call to the capture buffer
+   (cf. MXVCP_CAPTURE_CALLS). Must be callable at interrupt time.
+
+   The data is split into records of up to MXVCP_RECORD_CHUNK bytes (the first one
+   after the call record, the others with direction MXVCP_DIR_CALL_DATA).
+
+   \param   hPort    called port
+   \param   function MXVCP_CALL_xxx
+   \param   arg0     first argument (cf. MxvcpCallRecord)
+   \param   arg1     second argument
+   \param   out      value returned by reference
+   \param   result   return value of the function
+   \param   data     data passed to resp. returned by the function (NULL if none)
+   \param   count    number of data bytes
+----------------------------------------------------------------------------*/
+static void m_CaptureCall(PortInformation * hPort, DWORD function, DWORD arg0, DWORD arg1, DWORD out,
+                          DWORD result, void * data, DWORD count)
+{
+   MxvcpCallRecord call;
+   DWORD chunk;
+
+   if (!m_Capture.calls)
+   {
+      return;
+   }
+   call.function = function;
+   call.arg[0] = arg0;
+   call.arg[1] = arg1;
+   call.out = out;
+   call.result = result;
+   call.error = hPort->portData.dwLastError;
+   chunk = (count > MXVCP_RECORD_CHUNK) ? MXVCP_RECORD_CHUNK : count;
+   m_CaptureAppend(hPort, MXVCP_DIR_CALL, &call, sizeof(call), data, chunk);
+   for (count -= chunk; count; count -= chunk)
+   {
+      data = (BYTE *)data + chunk;
+      chunk = (count > MXVCP_RECORD_CHUNK) ? MXVCP_RECORD_CHUNK : count;
+      m_CaptureAppend(hPort, MXVCP_DIR_CALL_DATA, NULL, 0, data, chunk);
+   }
+}
+
+
+//port functions, while the calls are recorded (cf. m_RecordFunctionTable). each one calls the port function
+//and records the call afterwards
+static BOOL _cdecl m_RecordSetCommState(PortInformation * hPort, _DCB * dcbPort, DWORD ActionMask)
+{
+   BOOL const result = m_PortSetCommState(hPort, dcbPort, ActionMask);
+   m_CaptureCall(hPort, MXVCP_CALL_SET_COMM_STATE, ActionMask, 0, 0, result, dcbPort, dcbPort ? sizeof(_DCB) : 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetCommState(PortInformation * hPort, _DCB * dcbPort)
+{
+   BOOL const result = m_PortGetCommState(hPort, dcbPort);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_COMM_STATE, 0, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordSetup(PortInformation * hPort, void * RxQueue, DWORD cbRxQueue, void * TxQueue, DWORD cbTxQueue)
+{
+   BOOL const result = m_PortSetup(hPort, RxQueue, cbRxQueue, TxQueue, cbTxQueue);
+   m_CaptureCall(hPort, MXVCP_CALL_SETUP, cbRxQueue, cbTxQueue, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordTransmitChar(PortInformation * hPort, DWORD ch)
+{
+   BOOL const result = m_PortTransmitChar(hPort, ch);
+   m_CaptureCall(hPort, MXVCP_CALL_TRANSMIT_CHAR, ch, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordClose(PortInformation * hPort)
+{
+   BOOL const result = m_PortClose(hPort);
+   m_CaptureCall(hPort, MXVCP_CALL_CLOSE, 0, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetQueueStatus(PortInformation * hPort, _COMSTAT * cmst)
+{
+   BOOL const result = m_PortGetQueueStatus(hPort, cmst);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_QUEUE_STATUS, 0, 0, cmst ? cmst->cbInque : 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordClearError(PortInformation * hPort, _COMSTAT * cmst, DWORD * lpErrors)
+{
+   BOOL const result = m_PortClearError(hPort, cmst, lpErrors);
+   m_CaptureCall(hPort, MXVCP_CALL_CLEAR_ERROR, 0, 0, lpErrors ? *lpErrors : 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordSetModemStatusShadow(PortInformation * hPort, DWORD dwEventMask, BYTE * MSRShadow)
+{
+   BOOL const result = m_PortSetModemStatusShadow(hPort, dwEventMask, MSRShadow);
+   m_CaptureCall(hPort, MXVCP_CALL_SET_MODEM_STATUS_SHADOW, dwEventMask, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetProperties(PortInformation * hPort, _COMMPROP * cmmp)
+{
+   BOOL const result = m_PortGetProperties(hPort, cmmp);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_PROPERTIES, 0, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordEscapeFunction(PortInformation * hPort, DWORD lFunc, DWORD InData, DWORD * OutData)
+{
+   BOOL const result = m_PortEscapeFunction(hPort, lFunc, InData, OutData);
+   m_CaptureCall(hPort, MXVCP_CALL_ESCAPE_FUNCTION, lFunc, InData, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordPurge(PortInformation * hPort, DWORD dwQueueType)
+{
+   BOOL const result = m_PortPurge(hPort, dwQueueType);
+   m_CaptureCall(hPort, MXVCP_CALL_PURGE, dwQueueType, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordSetEventMask(PortInformation * hPort, DWORD dwMask, DWORD * dwEvents)
+{
+   BOOL const result = m_PortSetEventMask(hPort, dwMask, dwEvents);
+   m_CaptureCall(hPort, MXVCP_CALL_SET_EVENT_MASK, dwMask, 0, dwEvents ? *dwEvents : 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetEventMask(PortInformation * hPort, DWORD dwMask, DWORD * dwEvents)
+{
+   BOOL const result = m_PortGetEventMask(hPort, dwMask, dwEvents);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_EVENT_MASK, dwMask, 0, dwEvents ? *dwEvents : 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordWrite(PortInformation * hPort, void * achBuffer, DWORD cchRequested, DWORD * cchWritten)
+{
+   BOOL const result = m_PortWrite(hPort, achBuffer, cchRequested, cchWritten);
+   //only the written data: the rest may be any amount (and is written again by the application)
+   m_CaptureCall(hPort, MXVCP_CALL_WRITE, cchRequested, 0, *cchWritten, result, achBuffer, *cchWritten);
+   return result;
+}
+
+static BOOL _cdecl m_RecordRead(PortInformation * hPort, void * achBuffer, DWORD cchRequested, DWORD * cchReceived)
+{
+   BOOL const result = m_PortRead(hPort, achBuffer, cchRequested, cchReceived);
+   m_CaptureCall(hPort, MXVCP_CALL_READ, cchRequested, 0, *cchReceived, result, achBuffer, *cchReceived);
+   return result;
+}
+
+static BOOL _cdecl m_RecordEnableNotification(PortInformation * hPort, PCommNotifyProc commNotifyProc, DWORD lReferenceData)
+{
+   BOOL const result = m_PortEnableNotification(hPort, commNotifyProc, lReferenceData);
+   m_CaptureCall(hPort, MXVCP_CALL_ENABLE_NOTIFICATION, commNotifyProc != NULL, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordSetReadCallback(PortInformation * hPort, long rxTrigger, PCommNotifyProc commNotifyProc,
+                                           DWORD lReferenceData)
+{
+   BOOL const result = m_PortSetReadCallback(hPort, rxTrigger, commNotifyProc, lReferenceData);
+   m_CaptureCall(hPort, MXVCP_CALL_SET_READ_CALLBACK, rxTrigger, commNotifyProc != NULL, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordSetWriteCallback(PortInformation * hPort, long txTrigger, PCommNotifyProc commNotifyProc,
+                                            DWORD lReferenceData)
+{
+   BOOL const result = m_PortSetWriteCallback(hPort, txTrigger, commNotifyProc, lReferenceData);
+   m_CaptureCall(hPort, MXVCP_CALL_SET_WRITE_CALLBACK, txTrigger, commNotifyProc != NULL, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetModemStatus(PortInformation * hPort, DWORD * dwModemStatus)
+{
+   BOOL const result = m_PortGetModemStatus(hPort, dwModemStatus);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_MODEM_STATUS, 0, 0, dwModemStatus ? *dwModemStatus : 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetCommConfig(PortInformation * hPort, _DCB * dcbPort, DWORD * dwSize)
+{
+   BOOL const result = m_PortGetCommConfig(hPort, dcbPort, dwSize);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_COMM_CONFIG, 0, 0, 0, result, NULL, 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordSetCommConfig(PortInformation * hPort, _DCB * dcbPort, DWORD * dwSize)
+{
+   BOOL const result = m_PortSetCommConfig(hPort, dcbPort, dwSize);
+   m_CaptureCall(hPort, MXVCP_CALL_SET_COMM_CONFIG, 0, 0, 0, result, dcbPort, dcbPort ? sizeof(_DCB) : 0);
+   return result;
+}
+
+static BOOL _cdecl m_RecordGetWin32Error(PortInformation * hPort, DWORD * dwError)
+{
+   BOOL const result = m_PortGetWin32Error(hPort, dwError);
+   m_CaptureCall(hPort, MXVCP_CALL_GET_WIN32_ERROR, 0, 0, dwError ? *dwError : 0, result, NULL, 0);
+   return result;
+}
+
+//function table of all ports, while the port function calls are recorded (same order as m_PortFunctionTable)
+static PortFunctionTable m_RecordFunctionTable =
+{
+   &m_RecordSetCommState,
+   &m_RecordGetCommState,
+   &m_RecordSetup,
+   &m_RecordTransmitChar,
+   &m_RecordClose,
+   &m_RecordGetQueueStatus,
+   &m_RecordClearError,
+   &m_RecordSetModemStatusShadow,
+   &m_RecordGetProperties,
+   &m_RecordEscapeFunction,
+   &m_RecordPurge,
+   &m_RecordSetEventMask,
+   &m_RecordGetEventMask,
+   &m_RecordWrite,
+   &m_RecordRead,
+   &m_RecordEnableNotification,
+   &m_RecordSetReadCallback,
+   &m_RecordSetWriteCallback,
+   &m_RecordGetModemStatus,
+   &m_RecordGetCommConfig,
+   &m_RecordSetCommConfig,
+   &m_RecordGetWin32Error,
+   NULL
+};
+
+
+//switch the function table of all ports (VCOMM calls a port through the table of its port data)
+static void m_CaptureSelectTable(PortFunctionTable * table)
+{
+   unsigned int p;
+
+   for (p = 0; p < m_NextFreePort; ++p)
+   {
+      m_PortInformation[p].portData.PDfunctions = (PortFunctions *)table;
+   }
+}
+
+
+//start capture of all traffic into the "CaptureFile" (flags: MXVCP_CAPTURE_xxx). must not be called at interrupt time.
+static BOOL m_CaptureStart(DWORD flags)
+{
+   MxvcpCaptureHeader header;
+   DWORD file;
+
+   if ((m_Capture.file != 0) || (m_CaptureFileName[0] == 0))
+   {
+      return 0; //already running, or no file given
+   }
+   m_Capture.buffer[0] = Heap_Allocate(CAPTURE_BUFFER_SIZE, 0);
+   m_Capture.buffer[1] = Heap_Allocate(CAPTURE_BUFFER_SIZE, 0);
+   file = IFSMgr_OpenFile(m_CaptureFileName, R0_ACCESS_WRITEONLY | R0_SHARE_DENYNONE,
+                          R0_ACTION_CREATENEW | R0_ACTION_REPLACEEXISTING);
+   if ((m_Capture.buffer[0] == NULL) || (m_Capture.buffer[1] == NULL) || (file == 0))
+   {
+      if (file) IFSMgr_CloseFile(file);
+      if (m_Capture.buffer[0]) Heap_Free(m_Capture.buffer[0], 0);
+      if (m_Capture.buffer[1]) Heap_Free(m_Capture.buffer[1], 0);
+      m_Capture.buffer[0] = NULL;
+      m_Capture.buffer[1] = NULL;
+      return 0;
+   }
+   header.magic = MXVCP_CAPTURE_MAGIC;
+   header.version = MXVCP_CAPTURE_VERSION;
+   m_Capture.filePos = IFSMgr_WriteFile(file, &header, sizeof(header), 0);
+   m_Capture.fill[0] = 0;
+   m_Capture.fill[1] = 0;
+   m_Capture.active = 0;
+   m_Capture.flushPending = 0;
+   m_Capture.dropped = 0;
+   m_Capture.file = file; //capture starts now
+   if (flags & MXVCP_CAPTURE_CALLS)
+   {
+      m_Capture.calls = 1;
+      m_CaptureSelectTable(&m_RecordFunctionTable);
+   }
+   return 1;
+}
+
+
+//stop capture. remaining records are written to file. must not be called at interrupt time.
+static void m_CaptureStop(void)
+{
+   DWORD const file = m_Capture.file;
+   BYTE * older;
+   BYTE * newer;
+   DWORD olderFill;
+   DWORD newerFill;
+
+   if (file == 0)
+   {
+      return;
+   }
+   if (m_Capture.calls)
+   {
+      m_Capture.calls = 0;
+      m_CaptureSelectTable(&m_PortFunctionTable);
+   }
+   //stop capture (a pending flush event is ignored). no appender uses the buffers afterwards
+   ENTER_CRITICAL();
+   m_Capture.file = 0;
+   older = m_Capture.buffer[m_Capture.active ^ 1];
+   newer = m_Capture.buffer[m_Capture.active];
+   olderFill = m_Capture.fill[m_Capture.active ^ 1];
+   newerFill = m_Capture.fill[m_Capture.active];
+   m_Capture.buffer[0] = NULL;
+   m_Capture.buffer[1] = NULL;
+   LEAVE_CRITICAL();
+   //write the older buffer first
+   m_Capture.filePos += IFSMgr_WriteFile(file, older, olderFill, m_Capture.filePos);
+   m_Capture.filePos += IFSMgr_WriteFile(file, newer, newerFill, m_Capture.filePos);
+   IFSMgr_CloseFile(file);
+   Heap_Free(older, 0);
+   Heap_Free(newer, 0);
+}
+
+
+
+static void _cdecl m_ReplayTimeout(DWORD refData);
+
+//register based time-out callback (reference data in EDX)
+REGISTER_CALLBACK(m_ReplayTimeoutCallback, m_ReplayTimeout)
+
+
+//feed the records of the replay file into the rx fifo of the port, as far as they are due and fit into the fifo.
+//must be callable at interrupt time.
+static void m_ReplayPump(void)
+{
+   PortInformation * const port = m_Replay.port;
+   DWORD const direction = (m_Replay.flags & MXVCP_REPLAY_B_TO_A) ? MXVCP_DIR_B_TO_A : MXVCP_DIR_A_TO_B;
+   DWORD signal = 0;
+
+   if ((port == NULL) || (m_Replay.timeout != 0))
+   {
+      return; //not active, or waiting for time-out
+   }
+   while ((m_Replay.pos + sizeof(MxvcpRecordHeader)) <= m_Replay.size)
+   {
+      MxvcpRecordHeader * const header = (MxvcpRecordHeader *)&m_Replay.data[m_Replay.pos];
+      DWORD const end = m_Replay.pos + sizeof(MxvcpRecordHeader) + header->length;
+      DWORD written;
+
+      if (end > m_Replay.size)
+      {
+         break; //truncated record
+      }
+      if (header->direction != direction)
+      {
+         m_Replay.pos = end; //skip record of other direction
+         continue;
+      }
+      if (!(m_Replay.flags & MXVCP_REPLAY_FAST))
+      {
+         //original timing: wait until record is due
+         DWORD now = System_GetTime();
+         DWORD due;
+         if (!m_Replay.started)
+         {
+            m_Replay.started = 1;
+            m_Replay.firstRecordTime = header->time;
+            m_Replay.startTime = now;
+         }
+         due = m_Replay.startTime + (header->time - m_Replay.firstRecordTime);
+         if ((LONG)(due - now) > 0)
+         {
+            m_Replay.timeout = Timer_SetGlobalTimeOut(due - now, 0, &m_ReplayTimeoutCallback);
+            break;
+         }
+      }
+      //replay (remaining) data of record
+      written = m_FifoWrite(port, &m_Replay.data[m_Replay.pos + sizeof(MxvcpRecordHeader) + m_Replay.offset],
+                            header->length - m_Replay.offset);
+      if (written)
+      {
+         signal = 1;
+      }
+      m_Replay.offset += written;
+      if (m_Replay.offset < header->length)
+      {
+         //fifo is full. continue on next read (fast), or a bit later (original timing)
+         if (!(m_Replay.flags & MXVCP_REPLAY_FAST))
+         {
+            m_Replay.timeout = Timer_SetGlobalTimeOut(REPLAY_RETRY_TIME, 0, &m_ReplayTimeoutCallback);
+         }
+         break;
+      }
+      m_Replay.pos = end;
+      m_Replay.offset = 0;
+   }
+   if (signal)
+   {
+      m_PortSignalReceive(port, 0);
+   }
+}
+
+
+static void _cdecl m_ReplayTimeout(DWORD refData)
+{
+   m_Replay.timeout = 0;
+   m_ReplayPump();
+}
+
+
+//stop replay. must not be called at interrupt time.
+static void m_ReplayStop(void)
+{
+   m_Replay.port = NULL; //stop replay
+   if (m_Replay.timeout)
+   {
+      Timer_CancelTimeOut(m_Replay.timeout);
+      m_Replay.timeout = 0;
+   }
+   if (m_Replay.data)
+   {
+      Heap_Free(m_Replay.data, 0);
+      m_Replay.data = NULL;
+   }
+}
+
+
+//start replay of the "ReplayFile" into the given port. must not be called at interrupt time.
+static BOOL m_ReplayStart(PortInformation * hPort, DWORD flags)
+{
+   MxvcpCaptureHeader * header;
+   DWORD file;
+   DWORD size;
+
+   m_ReplayStop();
+   if (m_ReplayFileName[0] == 0)
+   {
+      return 0;
+   }
+   //load the file completely
+   file = IFSMgr_OpenFile(m_ReplayFileName, R0_ACCESS_READONLY | R0_SHARE_DENYNONE, R0_ACTION_OPENEXISTING);
+   if (file == 0)
+   {
+      return 0;
+   }
+   size = IFSMgr_GetFileSize(file);
+   if ((size >= sizeof(MxvcpCaptureHeader)) && (size <= REPLAY_FILE_SIZE_MAX))
+   {
+      m_Replay.data = Heap_Allocate(size, 0);
+      if (m_Replay.data && (IFSMgr_ReadFile(file, m_Replay.data, size, 0) != size))
+      {
+         Heap_Free(m_Replay.data, 0);
+         m_Replay.data = NULL;
+      }
+   }
+   IFSMgr_CloseFile(file);
+   if (m_Replay.data == NULL)
+   {
+      return 0;
+   }
+   header = (MxvcpCaptureHeader *)m_Replay.data;
+   if ((header->magic != MXVCP_CAPTURE_MAGIC) || (header->version == 0) || (header->version > MXVCP_CAPTURE_VERSION))
+   {
+      m_ReplayStop();
+      return 0;
+   }
+   m_Replay.size = size;
+   m_Replay.pos = sizeof(MxvcpCaptureHeader);
+   m_Replay.offset = 0;
+   m_Replay.flags = flags;
+   m_Replay.started = 0;
+   m_Replay.firstRecordTime = 0;
+   m_Replay.startTime = 0;
+   m_Replay.port = hPort; //replay starts now
+   m_ReplayPump();
+   return 1;
+}
+
+
+
+//produce the next 8 bit of the PRBS-15 sequence (MSB first)
+static BYTE m_PrbsNextByte(DWORD * lfsr)
+{
+   DWORD value = *lfsr;
+   BYTE byte = 0;
+   unsigned int bit;
+
+   for (bit = 0; bit < 8; ++bit)
+   {
+      DWORD const next = ((value >> 14) ^ (value >> 13)) & 1;
+      value = ((value << 1) | next) & 0x7FFF;
+      byte = (BYTE)((byte << 1) | next);
+   }
+   *lfsr = value;
+   return byte;
+}
+
+
+//check received byte against the PRBS-15 sequence. the check is self synchronizing,
+//as each bit is predicted from the 15 bits received before.
+//return TRUE if byte matches.
+static BOOL m_PrbsCheckByte(SyntheticPort * sink, BYTE byte)
+{
+   DWORD value = sink->prbs;
+   BOOL match = 1;
+   unsigned int bit;
+
+   for (bit = 0; bit < 8; ++bit)
+   {
+      DWORD const received = (byte >> (7 - bit)) & 1;
+      if ((sink->prbsBits >= 15) && (received != (((value >> 14) ^ (value >> 13)) & 1)))
+      {
+         match = 0;
+      }
+      else if (sink->prbsBits < 15)
+      {
+         sink->prbsBits++;
+      }
+      value = ((value << 1) | received) & 0x7FFF;
+   }
+   sink->prbs = value;
+   return match;
+}
+
+
+//produce (at most) count bytes of the sources pattern into its rx fifo.
+//return number of produced bytes.
+static DWORD m_SourceFill(PortInformation * hPort, DWORD count)
+{
+   SyntheticPort * const source = &hPort->synthetic;
+   PortFifo * const fifo = hPort->rxFifo;
+   DWORD const space = fifo->QxSize - fifo->QxCount;
+   BYTE block[SOURCE_BLOCK_SIZE];
+   DWORD produced = 0;
+
+   if (count > space)
+   {
+      count = space;
+   }
+   if ((source->pattern == PATTERN_FILE) && (source->fileData == NULL))
+   {
+      count = 0; //there is no file to repeat
+   }
+   while (count)
+   {
+      DWORD const num = (count > SOURCE_BLOCK_SIZE) ? SOURCE_BLOCK_SIZE : count;
+      DWORD i;
+      for (i = 0; i < num; ++i)
+      {
+         switch (source->pattern)
+         {
+         case PATTERN_PRBS:
+            block[i] = m_PrbsNextByte(&source->prbs);
+            break;
+
+         case PATTERN_FILE:
+            block[i] = source->fileData[source->filePos++];
+            if (source->filePos >= source->fileSize)
+            {
+               source->filePos = 0;
+            }
+            break;
+
+         default: //counter
+            block[i] = (BYTE)source->counter++;
+            break;
+         }
+      }
+      m_FifoWrite(hPort, block, num);
+      produced += num;
+      count -= num;
+   }
+   if (produced)
+   {
+      source->bytes += produced;
+      m_PortSignalReceive(hPort, 0);
+   }
+   return produced;
+}
+
+
+static void _cdecl m_SourceTimeout(DWORD refData);
+
+//register based time-out callback (reference data in EDX)
+REGISTER_CALLBACK(m_SourceTimeoutCallback, m_SourceTimeout)
+
+
+//periodic tick of a rate limited source
+static void _cdecl m_SourceTimeout(DWORD refData)
+{
+   PortInformation * const hPort = &m_PortInformation[refData];
+   SyntheticPort * const source = &hPort->synthetic;
+   DWORD const now = System_GetTime();
+
+   source->timeout = 0;
+   if (!hPort->isOpen)
+   {
+      return;
+   }
+   source->credit += source->rate * (now - source->lastTick);
+   source->lastTick = now;
+   source->credit -= 1000 * m_SourceFill(hPort, source->credit / 1000);
+   if (source->credit > (1000 * source->rate))
+   {
+      source->credit = 1000 * source->rate; //the reader is too slow. don't burst more than one second
+   }
+   source->timeout = Timer_SetGlobalTimeOut(SOURCE_TICK_TIME, refData, &m_SourceTimeoutCallback);
+}
+
+
+//consume data written into a sink port
+static void m_SinkConsume(PortInformation * hPort, BYTE * data, DWORD count)
+{
+   SyntheticPort * const sink = &hPort->synthetic;
+   DWORD i;
+
+   sink->bytes += count;
+   sink->checksum = crc_crc32(sink->checksum, data, count);
+   switch (sink->pattern)
+   {
+   case PATTERN_COUNTER:
+      for (i = 0; i < count; ++i)
+      {
+         if (data[i] != (BYTE)sink->counter)
+         {
+            sink->sequenceErrors++;
+         }
+         sink->counter = data[i] + 1; //resynchronize on the received byte
+      }
+      break;
+
+   case PATTERN_PRBS:
+      for (i = 0; i < count; ++i)
+      {
+         if (!m_PrbsCheckByte(sink, data[i]))
+         {
+            sink->sequenceErrors++;
+         }
+      }
+      break;
+
+   default:
+      break; //no sequence check
+   }
+}
+
+
+//start a synthetic port, when it is opened. must not be called at interrupt time.
+static void m_SyntheticOpen(PortInformation * hPort)
+{
+   SyntheticPort * const synthetic = &hPort->synthetic;
+
+   synthetic->counter = 0;
+   synthetic->prbs = (hPort->portType == PORT_TYPE_SOURCE) ? PRBS_SEED : 0;
+   synthetic->prbsBits = 0;
+   synthetic->checksum = CRC32_INIT;
+   synthetic->sequenceErrors = 0;
+   synthetic->bytes = 0;
+   synthetic->startTime = System_GetTime();
+   if (hPort->portType != PORT_TYPE_SOURCE)
+   {
+      return;
+   }
+   //load file to repeat
+   if ((synthetic->pattern == PATTERN_FILE) && (synthetic->fileData == NULL))
+   {
+      DWORD const file = IFSMgr_OpenFile(synthetic->fileName, R0_ACCESS_READONLY | R0_SHARE_DENYNONE,
+                                         R0_ACTION_OPENEXISTING);
+      if (file)
+      {
+         DWORD const size = IFSMgr_GetFileSize(file);
+         if ((size > 0) && (size <= REPLAY_FILE_SIZE_MAX))
+         {
+            synthetic->fileData = Heap_Allocate(size, 0);
+            if (synthetic->fileData && (IFSMgr_ReadFile(file, synthetic->fileData, size, 0) != size))
+            {
+               Heap_Free(synthetic->fileData, 0);
+               synthetic->fileData = NULL;
+            }
+            synthetic->fileSize = size;
+         }
+         IFSMgr_CloseFile(file);
+      }
+   }
+   synthetic->filePos = 0;
+   //produce data
+   if (synthetic->rate)
+   {
+      synthetic->credit = 0;
+      synthetic->lastTick = synthetic->startTime;
+      synthetic->timeout = Timer_SetGlobalTimeOut(SOURCE_TICK_TIME, (DWORD)(hPort - m_PortInformation),
+                                                  &m_SourceTimeoutCallback);
+   }
+   else
+   {
+      m_SourceFill(hPort, FIFO_SIZE_1BY);
+   }
+}
+
+
+//stop a synthetic port, when it is closed. must not be called at interrupt time.
+static void m_SyntheticClose(PortInformation * hPort)
+{
+   SyntheticPort * const synthetic = &hPort->synthetic;
+
+   if (synthetic->timeout)
+   {
+      Timer_CancelTimeOut(synthetic->timeout);
+      synthetic->timeout = 0;
+   }
+   if (synthetic->fileData)
+   {
+      Heap_Free(synthetic->fileData, 0);
+      synthetic->fileData = NULL;
+   }
+}
+
+
+//complete the current frame of a framing stage. return 1 if there was a frame, otherwise 0
+static DWORD m_FrameEnd(FrameState * frame, DWORD framing)
+{
+   BOOL valid;
+
+   if ((frame->length == 0) && !frame->error)
+   {
+      return 0; //empty frame (e.g. back-to-back delimiters)
+   }
+   switch (framing)
+   {
+   case FRAMING_HDLC:
+      valid = (frame->length > 2) && (frame->crc == FCS16_GOOD);
+      break;
+   case FRAMING_MODBUS:
+      valid = (frame->length > 3) && (frame->crc == 0); //address, function code, CRC
+      break;
+   default:
+      valid = 1;
+      break;
+   }
+   frame->frames++;
+   if (!valid || frame->error)
+   {
+      frame->corruptFrames++;
+   }
+   frame->length = 0;
+   frame->crc = (framing == FRAMING_HDLC) ? FCS16_INIT : CRC16_INIT;
+   frame->escape = 0;
+   frame->error = 0;
+   return 1;
+}
+
+
+static void _cdecl m_FrameTimeout(DWORD refData);
+
+//time-out callback (register based). the reference data is passed in edx
+REGISTER_CALLBACK(m_FrameTimeoutCallback, m_FrameTimeout)
+
+
+//Modbus: the inter-character gap has elapsed. the current frame is complete
+static void _cdecl m_FrameTimeout(DWORD refData)
+{
+   PortInformation * const hPort = &m_PortInformation[refData];
+   hPort->frame.timeout = 0;
+   if (hPort->isOpen && m_FrameEnd(&hPort->frame, hPort->framing))
+   {
+      m_PortSignalReceive(hPort, 0);
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Track the frame boundaries within data, that was put into the rx fifo of a port.
+
+   Must be callable at interrupt time.
+
+   \param   hPort    port, that has received the data
+   \param   data     received data
+   \param   count    number of bytes
+
+   \return  number of completed frames. 1 if the port has no framing stage,
+            as each chunk of data is signaled then.
+----------------------------------------------------------------------------*/
+static DWORD m_FrameScan(PortInformation * hPort, BYTE * data, DWORD count)
+{
+   FrameState * const frame = &hPort->frame;
+   DWORD frames = 0;
+   DWORD i;
+
+   switch (hPort->framing)
+   {
+   case FRAMING_SLIP:
+      for (i = 0; i < count; ++i)
+      {
+         BYTE const byte = data[i];
+         if (byte == SLIP_END)
+         {
+            frames += m_FrameEnd(frame, hPort->framing);
+         }
+         else if (frame->escape)
+         {
+            frame->escape = 0;
+            frame->error |= (byte != SLIP_ESC_END) && (byte != SLIP_ESC_ESC);
+            frame->length++;
+         }
+         else if (byte == SLIP_ESC)
+         {
+            frame->escape = 1;
+         }
+         else
+         {
+            frame->length++;
+         }
+      }
+      break;
+
+   case FRAMING_HDLC:
+      for (i = 0; i < count; ++i)
+      {
+         BYTE byte = data[i];
+         if (byte == HDLC_FLAG)
+         {
+            frame->error |= frame->escape; //escape followed by flag: frame is aborted
+            frames += m_FrameEnd(frame, hPort->framing);
+            continue;
+         }
+         if (byte == HDLC_ESC)
+         {
+            frame->escape = 1;
+            continue;
+         }
+         if (frame->escape)
+         {
+            frame->escape = 0;
+            byte ^= HDLC_XOR;
+         }
+         frame->crc = crc_fcs16(frame->crc, &byte, 1);
+         frame->length++;
+      }
+      break;
+
+   case FRAMING_MODBUS:
+      {
+         DWORD const now = System_GetTime();
+         if (frame->timeout)
+         {
+            Timer_CancelTimeOut(frame->timeout);
+            frame->timeout = 0;
+         }
+         //gap since the previous data: that frame is complete
+         if ((now - frame->lastTime) >= frame->gap)
+         {
+            frames += m_FrameEnd(frame, hPort->framing);
+         }
+         frame->crc = crc_crc16(frame->crc, data, count);
+         frame->length += count;
+         frame->lastTime = now;
+         //the frame is complete, if no further data is received within the gap time
+         frame->timeout = Timer_SetGlobalTimeOut(frame->gap, (DWORD)(hPort - m_PortInformation),
+                                                 &m_FrameTimeoutCallback);
+      }
+      break;
+
+   default:
+      frames = 1;
+      break;
+   }
+   return frames;
+}
+
+
+//reset the framing stage (discard the current frame). statistics are cleared too, if the port is opened.
+static void m_FrameReset(PortInformation * hPort, BOOL clearStatistics)
+{
+   FrameState * const frame = &hPort->frame;
+   if (frame->timeout)
+   {
+      Timer_CancelTimeOut(frame->timeout);
+      frame->timeout = 0;
+   }
+   frame->length = 0;
+   frame->crc = (hPort->framing == FRAMING_HDLC) ? FCS16_INIT : CRC16_INIT;
+   frame->escape = 0;
+   frame->error = 0;
+   frame->lastTime = System_GetTime();
+   if (clearStatistics)
+   {
+      frame->frames = 0;
+      frame->corruptFrames = 0;
+   }
+}
+
+//scan the spans of data, that was put into the rx fifo of a port (cf. m_SpanSplit), for the event character and
+//the frame boundaries. return EV_RXFLAG if found (and enabled), otherwise 0. the completed frames are added to frames
+static DWORD m_ReceiveScan(PortInformation * hPort, MxvcpSpan * span, DWORD * frames)
+{
+   DWORD events = 0;
+   unsigned int i;
+
+   for (i = 0; i < 2; ++i)
+   {
+      if (span[i].length)
+      {
+         events |= m_EventCharScan(hPort, span[i].data, span[i].length);
+         *frames += m_FrameScan(hPort, span[i].data, span[i].length);
+      }
+   }
+   return events;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Issue the rx events of data, that was put into the rx fifo of a port.
+
+   This is, what follows the copy into the fifo (m_PortWrite, m_SpanPublish, the
+   shared ring): the line errors are signaled, the data in the fifo (i.e. in the
+   line format of the port) is scanned for the event character and the frame
+   boundaries, and it is mirrored to the monitor port and the capture file.
+   Callable at interrupt time, but not within a critical section.
+
+   \param   hPort    receiving port
+   \param   writer   writing port, whose data is mirrored. NULL, if the caller mirrors the data
+   \param   span     the (at most) two spans of the data in the fifo (cf. m_SpanSplit)
+   \param   errors   line errors (CE_xxx) of the data
+----------------------------------------------------------------------------*/
+static void m_ReceiveDone(PortInformation * hPort, PortInformation * writer, MxvcpSpan * span, DWORD errors)
+{
+   DWORD frames = 0;
+   DWORD events;
+   unsigned int i;
+
+   if (errors)
+   {
+      m_PortSignalError(hPort, errors);
+   }
+   events = m_ReceiveScan(hPort, span, &frames);
+   for (i = 0; writer && (i < 2); ++i)
+   {
+      if (span[i].length)
+      {
+         m_MonitorMirror(writer, span[i].data, span[i].length);
+         m_CaptureRecord(writer, span[i].data, span[i].length);
+      }
+   }
+   if (frames || events)
+   {
+      m_PortSignalReceive(hPort, events);
+   }
+}
+
+
+
+//pseudo random number generator (xorshift32) of an impairment stage
+static DWORD m_ImpairRandom(ImpairLine * line)
+{
+   DWORD x = line->random;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   line->random = x;
+   return x;
+}
+
+
+//return TRUE with the given probability [ppm]
+static BOOL m_ImpairChance(ImpairLine * line, DWORD probability)
+{
+   return (probability != 0) && ((m_ImpairRandom(line) % PPM) < probability);
+}
+
+
+static void _cdecl m_ImpairTimeout(DWORD refData);
+
+//register based time-out callback (reference data in EDX)
+REGISTER_CALLBACK(m_ImpairTimeoutCallback, m_ImpairTimeout)
+
+
+//move all due chunks from the delay line into the rx fifo of the port. must be callable at interrupt time,
+//but not within a critical section (rx events and callbacks are issued).
+static void m_ImpairRelease(PortInformation * hPort)
+{
+   ImpairLine * const line = hPort->impairLine;
+   DWORD const now = System_GetTime();
+   DWORD received = 0;
+   DWORD frameErrors = 0;
+   DWORD lineErrors = 0;
+   DWORD frames = 0;
+   DWORD events = 0;
+
+   if (line == NULL)
+   {
+      return; //not active
+   }
+   //other writers into the rx fifo must not interleave with a chunk
+   ENTER_CRITICAL();
+   while ((line->timeout == 0) && line->chunkCount) //(not waiting for time-out)
+   {
+      ImpairChunk * const chunk = &line->chunk[line->chunkGet];
+      MxvcpSpan span[2];
+      DWORD written;
+      DWORD errors;
+      DWORD num;
+
+      if ((LONG)(chunk->due - now) > 0)
+      {
+         //not yet due
+         line->timeout = Timer_SetGlobalTimeOut(chunk->due - now, (DWORD)(hPort - m_PortInformation),
+                                                &m_ImpairTimeoutCallback);
+         break;
+      }
+      if (chunk->message && ((m_FifoSize(hPort) - m_FifoCount(hPort)) < chunk->length))
+      {
+         if (chunk->length <= m_FifoSizeLimit(hPort))
+         {
+            m_FifoGrow(hPort, chunk->length);
+            break; //the message doesn't fit completely. continue on next read, resp. when the fifo has grown
+         }
+         //the message never fits (the fifo was shared meanwhile): drop it
+         line->get = (line->get + chunk->length) % IMPAIR_BUFFER_SIZE;
+         line->count -= chunk->length;
+         line->chunkGet = (line->chunkGet + 1) % IMPAIR_CHUNKS;
+         line->chunkCount--;
+         hPort->stats.overruns++;
+         lineErrors |= CE_RXOVER;
+         continue;
+      }
+      //release chunk (at most up to the end of the ring)
+      num = IMPAIR_BUFFER_SIZE - line->get;
+      if (num > chunk->length)
+      {
+         num = chunk->length;
+      }
+      written = m_LineReceive(hPort, &line->buffer[line->get], num, span, &errors);
+      lineErrors |= errors;
+      events |= m_ReceiveScan(hPort, span, &frames); //(as received, i.e. transformed to the line format of the port)
+      line->get = (line->get + written) % IMPAIR_BUFFER_SIZE;
+      line->count -= written;
+      chunk->length -= (WORD)written;
+      received += written;
+      if (written < num)
+      {
+         break; //fifo is full. continue on next read
+      }
+      if (chunk->length == 0)
+      {
+         frameErrors += chunk->frameErrors;
+         line->chunkGet = (line->chunkGet + 1) % IMPAIR_CHUNKS;
+         line->chunkCount--;
+      }
+   }
+   LEAVE_CRITICAL();
+   if (frames || events)
+   {
+      m_PortSignalReceive(hPort, events);
+   }
+   if (frameErrors)
+   {
+      lineErrors |= CE_FRAME;
+   }
+   if (lineErrors)
+   {
+      m_PortSignalError(hPort, lineErrors);
+   }
+}
+
+
+static void _cdecl m_ImpairTimeout(DWORD refData)
+{
+   PortInformation * const hPort = &m_PortInformation[refData];
+   if (hPort->impairLine)
+   {
+      hPort->impairLine->timeout = 0;
+      m_ImpairRelease(hPort);
+   }
+}
+
+
+//put data, written by the pair port, into the delay line of the impairment stage of hPort. a message is
+//accepted completely or not at all, and is released as a whole. the data is not released here: the caller
+//calls m_ImpairRelease, after it has left its critical section.
+//return number of accepted bytes (including the dropped ones). must be callable at interrupt time.
+static DWORD m_ImpairWrite(PortInformation * hPort, BYTE * data, DWORD count, BOOL message)
+{
+   ImpairConfig * const config = &hPort->impairConfig;
+   ImpairLine * const line = hPort->impairLine;
+   DWORD const now = System_GetTime();
+   ImpairChunk * chunk;
+   DWORD due;
+   DWORD i;
+
+   ENTER_CRITICAL();
+   if ((line->chunkCount >= IMPAIR_CHUNKS) || (message && (count > (IMPAIR_BUFFER_SIZE - line->count))))
+   {
+      LEAVE_CRITICAL();
+      return 0; //delay line is full
+   }
+   if (count > (IMPAIR_BUFFER_SIZE - line->count))
+   {
+      count = IMPAIR_BUFFER_SIZE - line->count;
+   }
+   chunk = &line->chunk[line->chunkPut];
+   chunk->length = 0;
+   chunk->frameErrors = 0;
+   chunk->message = message;
+   for (i = 0; i < count; ++i)
+   {
+      BYTE byte = data[i];
+      //bursty outage
+      if ((LONG)(line->outageEnd - now) > 0)
+      {
+         continue;
+      }
+      if (m_ImpairChance(line, config->outageRate))
+      {
+         line->outageEnd = now + config->outageTime;
+         continue;
+      }
+      //drop single byte
+      if (m_ImpairChance(line, config->dropRate))
+      {
+         continue;
+      }
+      //bit error
+      if (m_ImpairChance(line, config->bitErrorRate))
+      {
+         byte ^= (BYTE)(1 << (m_ImpairRandom(line) & 7));
+      }
+      //framing error
+      if (m_ImpairChance(line, config->frameErrorRate))
+      {
+         chunk->frameErrors++;
+      }
+      line->buffer[line->put] = byte;
+      line->put = (line->put + 1) % IMPAIR_BUFFER_SIZE;
+      line->count++;
+      chunk->length++;
+   }
+   if (chunk->length)
+   {
+      //chunks must not overtake each other (in spite of jitter)
+      due = now + config->delay;
+      if (config->jitter)
+      {
+         due += m_ImpairRandom(line) % (config->jitter + 1);
+      }
+      if ((LONG)(line->lastDue - due) > 0)
+      {
+         due = line->lastDue;
+      }
+      chunk->due = due;
+      line->lastDue = due;
+      line->chunkPut = (line->chunkPut + 1) % IMPAIR_CHUNKS;
+      line->chunkCount++;
+   }
+   LEAVE_CRITICAL();
+   return count;
+}
+
+
+//discard all data within the delay line
+static void m_ImpairFlush(ImpairLine * line)
+{
+   line->put = 0;
+   line->get = 0;
+   line->count = 0;
+   line->chunkPut = 0;
+   line->chunkGet = 0;
+   line->chunkCount = 0;
+}
+
+
+//activate impairment stage (if configured), when the port is opened. must not be called at interrupt time.
+static void m_ImpairOpen(PortInformation * hPort)
+{
+   ImpairConfig * const config = &hPort->impairConfig;
+   ImpairLine * line;
+
+   if ((config->delay | config->jitter | config->dropRate | config->bitErrorRate |
+        config->frameErrorRate | config->outageRate) == 0)
+   {
+      return; //no impairment
+   }
+   line = slab_alloc_grow(sizeof(ImpairLine));
+   if (line)
+   {
+      m_ImpairFlush(line);
+      line->random = config->seed ? config->seed : 1; //state of xorshift must not be 0
+      line->outageEnd = System_GetTime();
+      line->lastDue = line->outageEnd;
+      line->timeout = 0;
+   }
+   hPort->impairLine = line;
+}
+
+
+//deactivate impairment stage, when the port is closed. must not be called at interrupt time.
+static void m_ImpairClose(PortInformation * hPort)
+{
+   ImpairLine * const line = hPort->impairLine;
+   if (line)
+   {
+      hPort->impairLine = NULL;
+      if (line->timeout)
+      {
+         Timer_CancelTimeOut(line->timeout);
+      }
+      slab_free(line);
+   }
+}
+
+
+
+//find the channel port of a multiplexer port, by its channel number (DLCI)
+static PortInformation * m_MuxFindChannel(PortInformation * hMux, DWORD dlci)
+{
+   unsigned int p;
+   for (p = 0; p < m_NextFreePort; ++p)
+   {
+      PortInformation * const port = &m_PortInformation[p];
+      if ((port->muxPort == hMux) && (port->muxChannel == dlci))
+      {
+         return port;
+      }
+   }
+   return NULL;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Send a frame through a multiplexer port (i.e. into its rx fifo).
+
+   The frame is put into the fifo completely or not at all. Callable at interrupt time.
+
+   \param   hMux     multiplexer port
+   \param   dlci     channel number
+   \param   control  frame type (MUX_SABM, MUX_DISC, MUX_UIH), optionally with MUX_PF
+   \param   data     information field
+   \param   count    size of the information field (max. MUX_FRAME_SIZE + 1)
+
+   \retval  TRUE     if the frame was sent
+   \retval  FALSE    if the multiplexer port is not open or its fifo is full
+----------------------------------------------------------------------------*/
+static BOOL m_MuxTransmit(PortInformation * hMux, DWORD dlci, BYTE control, BYTE * data, DWORD count)
+{
+   BYTE frame[MUX_FRAME_SIZE + 7];
+   DWORD len = 0;
+   DWORD written;
+
+   if (!hMux->isOpen)
+   {
+      return 0;
+   }
+   //flag, address (with C/R and EA bit), control, length (with EA bit), information, FCS, flag
+   frame[len++] = MUX_FLAG;
+   frame[len++] = (BYTE)((dlci << 2) | 0x03);
+   frame[len++] = control;
+   frame[len++] = (BYTE)((count << 1) | 0x01);
+   frame[len++] = (BYTE)(0xFF - crc_crc8(CRC8_INIT, &frame[1], 3));
+   stdutils_memmove(&frame[4 + count], &frame[4], 1); //FCS goes behind the information field
+   stdutils_memcpy(&frame[4], data, count);
+   len += count;
+   frame[len++] = MUX_FLAG;
+
+   //frames of different channels must not interleave
+   ENTER_CRITICAL();
+   if (m_PortRxSpace(hMux, len) < len)
+   {
+      LEAVE_CRITICAL();
+      return 0;
+   }
+   if (hMux->impairLine)
+   {
+      m_ImpairWrite(hMux, frame, len, 1);
+      LEAVE_CRITICAL();
+      m_ImpairRelease(hMux); //(callbacks must not be called within the critical section)
+   }
+   else
+   {
+      written = m_FifoWrite(hMux, frame, len);
+      LEAVE_CRITICAL();
+      if (m_FrameScan(hMux, frame, written))
+      {
+         m_PortSignalReceive(hMux, m_EventCharScan(hMux, frame, written));
+      }
+   }
+   return 1;
+}
+
+
+//grant credits to the peer of a channel, for the frames that fit into the rx fifo of the channel
+static void m_MuxGrant(PortInformation * hPort)
+{
+   PortInformation * const hMux = hPort->muxPort;
+   DWORD frames;
+   BYTE credits;
+
+   if ((hMux == NULL) || !hPort->isOpen || !hMux->mux.credits)
+   {
+      return;
+   }
+   frames = (m_FifoSize(hPort) - m_FifoCount(hPort)) / MUX_FRAME_SIZE;
+   if (frames <= hPort->muxRxCredits)
+   {
+      return; //the peer has enough credits
+   }
+   frames -= hPort->muxRxCredits;
+   if ((frames < MUX_CREDIT_BATCH) && hPort->muxRxCredits)
+   {
+      return; //grant later, together with further credits
+   }
+   credits = (BYTE)((frames > 255) ? 255 : frames);
+   if (m_MuxTransmit(hMux, hPort->muxChannel, MUX_UIH | MUX_PF, &credits, 1))
+   {
+      hPort->muxRxCredits += credits;
+   }
+}
+
+
+//a channel port is opened resp. its multiplexer port is opened, while the channel is open
+static void m_MuxStart(PortInformation * hPort)
+{
+   hPort->muxRxCredits = 0;
+   if (hPort->muxPort && m_MuxTransmit(hPort->muxPort, hPort->muxChannel, MUX_SABM | MUX_PF, NULL, 0))
+   {
+      m_MuxGrant(hPort);
+   }
+}
+
+
+//process a received frame
+static void m_MuxDispatch(PortInformation * hMux)
+{
+   MuxState * const mux = &hMux->mux;
+   DWORD const dlci = mux->address >> 2;
+   PortInformation * hPort;
+   BYTE * data = mux->info;
+   DWORD count = mux->length;
+
+   if (dlci == 0)
+   {
+      return; //control channel: the multiplexer control commands are not supported. its frames are ignored
+   }
+   hPort = m_MuxFindChannel(hMux, dlci);
+   if (hPort == NULL)
+   {
+      mux->errors++; //unknown channel
+      return;
+   }
+   switch (mux->control & ~MUX_PF)
+   {
+   case MUX_SABM:
+      //peer (re-)started the channel. its credits are reset
+      hPort->muxTxCredits = 0;
+      if (hPort->isOpen)
+      {
+         hPort->muxRxCredits = 0;
+         m_MuxGrant(hPort);
+      }
+      break;
+
+   case MUX_DISC:
+   case MUX_DM:
+      //peer stopped the channel (resp. it is not started at the peer)
+      hPort->muxTxCredits = 0;
+      break;
+
+   case MUX_UA:
+      break; //peer acknowledged SABM resp. DISC of the channel. nothing to do
+
+   case MUX_UIH:
+      //first byte of the information field of an UIH frame with P/F bit: credits, granted by the peer
+      if ((mux->control & MUX_PF) && count)
+      {
+         hPort->muxTxCredits += *data++;
+         count--;
+         m_ReadyNotify(hPort, MXVCP_READY_TX);
+         //the channel can send (again)
+         if (hPort->isOpen)
+         {
+            *hPort->eventRegister |= EV_TXEMPTY;
+            if ((hPort->eventMask & EV_TXEMPTY) && hPort->eventCallback)
+            {
+               hPort->stats.callbacks++;
+               hPort->eventCallback(hPort, hPort->portData.dwClientRefData, CN_EVENT, EV_TXEMPTY);
+            }
+            if (hPort->txCallback)
+            {
+               hPort->stats.callbacks++;
+               hPort->txCallback(hPort, hPort->txCallbackParameter, CN_TRANSMIT, 0);
+            }
+         }
+      }
+      //a credit allows one frame of up to MUX_FRAME_SIZE data bytes (the credits are granted for that size)
+      if (mux->credits && (count > MUX_FRAME_SIZE))
+      {
+         mux->errors++; //the data is discarded
+         break;
+      }
+      if (count && hPort->isOpen)
+      {
+         DWORD const written = m_FifoWrite(hPort, data, count);
+         if (hPort->muxRxCredits)
+         {
+            hPort->muxRxCredits--;
+         }
+         if (written)
+         {
+            DWORD const events = m_EventCharScan(hPort, data, written);
+            if (m_FrameScan(hPort, data, written) || events)
+            {
+               m_PortSignalReceive(hPort, events);
+            }
+         }
+      }
+      break;
+
+   default:
+      mux->errors++; //unsupported frame type
+      break;
+   }
+}
+
+
+//parse data, written by the application of a multiplexer port, for frames. callable at interrupt time.
+static void m_MuxReceive(PortInformation * hMux, BYTE * data, DWORD count)
+{
+   MuxState * const mux = &hMux->mux;
+
+   while (count--)
+   {
+      BYTE const byte = *data++;
+      switch (mux->state)
+      {
+      case MUX_STATE_HUNT:
+         if (byte == MUX_FLAG)
+         {
+            mux->state = MUX_STATE_ADDRESS;
+         }
+         break;
+
+      case MUX_STATE_ADDRESS:
+         if (byte == MUX_FLAG)
+         {
+            break; //consecutive flags
+         }
+         mux->address = byte;
+         mux->crc = crc_crc8(CRC8_INIT, &byte, 1);
+         mux->state = (byte & 0x01) ? MUX_STATE_CONTROL : MUX_STATE_HUNT; //EA bit must be set
+         break;
+
+      case MUX_STATE_CONTROL:
+         mux->control = byte;
+         mux->crc = crc_crc8(mux->crc, &byte, 1);
+         mux->state = MUX_STATE_LENGTH;
+         break;
+
+      case MUX_STATE_LENGTH:
+         mux->length = (BYTE)(byte >> 1);
+         mux->count = 0;
+         mux->crc = crc_crc8(mux->crc, &byte, 1);
+         if (!(byte & 0x01))
+         {
+            mux->errors++; //two byte length field is not supported
+            mux->state = MUX_STATE_HUNT;
+         }
+         else
+         {
+            mux->state = mux->length ? MUX_STATE_INFO : MUX_STATE_FCS;
+         }
+         break;
+
+      case MUX_STATE_INFO:
+         mux->info[mux->count++] = byte;
+         if (mux->count >= mux->length)
+         {
+            mux->state = MUX_STATE_FCS;
+         }
+         break;
+
+      case MUX_STATE_FCS:
+         mux->crc = crc_crc8(mux->crc, &byte, 1);
+         if (mux->crc == CRC8_GOOD)
+         {
+            mux->state = MUX_STATE_END;
+         }
+         else
+         {
+            mux->errors++;
+            mux->state = MUX_STATE_HUNT;
+         }
+         break;
+
+      default: //MUX_STATE_END
+         if (byte == MUX_FLAG)
+         {
+            mux->state = MUX_STATE_ADDRESS; //the closing flag may be the opening flag of the next frame
+            m_MuxDispatch(hMux);
+         }
+         else
+         {
+            mux->errors++;
+            mux->state = MUX_STATE_HUNT;
+         }
+         break;
+      }
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Send data of a channel port through its multiplexer port.
+
+   The data is split into frames of up to MUX_FRAME_SIZE bytes. Each frame takes a
+   credit, granted by the peer. Callable at interrupt time.
+
+   \param   hPort    channel port
+   \param   data     data to send
+   \param   count    number of bytes
+
+   \return  number of sent bytes. less than count, if the peer has not granted enough
+            credits or the multiplexer port is not open or its fifo is full
+----------------------------------------------------------------------------*/
+static DWORD m_MuxSend(PortInformation * hPort, BYTE * data, DWORD count)
+{
+   PortInformation * const hMux = hPort->muxPort;
+   DWORD sent = 0;
+
+   if (hMux == NULL)
+   {
+      return count; //drop all data, like a port without pair port
+   }
+   while (count && (hPort->muxTxCredits || !hMux->mux.credits))
+   {
+      DWORD const num = (count > MUX_FRAME_SIZE) ? MUX_FRAME_SIZE : count;
+      if (!m_MuxTransmit(hMux, hPort->muxChannel, MUX_UIH, data, num))
+      {
+         break;
+      }
+      if (hPort->muxTxCredits)
+      {
+         hPort->muxTxCredits--;
+      }
+      data += num;
+      count -= num;
+      sent += num;
+   }
+   return sent;
+}
+
+
+//a multiplexer port is opened. start all of its open channels
+static void m_MuxOpen(PortInformation * hMux)
+{
+   unsigned int p;
+
+   hMux->mux.state = MUX_STATE_HUNT;
+   for (p = 0; p < m_NextFreePort; ++p)
+   {
+      PortInformation * const port = &m_PortInformation[p];
+      if (port->muxPort == hMux)
+      {
+         port->muxTxCredits = 0;
+         if (port->isOpen)
+         {
+            m_MuxStart(port);
+         }
+      }
+   }
+}
+
+
+//a channel port is closed
+static void m_MuxClose(PortInformation * hPort)
+{
+   if (hPort->muxPort)
+   {
+      m_MuxTransmit(hPort->muxPort, hPort->muxChannel, MUX_DISC | MUX_PF, NULL, 0);
+   }
+   hPort->muxRxCredits = 0;
+}
+
+
+
+//return the readiness (MXVCP_READY_xxx) of a port
+static DWORD m_ReadyEvents(PortInformation * hPort)
+{
+   PortInformation * const pair = hPort->pairPort;
+   DWORD events = 0;
+
+   if (!hPort->isOpen)
+   {
+      return 0;
+   }
+   if (m_FifoCount(hPort))
+   {
+      events |= MXVCP_READY_RX;
+   }
+   if (hPort->portType == PORT_TYPE_MONITOR)
+   {
+      return events; //read only
+   }
+   if (hPort->portType == PORT_TYPE_CHANNEL)
+   {
+      //a write needs a credit (and room for a frame in the rx fifo of the multiplexer port)
+      PortInformation * const hMux = hPort->muxPort;
+      if ((hMux == NULL) || (hMux->isOpen && (hPort->muxTxCredits || !hMux->mux.credits) &&
+                             (m_FifoSize(hMux) - m_FifoCount(hMux) >= MUX_FRAME_SIZE + 6)))
+      {
+         events |= MXVCP_READY_TX;
+      }
+   }
+   else if ((pair == NULL) || !pair->isOpen)
+   {
+      events |= MXVCP_READY_TX; //written data is dropped (resp. consumed)
+   }
+   else if (pair->impairLine)
+   {
+      if ((pair->impairLine->chunkCount < IMPAIR_CHUNKS) && (pair->impairLine->count < IMPAIR_BUFFER_SIZE))
+      {
+         events |= MXVCP_READY_TX;
+      }
+   }
+   else if (m_FifoCount(pair) < m_FifoSize(pair))
+   {
+      events |= MXVCP_READY_TX;
+   }
+   else
+   {
+      //the fifo of the pair is full. it may grow (the port gets ready then, cf. m_FifoAdapt)
+      m_FifoGrow(pair, 1);
+   }
+   return events;
+}
+
+
+//a pending wait of a readiness set completes. called as global event (outside of interrupt time).
+static void _cdecl m_ReadyWake(DWORD refData)
+{
+   ReadySet * const set = &m_ReadySets[refData];
+   DWORD const event = set->waitEvent;
+
+   set->waitEvent = 0;
+   set->wakePending = 0;
+   if (event)
+   {
+      VWIN32_DIOCCompletion(event);
+   }
+}
+
+//register based event callback (reference data in EDX)
+REGISTER_CALLBACK(m_ReadyWakeEvent, m_ReadyWake)
+
+
+/*----------------------------------------------------------------------------
+   \brief Mark a port as (possibly) ready in all readiness sets, that are interested.
+
+   Called at the points, where rx data arrives resp. tx space is freed. A pending wait
+   of a set is completed. Must be callable at interrupt time.
+
+   \param   hPort    port
+   \param   events   MXVCP_READY_RX and/or MXVCP_READY_TX
+----------------------------------------------------------------------------*/
+static void m_ReadyNotify(PortInformation * hPort, DWORD events)
+{
+   DWORD const index = hPort - m_PortInformation;
+   unsigned int s;
+
+   if ((hPort->readyInterest & events) == 0)
+   {
+      return; //no set is interested (that's the common case)
+   }
+   for (s = 0; s < READY_SETS; ++s)
+   {
+      ReadySet * const set = &m_ReadySets[s];
+      if (set->hDevice && (set->interest[index] & events))
+      {
+         set->ready[index / 32] |= ((DWORD)1 << (index % 32));
+         if (set->waitEvent && !set->wakePending)
+         {
+            set->wakePending = 1;
+            Event_ScheduleGlobal(&m_ReadyWakeEvent, s);
+         }
+      }
+   }
+}
+
+
+//find the readiness set of a client (by handle of the driver and process). optionally allocate a free one.
+static ReadySet * m_ReadyFind(DIOCPARAMETERS * params, BOOL allocate)
+{
+   ReadySet * unused = NULL;
+   unsigned int s;
+
+   for (s = 0; s < READY_SETS; ++s)
+   {
+      ReadySet * const set = &m_ReadySets[s];
+      if ((set->hDevice == params->hDevice) && (set->tagProcess == params->tagProcess))
+      {
+         return set;
+      }
+      if ((set->hDevice == 0) && (unused == NULL))
+      {
+         unused = set;
+      }
+   }
+   if (allocate && unused)
+   {
+      stdutils_memclr(unused, sizeof(ReadySet));
+      unused->hDevice = params->hDevice;
+      unused->tagProcess = params->tagProcess;
+      return unused;
+   }
+   return NULL;
+}
+
+
+//recompute the interest of the ports (union over all readiness sets)
+static void m_ReadyInterest(void)
+{
+   unsigned int p;
+   unsigned int s;
+
+   for (p = 0; p < NUMBER_OF_PORTS; ++p)
+   {
+      DWORD interest = 0;
+      for (s = 0; s < READY_SETS; ++s)
+      {
+         if (m_ReadySets[s].hDevice)
+         {
+            interest |= m_ReadySets[s].interest[p];
+         }
+      }
+      m_PortInformation[p].readyInterest = interest;
+   }
+}
+
+
+//release the readiness set of a client, that closes its handle of the driver. a pending wait completes.
+static void m_ReadyClose(DIOCPARAMETERS * params)
+{
+   ReadySet * const set = m_ReadyFind(params, 0);
+   if (set)
+   {
+      DWORD event;
+      ENTER_CRITICAL();
+      event = set->waitEvent; //a scheduled wake finds nothing to complete
+      set->waitEvent = 0;
+      set->hDevice = 0;
+      LEAVE_CRITICAL();
+      if (event)
+      {
+         VWIN32_DIOCCompletion(event);
+      }
+      m_ReadyInterest();
+   }
+}
+
+
+
+/*----------------------------------------------------------------------------
+   \brief Return the readable data of the rx fifo of a port, without copying it
+   (cf. MxvcpSpanApi). Callable at interrupt time.
+
+   The fifo buffer is kept in place (it doesn't grow or shrink), until the data is
+   consumed by m_SpanCommit.
+
+   \param   hPort    port
+   \param   span     receives the (at most) two spans of readable data
+
+   \return  number of readable bytes (sum of both spans)
+----------------------------------------------------------------------------*/
+static DWORD _cdecl m_SpanPeek(PortInformation * hPort, MxvcpSpan * span)
+{
+   PortFifo * const fifo = hPort->rxFifo;
+   DWORD count = 0;
+
+   ENTER_CRITICAL();
+   if (hPort->isOpen && fifo->QxCount)
+   {
+      count = fifo->QxCount;
+      hPort->spanLock |= SPAN_LOCK_READ;
+   }
+   m_SpanSplit(fifo, fifo->QxGet, count, span);
+   LEAVE_CRITICAL();
+   return count;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Consume data of the rx fifo of a port, after it was peeked (cf. MxvcpSpanApi).
+
+   This is, what m_PortRead does after copying: the tx events of the pair port are
+   issued, waiting producers (replay, impairment, multiplexer) are continued. Callable
+   at interrupt time.
+
+   \param   hPort    port
+   \param   count    number of consumed bytes (from the start of the first span on)
+----------------------------------------------------------------------------*/
+static void _cdecl m_SpanCommit(PortInformation * hPort, DWORD count)
+{
+   PortFifo * const fifo = hPort->rxFifo;
+   DWORD fifoCountBefore;
+
+   ENTER_CRITICAL();
+   hPort->spanLock &= ~SPAN_LOCK_READ;
+   if (!hPort->isOpen)
+   {
+      LEAVE_CRITICAL();
+      return;
+   }
+   fifoCountBefore = fifo->QxCount;
+   if (count > fifoCountBefore)
+   {
+      count = fifoCountBefore;
+   }
+   fifo->QxGet = (fifo->QxGet + count) % fifo->QxSize;
+   fifo->QxCount -= count;
+   LEAVE_CRITICAL();
+   m_PortReadDone(hPort, fifoCountBefore, count);
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Reserve free space in the rx fifo of the pair port, to be filled in place
+   (cf. MxvcpSpanApi). Callable at interrupt time.
+
+   Only a port of type "Normal", whose pair port is open and has no impairment stage,
+   writes into the fifo of its pair. Otherwise nothing is reserved (use m_PortWrite).
+   The fifo grows, if there is not enough space for count bytes (as far as allowed).
+   There is one reservation per fifo at a time. Until it is published, all other writes
+   into the fifo are refused (cf. m_FifoWrite).
+
+   \param   hPort    writing port
+   \param   count    number of bytes to reserve
+   \param   span     receives the (at most) two spans of reserved space
+
+   \return  number of reserved bytes (sum of both spans, may be less than count)
+----------------------------------------------------------------------------*/
+static DWORD _cdecl m_SpanReserve(PortInformation * hPort, DWORD count, MxvcpSpan * span)
+{
+   PortInformation * const pair = hPort->pairPort;
+   PortFifo * fifo;
+   DWORD space;
+
+   span[0].length = 0;
+   span[1].length = 0;
+   if (!hPort->isOpen || (hPort->portType != PORT_TYPE_NORMAL) || (pair == NULL) || !pair->isOpen ||
+       pair->impairLine)
+   {
+      return 0;
+   }
+   space = m_PortRxSpace(pair, count);
+   if (count > space)
+   {
+      count = space;
+   }
+   ENTER_CRITICAL();
+   fifo = pair->rxFifo;
+   //another writer may have filled the fifo meanwhile
+   if (count > (fifo->QxSize - fifo->QxCount))
+   {
+      count = fifo->QxSize - fifo->QxCount;
+   }
+   if (pair->spanLock & SPAN_LOCK_WRITE)
+   {
+      count = 0; //reserved already
+   }
+   if (count)
+   {
+      pair->spanLock |= SPAN_LOCK_WRITE;
+      pair->spanPut = fifo->QxPut;
+      pair->spanLength = count;
+   }
+   m_SpanSplit(fifo, fifo->QxPut, count, span);
+   LEAVE_CRITICAL();
+   return count;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Put data, that was filled into the reserved space, into the rx fifo of the
+   pair port (cf. MxvcpSpanApi).
+
+   This is, what m_PortWrite does after copying: the data is transformed to the line
+   format of the pair port, the rx events of the pair port are issued and the data is
+   mirrored to the monitor port and the capture file. Callable at interrupt time.
+
+   The data is put at the reserved offset, at most the reserved number of bytes. If the
+   fifo was purged meanwhile, the reservation is void.
+
+   \param   hPort    writing port
+   \param   count    number of filled bytes (from the start of the first reserved span on)
+----------------------------------------------------------------------------*/
+static void _cdecl m_SpanPublish(PortInformation * hPort, DWORD count)
+{
+   PortInformation * const pair = hPort->pairPort;
+   PortFifo * fifo;
+   MxvcpSpan span[2];
+   DWORD reserved;
+   DWORD errors;
+
+   if (pair == NULL)
+   {
+      return;
+   }
+   ENTER_CRITICAL();
+   reserved = (pair->spanLock & SPAN_LOCK_WRITE) ? pair->spanLength : 0;
+   pair->spanLock &= ~SPAN_LOCK_WRITE;
+   fifo = pair->rxFifo;
+   if (!hPort->isOpen || !pair->isOpen || pair->impairLine)
+   {
+      LEAVE_CRITICAL();
+      return;
+   }
+   if (count > reserved)
+   {
+      count = reserved;
+   }
+   m_SpanSplit(fifo, pair->spanPut, count, span);
+   fifo->QxPut = (pair->spanPut + count) % fifo->QxSize;
+   fifo->QxCount += count;
+   //the reader must not see the data, before it is transformed
+   errors = m_LineTransformFifo(pair, count);
+   LEAVE_CRITICAL();
+   if (count == 0)
+   {
+      return;
+   }
+   m_ReceiveDone(pair, hPort, span, errors);
+   hPort->stats.bytesOut += count;
+}
+
+
+
+
+
+
+
+
+
+/*----------------------------------------------------------------------------
+   \brief Initialize port driver.
+
+   This function gets called from the VxDs control function "MXVCP_Control"
+   on reception of a system message.
+   It registers itself as a port driver with VCOMM. VCOMM will call back the given
+   function (m_DriverControl) to complete initialization by initialization
+   of the available ports.
+
+   This function is only called once when this VXD is loaded. This VXD is
+   loaded as far as any of its COM ports is opened. The opening of further
+   COM ports does not lead to execute this function again.
+   However if all COM ports of this VXD get closed, the VXD is unloaded
+   (cf. MXVCP_DeviceExit). If after that a COM port is opened again,
+   the VXD is loaded again and thus, this function is called again.
+
+   The VXD stays loaded, as long as at least one of its COM ports is open!
+
+   \return
+      if port(s) could be configured then NC (carry flag clear)
+      else CY (carry flag set)
+----------------------------------------------------------------------------*/
+BOOL _cdecl MXVCP_DeviceInit(HVM vmHandle)
+{
+#ifdef dbgMsgLen
+   dbgMsg[0] = 0; //ensure zero termination
+   dbgMsg[dbgMsgLen - 1] = 0; //ensure zero termination
+#endif
+#if 0
+   stdutils_strncpy(dbgMsg, "MXVCP_DeviceInit", dbgMsgLen);
+   SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
+#endif
+   m_NextFreePort = 0;
+   m_SysVmHandle = Get_Sys_VM_Handle(); //save handle
+   crc_init();
+   if (!slab_init())
+   {
+      slab_exit();
+      SET_CARRY(); //the driver can't be loaded
+      return 0;
+   }
+   wheel_init();
+   //publish statistics to System Monitor, if available
+   m_PerfServer = VMM_GetDDB(PERF_DEVICE_ID) ? PERF_ServerRegister(&m_PerfServerInfo) : 0;
+   VCOMM_RegisterPortDriver((PFN)&m_DriverControl); //register driver
+   CLEAR_CARRY();
+   return 1;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Unload port driver.
+
+   This function is only called once when the VXD is unloaded. This VXD is
+   unloaded as far as all of its COM ports get closed.
+   The closing of any COM ports does not lead to execute this function as
+   long as any other COM port of this VXD is open.
+
+   \return
+      if port(s) could be configured then NC (carry flag clear)
+      else CY (carry flag set)
+----------------------------------------------------------------------------*/
+BOOL _cdecl MXVCP_DeviceExit(HVM vmHandle)
+{
+   unsigned int p;
+#if 0
+   stdutils_strncpy(dbgMsg, "MXVCP_DeviceExit", dbgMsgLen);
+   SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
+#endif
+   m_CaptureStop();
+   m_ReplayStop();
+   wheel_exit();
+   //all ports are closed. release the fifos, which are still in their grace period
+   for (p = 0; p < m_NextFreePort; ++p)
+   {
+      PortInformation * const port = &m_PortInformation[p];
+      if (port->fifoReleaseTimeout)
+      {
+         Timer_CancelTimeOut(port->fifoReleaseTimeout);
+         port->fifoReleaseTimeout = 0;
+      }
+      m_FifoRelease(port);
+   }
+   if (m_PerfServer)
+   {
+      PERF_ServerDeregister(m_PerfServer);
+      m_PerfServer = 0;
+      for (p = 0; p < m_NextFreePort; ++p)
+      {
+         m_PortInformation[p].perfStat[0].name = NULL;
+      }
+   }
+   slab_exit();
+   m_SysVmHandle = 0;
+   CLEAR_CARRY();
+   return 1;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Read a string value from the hardware branch of the registry.
+
+   \param   DevNode     devnode of the port
+   \param   valueName   name of the value
+   \param   buffer      buffer that receives the zero terminated string
+   \param   size        size of buffer
+
+   \retval  TRUE     if value was found (and is not empty)
+   \retval  FALSE    otherwise
+----------------------------------------------------------------------------*/
+static BOOL m_ReadRegistryString(DWORD DevNode, char * valueName, char * buffer, DWORD size)
+{
+   DWORD status;
+   DWORD len = size - 1; //keep space for zero termination
+   status = CONFIGMG_ReadRegistryValue(DevNode, 0, valueName, REG_SZ, buffer, &len, 0); //read from hardware branch
+   if ((status == 0) && (len > 0))
+   {
+      buffer[len] = 0; //add zero termination
+      return 1;
+   }
+   buffer[0] = 0;
+   return 0;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Read a 32-bit value (REG_BINARY) from the hardware branch of the registry.
+
+   \param   DevNode        devnode of the port
+   \param   valueName      name of the value
+   \param   defaultValue   value returned, if the registry value doesn't exist
+
+   \return  the value
+----------------------------------------------------------------------------*/
+static DWORD m_ReadRegistryDword(DWORD DevNode, char * valueName, DWORD defaultValue)
+{
+   DWORD status;
+   DWORD value = 0;
+   DWORD len = sizeof(value);
+   status = CONFIGMG_ReadRegistryValue(DevNode, 0, valueName, REG_BINARY, &value, &len, 0); //read from hardware branch
+   if ((status == 0) && (len == sizeof(value)))
+   {
+      return value;
+   }
+   return defaultValue;
+}
+
+
+//find port by its name
+static PortInformation * m_FindPort(const char * portName)
+{
+   unsigned int p;
+   for (p = 0; p < m_NextFreePort; ++p)
+   {
+      if (stdutils_strncmp(m_PortInformation[p].portName, portName, PORTNAME_LENGTH) == 0)
+      {
+         return &m_PortInformation[p];
+      }
+   }
+   return NULL;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Link all monitor ports to the port pair they are monitoring.
+
+   The monitored pair is given by the "PairPortName" of the monitor (one of its ports).
+   Port "A" of the pair is the one with the lower port index (cf. m_RecordDirection),
+   regardless of the named port. As ports are initialized in any order, this is done
+   again, whenever a port is added.
+----------------------------------------------------------------------------*/
+static void m_LinkMonitors(void)
+{
+   unsigned int m;
+   unsigned int p;
+
+   for (m = 0; m < m_NextFreePort; ++m)
+   {
+      PortInformation * const monitor = &m_PortInformation[m];
+      if (monitor->portType != PORT_TYPE_MONITOR)
+      {
+         continue;
+      }
+      for (p = 0; p < m_NextFreePort; ++p)
+      {
+         PortInformation * const port = &m_PortInformation[p];
+         if ((port->portType == PORT_TYPE_NORMAL) &&
+             (stdutils_strncmp(port->portName, monitor->pairPortName, PORTNAME_LENGTH) == 0))
+         {
+            monitor->monitoredPort = port;
+            port->monitorPort = monitor;
+            if (port->pairPort)
+            {
+               port->pairPort->monitorPort = monitor;
+            }
+            break;
+         }
+      }
+   }
+}
+
+
+//publish the statistics of a port to System Monitor (once)
+static void m_PerfAddPort(PortInformation * port)
+{
+   unsigned int s;
+
+   if ((m_PerfServer == 0) || port->perfStat[0].name)
+   {
+      return;
+   }
+   for (s = 0; s < PERF_STATS; ++s)
+   {
+      PerfStat * const stat = &port->perfStat[s];
+      unsigned int len = stdutils_strncpy(port->perfName[s], port->portName, PERF_NAME_LENGTH);
+      len += stdutils_strncpy(&port->perfName[s][len], " ", PERF_NAME_LENGTH - len);
+      stdutils_strncpy(&port->perfName[s][len], m_PerfItems[s].name, PERF_NAME_LENGTH - len);
+      stat->level = 0;
+      stat->flags = m_PerfItems[s].flags;
+      stat->name = port->perfName[s];
+      stat->nodeName = port->perfName[s];
+      stat->unitName = m_PerfItems[s].unit;
+      stat->description = m_PerfItems[s].description;
+      stat->scaleType = 0;
+   }
+   port->perfStat[0].stat = &port->stats.bytesIn;
+   port->perfStat[1].stat = &port->stats.bytesOut;
+   port->perfStat[2].stat = &port->stats.rxFill; //the fifo header may move into the shared arena (cf. m_RingMap)
+   port->perfStat[3].stat = &port->stats.overruns;
+   port->perfStat[4].stat = &port->stats.callbacks;
+   for (s = 0; s < PERF_STATS; ++s)
+   {
+      PERF_ServerAddStat(m_PerfServer, &port->perfStat[s]);
+   }
+}
+
+
+//link all channel ports to their multiplexer port (given by the "PairPortName" of the channel)
+static void m_LinkChannels(void)
+{
+   unsigned int c;
+
+   for (c = 0; c < m_NextFreePort; ++c)
+   {
+      PortInformation * const channel = &m_PortInformation[c];
+      if ((channel->portType == PORT_TYPE_CHANNEL) && (channel->muxPort == NULL))
+      {
+         PortInformation * const hMux = m_FindPort(channel->pairPortName);
+         if (hMux && (hMux->portType == PORT_TYPE_MUX))
+         {
+            channel->muxPort = hMux;
+         }
+      }
+   }
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Handle a DeviceIoControl call of a Win32 application.
+
+   This function gets called from the VxDs control function "MXVCP_Control"
+   on reception of the W32_DEVICEIOCONTROL message. The application has to open
+   the driver using CreateFile("\\\\.\\MXVCP", ...).
+
+   \param   params   DeviceIoControl parameters
+
+   \return  0 if successful, otherwise a win32 error code
+----------------------------------------------------------------------------*/
+DWORD _cdecl MXVCP_DeviceIOControl(DIOCPARAMETERS * params)
+{
+   switch (params->dwIoControlCode)
+   {
+   case DIOC_OPEN:
+      return ERROR_SUCCESS; //nothing todo
+
+   case DIOC_CLOSEHANDLE:
+      m_ReadyClose(params);
+      return ERROR_SUCCESS;
+
+   case MXVCP_IOCTL_READY_SET:
+      {
+         MxvcpReadyEntry const * const entry = (MxvcpReadyEntry *)params->lpvInBuffer;
+         DWORD const num = params->cbInBuffer / sizeof(MxvcpReadyEntry);
+         DWORD interest[NUMBER_OF_PORTS];
+         ReadySet * set;
+         DWORD e;
+
+         if ((num && (entry == NULL)) || (params->cbInBuffer % sizeof(MxvcpReadyEntry)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         stdutils_memclr(interest, sizeof(interest));
+         for (e = 0; e < num; ++e)
+         {
+            char portName[PORTNAME_LENGTH];
+            PortInformation * port;
+
+            stdutils_strncpy(portName, entry[e].portName, sizeof(portName));
+            port = m_FindPort(portName);
+            if (port == NULL)
+            {
+               return ERROR_FILE_NOT_FOUND;
+            }
+            interest[port - m_PortInformation] |= entry[e].events & (MXVCP_READY_RX | MXVCP_READY_TX);
+         }
+         set = m_ReadyFind(params, 1);
+         if (set == NULL)
+         {
+            return ERROR_NOT_ENOUGH_MEMORY;
+         }
+         //the set replaces the previous one. all its ports are checked on the next MXVCP_IOCTL_READY_GET
+         ENTER_CRITICAL();
+         stdutils_memcpy(set->interest, interest, sizeof(interest));
+         stdutils_memclr(set->ready, sizeof(set->ready));
+         for (e = 0; e < NUMBER_OF_PORTS; ++e)
+         {
+            if (interest[e])
+            {
+               set->ready[e / 32] |= ((DWORD)1 << (e % 32));
+            }
+         }
+         LEAVE_CRITICAL();
+         m_ReadyInterest();
+         return ERROR_SUCCESS;
+      }
+
+   case MXVCP_IOCTL_READY_GET:
+      {
+         MxvcpReadyEntry * const entry = (MxvcpReadyEntry *)params->lpvOutBuffer;
+         DWORD const num = params->cbOutBuffer / sizeof(MxvcpReadyEntry);
+         ReadySet * const set = m_ReadyFind(params, 0);
+         DWORD count = 0;
+         DWORD p;
+
+         if ((set == NULL) || (entry == NULL) || (num == 0))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         //check only the ports, that got ready since the last call (level triggered: a port stays in the list, as long as it is ready)
+         for (p = 0; (p < NUMBER_OF_PORTS) && (count < num); ++p)
+         {
+            if (set->ready[p / 32] & ((DWORD)1 << (p % 32)))
+            {
+               PortInformation * const port = &m_PortInformation[p];
+               DWORD const events = m_ReadyEvents(port) & set->interest[p];
+               if (events)
+               {
+                  stdutils_strncpy(entry[count].portName, port->portName, sizeof(entry[count].portName));
+                  entry[count].events = events;
+                  count++;
+               }
+               else
+               {
+                  ENTER_CRITICAL();
+                  set->ready[p / 32] &= ~((DWORD)1 << (p % 32));
+                  LEAVE_CRITICAL();
+               }
+            }
+         }
+         if (params->lpcbBytesReturned)
+         {
+            *(DWORD *)params->lpcbBytesReturned = count * sizeof(MxvcpReadyEntry);
+         }
+         //nothing ready: an overlapped call completes (without data), as soon as a port gets ready
+         if ((count == 0) && params->lpoOverlapped)
+         {
+            DWORD const event = *(DWORD *)params->lpoOverlapped; //O_Internal: event of the overlapped structure
+            DWORD ready = 0;
+            //(the user memory is read outside of the critical section, as it may page fault)
+            ENTER_CRITICAL();
+            for (p = 0; p < READY_WORDS; ++p)
+            {
+               ready |= set->ready[p];
+            }
+            if ((ready == 0) && (set->waitEvent == 0))
+            {
+               set->waitEvent = event;
+               LEAVE_CRITICAL();
+               return ERROR_IO_PENDING;
+            }
+            LEAVE_CRITICAL();
+         }
+         return ERROR_SUCCESS;
+      }
+
+   case MXVCP_IOCTL_GET_BENCH_STATS:
+      {
+         char portName[PORTNAME_LENGTH];
+         PortInformation * port;
+         MxvcpBenchStats * const stats = (MxvcpBenchStats *)params->lpvOutBuffer;
+
+         if ((params->lpvInBuffer == 0) || (stats == NULL) || (params->cbOutBuffer < sizeof(MxvcpBenchStats)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         stdutils_strncpy(portName, (char *)params->lpvInBuffer,
+                          (params->cbInBuffer < sizeof(portName)) ? params->cbInBuffer + 1 : sizeof(portName));
+         port = m_FindPort(portName);
+         if ((port == NULL) || ((port->portType != PORT_TYPE_SOURCE) && (port->portType != PORT_TYPE_SINK)))
+         {
+            return ERROR_FILE_NOT_FOUND;
+         }
+         stats->bytes = port->synthetic.bytes;
+         stats->time = port->isOpen ? (System_GetTime() - port->synthetic.startTime) : 0;
+         stats->checksum = port->synthetic.checksum ^ CRC32_INIT;
+         stats->sequenceErrors = port->synthetic.sequenceErrors;
+         if (params->lpcbBytesReturned)
+         {
+            *(DWORD *)params->lpcbBytesReturned = sizeof(MxvcpBenchStats);
+         }
+         return ERROR_SUCCESS;
+      }
+
+   case MXVCP_IOCTL_GET_SLAB_STATS:
+      {
+         MxvcpSlabStats * const stats = (MxvcpSlabStats *)params->lpvOutBuffer;
+         DWORD const num = params->cbOutBuffer / sizeof(MxvcpSlabStats);
+         SlabStats slab;
+         DWORD c;
+
+         if ((stats == NULL) || (num == 0))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         //one entry per size class (as many as fit into the buffer)
+         for (c = 0; (c < num) && slab_stats(c, &slab); ++c)
+         {
+            stats[c].size = slab.size;
+            stats[c].total = slab.total;
+            stats[c].used = slab.used;
+            stats[c].peak = slab.peak;
+            stats[c].failures = slab.failures;
+         }
+         if (params->lpcbBytesReturned)
+         {
+            *(DWORD *)params->lpcbBytesReturned = c * sizeof(MxvcpSlabStats);
+         }
+         return ERROR_SUCCESS;
+      }
 
-   This function is only called once when this VXD is loaded. This VXD is
-   loaded as far as any of its COM ports is opened. The opening of further
-   COM ports does not lead to execute this function again.
-   However if all COM ports of this VXD get closed, the VXD is unloaded
-   (cf. MXVCP_DeviceExit). If after that a COM port is opened again,
-   the VXD is loaded again and thus, this function is called again.
+   case MXVCP_IOCTL_GET_FRAME_STATS:
+      {
+         char portName[PORTNAME_LENGTH];
+         PortInformation * port;
+         MxvcpFrameStats * const stats = (MxvcpFrameStats *)params->lpvOutBuffer;
 
-   The VXD stays loaded, as long as at least one of its COM ports is open!
+         if ((params->lpvInBuffer == 0) || (stats == NULL) || (params->cbOutBuffer < sizeof(MxvcpFrameStats)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         stdutils_strncpy(portName, (char *)params->lpvInBuffer,
+                          (params->cbInBuffer < sizeof(portName)) ? params->cbInBuffer + 1 : sizeof(portName));
+         port = m_FindPort(portName);
+         if ((port == NULL) || (port->framing == FRAMING_NONE))
+         {
+            return ERROR_FILE_NOT_FOUND;
+         }
+         stats->frames = port->frame.frames;
+         stats->corruptFrames = port->frame.corruptFrames;
+         if (params->lpcbBytesReturned)
+         {
+            *(DWORD *)params->lpcbBytesReturned = sizeof(MxvcpFrameStats);
+         }
+         return ERROR_SUCCESS;
+      }
 
-   \return
-      if port(s) could be configured then NC (carry flag clear)
-      else CY (carry flag set)
-----------------------------------------------------------------------------*/
-BOOL _cdecl MXVCP_DeviceInit(HVM vmHandle)
-{
-#ifdef dbgMsgLen
-   dbgMsg[0] = 0; //ensure zero termination
-   dbgMsg[dbgMsgLen - 1] = 0; //ensure zero termination
-#endif
-#if 0
-   stdutils_strncpy(dbgMsg, "MXVCP_DeviceInit", dbgMsgLen);
-   SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
-#endif
-   m_NextFreePort = 0;
-   m_SysVmHandle = Get_Sys_VM_Handle(); //save handle
-   VCOMM_RegisterPortDriver((PFN)&m_DriverControl); //register driver
-   _asm clc; //clear carry
-   return 1;
-}
+   case MXVCP_IOCTL_TRANSFER:
+      {
+         MxvcpTransfer const * const transfer = (MxvcpTransfer *)params->lpvInBuffer;
+         MxvcpTransferResult * const result = (MxvcpTransferResult *)params->lpvOutBuffer;
+         DWORD const num = params->cbInBuffer / sizeof(MxvcpTransfer);
+         DWORD const process = VWIN32_GetCurrentProcess();
+         DWORD t;
+
+         if ((transfer == NULL) || (result == NULL) || (num == 0) ||
+             (params->cbOutBuffer < num * sizeof(MxvcpTransferResult)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         //the arrays and the data buffers are memory of the application. m_PortWrite and m_PortRead copy
+         //within a critical section, where a page fault is not allowed: lock the pages first
+         if (!Page_LockUser((void *)transfer, num * sizeof(MxvcpTransfer)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         if (!Page_LockUser(result, num * sizeof(MxvcpTransferResult)))
+         {
+            Page_UnlockUser((void *)transfer, num * sizeof(MxvcpTransfer));
+            return ERROR_INVALID_PARAMETER;
+         }
+         //a batch of reads and writes, executed like single ReadFile and WriteFile calls (without waiting)
+         for (t = 0; t < num; ++t)
+         {
+            char portName[PORTNAME_LENGTH];
+            PortInformation * port;
+            PortFunctionTable * functions;
+            void * const buffer = transfer[t].buffer;
+            DWORD const length = transfer[t].length;
+
+            stdutils_strncpy(portName, transfer[t].portName, sizeof(portName));
+            port = m_FindPort(portName);
+            result[t].count = 0;
+            //only the ports, the application has opened itself
+            if ((port == NULL) || !port->isOpen || (port->ownerProcess != process))
+            {
+               result[t].error = IE_NOPEN;
+               continue;
+            }
+            if (transfer[t].operation > MXVCP_TRANSFER_WRITE)
+            {
+               result[t].error = IE_DEFAULT;
+               continue;
+            }
+            if (!Page_LockUser(buffer, length))
+            {
+               result[t].error = IE_DEFAULT;
+               continue;
+            }
+            //through the function table of the port, like VCOMM calls it (the calls are recorded during a capture)
+            functions = (PortFunctionTable *)port->portData.PDfunctions;
+            if ((transfer[t].operation == MXVCP_TRANSFER_WRITE) ?
+                functions->pPortWrite(port, buffer, length, &result[t].count) :
+                functions->pPortRead(port, buffer, length, &result[t].count))
+            {
+               result[t].error = 0;
+            }
+            else
+            {
+               result[t].error = port->portData.dwLastError;
+            }
+            Page_UnlockUser(buffer, length);
+         }
+         Page_UnlockUser(result, num * sizeof(MxvcpTransferResult));
+         Page_UnlockUser((void *)transfer, num * sizeof(MxvcpTransfer));
+         if (params->lpcbBytesReturned)
+         {
+            *(DWORD *)params->lpcbBytesReturned = num * sizeof(MxvcpTransferResult);
+         }
+         return ERROR_SUCCESS;
+      }
 
+   case MXVCP_IOCTL_RING_MAP:
+      {
+         char portName[PORTNAME_LENGTH];
+         PortInformation * port;
 
-/*----------------------------------------------------------------------------
-   \brief Unload port driver.
+         if ((params->lpvInBuffer == 0) || (params->lpvOutBuffer == 0) || (params->cbOutBuffer < sizeof(MxvcpRing *)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         stdutils_strncpy(portName, (char *)params->lpvInBuffer,
+                          (params->cbInBuffer < sizeof(portName)) ? params->cbInBuffer + 1 : sizeof(portName));
+         port = m_FindPort(portName);
+         if ((port == NULL) || !port->isOpen)
+         {
+            return ERROR_FILE_NOT_FOUND;
+         }
+         //only the process, that opened the port, gets its ring
+         if (port->ownerProcess != VWIN32_GetCurrentProcess())
+         {
+            return ERROR_ACCESS_DENIED;
+         }
+         if (!m_RingMap(port))
+         {
+            return ERROR_NOT_ENOUGH_MEMORY;
+         }
+         *(MxvcpRing **)params->lpvOutBuffer = port->ring;
+         if (params->lpcbBytesReturned)
+         {
+            *(DWORD *)params->lpcbBytesReturned = sizeof(MxvcpRing *);
+         }
+         return ERROR_SUCCESS;
+      }
 
-   This function is only called once when the VXD is unloaded. This VXD is
-   unloaded as far as all of its COM ports get closed.
-   The closing of any COM ports does not lead to execute this function as
-   long as any other COM port of this VXD is open.
+   case MXVCP_IOCTL_RING_SIGNAL:
+      {
+         MxvcpRingSignal const * const signal = (MxvcpRingSignal *)params->lpvInBuffer;
+         char portName[PORTNAME_LENGTH];
+         PortInformation * port;
+         PortFifo * fifo;
+         MxvcpSpan span[2];
+         DWORD produced;
+         DWORD consumed;
+         DWORD count;
+         DWORD errors = 0;
+         BOOL valid;
+
+         if ((signal == NULL) || (params->cbInBuffer < sizeof(MxvcpRingSignal)))
+         {
+            return ERROR_INVALID_PARAMETER;
+         }
+         //the client may change its buffer meanwhile: read it once
+         stdutils_strncpy(portName, signal->portName, sizeof(portName));
+         produced = signal->produced;
+         consumed = signal->consumed;
+         port = m_FindPort(portName);
+         if ((port == NULL) || !port->isOpen || (port->ringHandle == 0))
+         {
+            return ERROR_FILE_NOT_FOUND;
+         }
+         if (port->ownerProcess != VWIN32_GetCurrentProcess())
+         {
+            return ERROR_ACCESS_DENIED;
+         }
+         //the client has done, what m_PortWrite resp. m_PortRead would do, except advancing the indices
+         //and the events. its numbers must fit to the indices of the driver
+         fifo = port->rxFifo;
+         ENTER_CRITICAL();
+         count = fifo->QxCount;
+         valid = (consumed <= count) && (produced <= (fifo->QxSize - (count - consumed))) &&
+                 (!produced || !(port->spanLock & SPAN_LOCK_WRITE)); //no other writer, while space is reserved
+         if (valid)
+         {
+            m_SpanSplit(fifo, fifo->QxPut, produced, span);
+            fifo->QxGet = (fifo->QxGet + consumed) % fifo->QxSize;
+            fifo->QxPut = (fifo->QxPut + produced) % fifo->QxSize;
+            fifo->QxCount = count - consumed + produced;
+            //the reader must not see the data, before it is transformed
+            errors = m_LineTransformFifo(port, produced);
+         }
+         LEAVE_CRITICAL();
+         if (!valid)
+         {
+            m_RingPublish(port); //the client may have overwritten the header
+            return ERROR_INVALID_PARAMETER;
+         }
+         if (produced)
+         {
+            //as m_PortWrite of the pair port does after the copy
+            m_ReceiveDone(port, port->pairPort, span, errors);
+            if (port->pairPort)
+            {
+               port->pairPort->stats.bytesOut += produced;
+            }
+         }
+         if (consumed)
+         {
+            m_PortReadDone(port, count, consumed);
+         }
+         m_RingPublish(port);
+         return ERROR_SUCCESS;
+      }
 
-   \return
-      if port(s) could be configured then NC (carry flag clear)
-      else CY (carry flag set)
-----------------------------------------------------------------------------*/
-BOOL _cdecl MXVCP_DeviceExit(HVM vmHandle)
-{
-#if 0
-   stdutils_strncpy(dbgMsg, "MXVCP_DeviceExit", dbgMsgLen);
-   SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
-#endif
-   m_SysVmHandle = 0;
-   _asm clc; //clear carry
-   return 1;
+   default:
+      break;
+   }
+   return ERROR_INVALID_FUNCTION;
 }
 
 
@@ -414,11 +4220,17 @@ static void _cdecl m_DriverControl(DWORD fCode, DWORD DevNode, DWORD DCRefData,
          stdutils_memclr(port, sizeof(PortInformation)); //zero out all data
          port->portData.PDLength = sizeof(PortData);
          port->portData.PDVersion = 0x10A;
-         port->portData.PDfunctions = (PortFunctions *)&m_PortFunctionTable;
+         //(the calls of a port, that is added while they are recorded, are recorded too. cf. m_CaptureSelectTable)
+         port->portData.PDfunctions = (PortFunctions *)(m_Capture.calls ? &m_RecordFunctionTable : &m_PortFunctionTable);
          port->portData.PDNumFunctions = sizeof(PortFunctionTable) / 4;
 
-         //initialize fifo buffers
-         m_FifoInit(port, m_FifoBuffer[m_NextFreePort - 1], FIFO_SIZE_1BY);
+         //fifo buffer is allocated, when the port is opened
+         port->rxFifo = (PortFifo *)&(port->portData.QInAddr);
+         m_FifoInit(port, NULL, 0);
+         //9600 8n1, until set by the application
+         port->dcb.DCBLength = sizeof(_DCB);
+         port->dcb.BaudRate = CBR_9600;
+         port->dcb.ByteSize = 8;
 
          //set port name
          stdutils_strncpy(port->portName, portName, PORTNAME_LENGTH);
@@ -430,29 +4242,142 @@ static void _cdecl m_DriverControl(DWORD fCode, DWORD DevNode, DWORD DCRefData,
 #else //port shall be linked to a pair-port, specified by its name in the registry
          {
             char pairPortName[PORTNAME_LENGTH];
-            DWORD status;
-            DWORD len;
+            char portType[PORTNAME_LENGTH];
             //read pair port name from register
-            len = sizeof(pairPortName);
-            status = CONFIGMG_ReadRegistryValue(DevNode, 0, "PairPortName", REG_SZ, pairPortName, &len, 0); //read from hardware branch
-            if ((status == 0) && (len > 0))
+            if (m_ReadRegistryString(DevNode, "PairPortName", pairPortName, sizeof(pairPortName)))
             {
-               //add zero termination ... and copy into data
-               pairPortName[len] = 0;
                stdutils_strncpy(port->pairPortName, pairPortName, PORTNAME_LENGTH);
             }
+            //read (optional) port type from register
+            if (m_ReadRegistryString(DevNode, "PortType", portType, sizeof(portType)))
+            {
+               if (stdutils_strncmp(portType, "Monitor", sizeof(portType)) == 0)
+               {
+                  //a monitor is not linked as pair port. its "PairPortName" refers to the monitored port
+                  port->portType = PORT_TYPE_MONITOR;
+               }
+               else if (stdutils_strncmp(portType, "Source", sizeof(portType)) == 0)
+               {
+                  port->portType = PORT_TYPE_SOURCE; //a synthetic port is not linked to any other port
+               }
+               else if (stdutils_strncmp(portType, "Sink", sizeof(portType)) == 0)
+               {
+                  port->portType = PORT_TYPE_SINK; //a synthetic port is not linked to any other port
+               }
+               else if (stdutils_strncmp(portType, "Mux", sizeof(portType)) == 0)
+               {
+                  //a multiplexer port is not linked as pair port. its application speaks 27.010
+                  port->portType = PORT_TYPE_MUX;
+                  port->mux.credits = (m_ReadRegistryDword(DevNode, "MuxCredits", 1) != 0);
+               }
+               else if (stdutils_strncmp(portType, "Channel", sizeof(portType)) == 0)
+               {
+                  //a channel port is not linked as pair port. its "PairPortName" refers to the multiplexer port
+                  port->portType = PORT_TYPE_CHANNEL;
+                  port->muxChannel = m_ReadRegistryDword(DevNode, "Channel", 1);
+                  if ((port->muxChannel == 0) || (port->muxChannel > MUX_CHANNELS))
+                  {
+                     port->muxChannel = 1;
+                  }
+               }
+            }
+            //read (optional) data pattern and rate of a synthetic port
+            if ((port->portType == PORT_TYPE_SOURCE) || (port->portType == PORT_TYPE_SINK))
+            {
+               char pattern[PORTNAME_LENGTH];
+               port->synthetic.pattern = PATTERN_NONE;
+               m_ReadRegistryString(DevNode, "Pattern", pattern, sizeof(pattern));
+               if (stdutils_strncmp(pattern, "Counter", sizeof(pattern)) == 0)
+               {
+                  port->synthetic.pattern = PATTERN_COUNTER;
+               }
+               else if (stdutils_strncmp(pattern, "PRBS", sizeof(pattern)) == 0)
+               {
+                  port->synthetic.pattern = PATTERN_PRBS;
+               }
+               else if ((stdutils_strncmp(pattern, "File", sizeof(pattern)) == 0) &&
+                        (port->portType == PORT_TYPE_SOURCE))
+               {
+                  port->synthetic.pattern = PATTERN_FILE;
+                  m_ReadRegistryString(DevNode, "PatternFile", port->synthetic.fileName,
+                                       sizeof(port->synthetic.fileName));
+               }
+               else if (port->portType == PORT_TYPE_SOURCE)
+               {
+                  port->synthetic.pattern = PATTERN_COUNTER; //default pattern of a source
+               }
+               port->synthetic.rate = m_ReadRegistryDword(DevNode, "Rate", 0);
+            }
+            //read (optional) impairment of received data
+            port->impairConfig.delay = m_ReadRegistryDword(DevNode, "ImpairDelay", 0);
+            port->impairConfig.jitter = m_ReadRegistryDword(DevNode, "ImpairJitter", 0);
+            port->impairConfig.dropRate = m_ReadRegistryDword(DevNode, "ImpairDropRate", 0);
+            port->impairConfig.bitErrorRate = m_ReadRegistryDword(DevNode, "ImpairBitErrorRate", 0);
+            port->impairConfig.frameErrorRate = m_ReadRegistryDword(DevNode, "ImpairFrameErrorRate", 0);
+            port->impairConfig.outageRate = m_ReadRegistryDword(DevNode, "ImpairOutageRate", 0);
+            port->impairConfig.outageTime = m_ReadRegistryDword(DevNode, "ImpairOutageTime", 0);
+            port->impairConfig.seed = m_ReadRegistryDword(DevNode, "ImpairSeed", 1);
+            //read (optional) message mode
+            port->messageMode = (m_ReadRegistryDword(DevNode, "MessageMode", 0) != 0);
+            //read (optional) limit of adaptive fifo growth
+            port->fifoSizeBase = FIFO_SIZE_1BY;
+            port->fifoSizeMax = m_ReadRegistryDword(DevNode, "FifoSizeMax", FIFO_SIZE_1BY);
+            if (port->fifoSizeMax < FIFO_SIZE_1BY)
+            {
+               port->fifoSizeMax = FIFO_SIZE_1BY;
+            }
+            if (port->fifoSizeMax > FIFO_SIZE_MAX)
+            {
+               port->fifoSizeMax = FIFO_SIZE_MAX;
+            }
+            port->fifoIdleTime = m_ReadRegistryDword(DevNode, "FifoIdleTime", FIFO_IDLE_TIME);
+            //read (optional) rx interval, after that received data is signaled below the rx trigger level
+            port->rxIntervalTime = m_ReadRegistryDword(DevNode, "ReadIntervalTimeout", 0);
+            //read (optional) framing of received data
+            {
+               char framing[PORTNAME_LENGTH];
+               port->framing = FRAMING_NONE;
+               m_ReadRegistryString(DevNode, "Framing", framing, sizeof(framing));
+               if (stdutils_strncmp(framing, "SLIP", sizeof(framing)) == 0)
+               {
+                  port->framing = FRAMING_SLIP;
+               }
+               else if (stdutils_strncmp(framing, "HDLC", sizeof(framing)) == 0)
+               {
+                  port->framing = FRAMING_HDLC;
+               }
+               else if (stdutils_strncmp(framing, "Modbus", sizeof(framing)) == 0)
+               {
+                  port->framing = FRAMING_MODBUS;
+               }
+               port->frame.gap = m_ReadRegistryDword(DevNode, "FrameGap", FRAME_GAP_DEFAULT);
+            }
+            //read (optional) capture and replay files. they are used for all ports
+            if (m_CaptureFileName[0] == 0)
+            {
+               m_ReadRegistryString(DevNode, "CaptureFile", m_CaptureFileName, sizeof(m_CaptureFileName));
+            }
+            if (m_ReplayFileName[0] == 0)
+            {
+               m_ReadRegistryString(DevNode, "ReplayFile", m_ReplayFileName, sizeof(m_ReplayFileName));
+            }
             //link port-instance and port pair instance to each other
             //therefore: find instance of pair port, by name
-            for (p = 0; p < (m_NextFreePort - 1); ++p)
+            for (p = 0; (p < (m_NextFreePort - 1)) && (port->portType == PORT_TYPE_NORMAL); ++p)
             {
                PortInformation * const pairPort = &m_PortInformation[p];
-               if (stdutils_strncmp(pairPort->portName, port->pairPortName, PORTNAME_LENGTH) == 0)
+               if ((pairPort->portType == PORT_TYPE_NORMAL) &&
+                   (stdutils_strncmp(pairPort->portName, port->pairPortName, PORTNAME_LENGTH) == 0))
                {
                   port->pairPort = pairPort;
                   pairPort->pairPort = port;
                   break;
                }
             }
+            //(re-)link monitor ports, as the monitored pair may be completed just now
+            m_LinkMonitors();
+            //link channel ports, as the multiplexer port may be added just now
+            m_LinkChannels();
          }
 #endif
       }
@@ -460,6 +4385,7 @@ static void _cdecl m_DriverControl(DWORD fCode, DWORD DevNode, DWORD DCRefData,
       //add port to VCOMM
       if (port != NULL)
       {
+         m_PerfAddPort(port);
          //add port with given name
          VCOMM_AddPort(DCRefData, (PFN)&m_PortOpen, portName);
       }
@@ -523,13 +4449,37 @@ static PortInformation * _cdecl m_PortOpen(char *PortName, DWORD VMId, long *lpE
          port->rxCallbackTriggerLevel = -1;
          port->portData.dwLastReceiveTime = 0;
 
-         //flush fifo
-         m_FifoFlush(port);
+         //get (empty) fifo
+         if (!m_FifoOpen(port))
+         {
+            port->portData.dwLastError = IE_MEMORY;
+            if (lpError != NULL) *lpError = IE_MEMORY;
+            return NULL;
+         }
+         port->portData.dwCommError = 0;
+         m_ImpairOpen(port);
+         m_FrameReset(port, 1);
 
          //success
          port->portData.dwLastError = 0;
+         port->ownerProcess = VWIN32_GetCurrentProcess(); //CreateFile runs in the context of the application
          port->isOpen = 1;
 
+         //start production of data pattern
+         if ((port->portType == PORT_TYPE_SOURCE) || (port->portType == PORT_TYPE_SINK))
+         {
+            m_SyntheticOpen(port);
+         }
+         //start channel(s)
+         if (port->portType == PORT_TYPE_MUX)
+         {
+            m_MuxOpen(port);
+         }
+         else if (port->portType == PORT_TYPE_CHANNEL)
+         {
+            m_MuxStart(port);
+         }
+
          //issue CTS, DTS event to pair port
          if (port->pairPort && port->pairPort->isOpen)
          {
@@ -539,9 +4489,11 @@ static PortInformation * _cdecl m_PortOpen(char *PortName, DWORD VMId, long *lpE
             {
                events |= (events & EV_CTS) ? EV_CTSS : 0; //set CTS state (if user is interested in CTS events)
                events |= (events & EV_DSR) ? EV_DSRS : 0; //set DSR state (if user is interested in DSR events)
+               port->pairPort->stats.callbacks++;
                port->pairPort->eventCallback(port->pairPort, port->pairPort->portData.dwClientRefData, CN_EVENT, events);
             }
          }
+         m_CaptureCall(port, MXVCP_CALL_OPEN, VMId, 0, 0, 1, port->portName, PORTNAME_LENGTH);
          return port;
       }
    }
@@ -608,7 +4560,24 @@ static BOOL _cdecl m_PortClose(PortInformation * hPort)
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
    //close this port
+   if (m_Replay.port == hPort)
+   {
+      m_ReplayStop();
+   }
+   if ((hPort->portType == PORT_TYPE_SOURCE) || (hPort->portType == PORT_TYPE_SINK))
+   {
+      m_SyntheticClose(hPort);
+   }
+   if (hPort->portType == PORT_TYPE_CHANNEL)
+   {
+      m_MuxClose(hPort);
+   }
    hPort->isOpen = 0;
+   wheel_cancel(&hPort->rxIntervalTimer);
+   m_ImpairClose(hPort);
+   m_FrameReset(hPort, 0);
+   m_FifoClose(hPort);
+   slab_trim(); //return the memory, other ports released after their grace period, to the heap
    hPort->eventCallback = 0;
    hPort->txCallback = 0;
    hPort->rxCallback = 0;
@@ -619,6 +4588,7 @@ static BOOL _cdecl m_PortClose(PortInformation * hPort)
       *hPort->pairPort->eventRegister |= (EV_CTS | EV_DSR);
       if (event && hPort->pairPort->eventCallback)
       {
+         hPort->pairPort->stats.callbacks++;
          hPort->pairPort->eventCallback(hPort->pairPort, hPort->pairPort->portData.dwClientRefData, CN_EVENT, event);
       }
    }
@@ -628,6 +4598,68 @@ static BOOL _cdecl m_PortClose(PortInformation * hPort)
 
 
 
+//continue everything, that waits for free space in the rx fifo of a port, after data was read from it
+//(by m_PortRead, or by the client of the shared ring). must be callable at interrupt time.
+static void m_PortReadDone(PortInformation * hPort, DWORD fifoCountBefore, DWORD received)
+{
+   hPort->stats.bytesIn += received;
+   hPort->stats.rxFill = m_FifoCount(hPort);
+   m_RingPublish(hPort);
+   //continue a replay, that is waiting for free space
+   if (received && (m_Replay.port == hPort))
+   {
+      m_ReplayPump();
+   }
+   //continue release of delayed data, that is waiting for free space
+   if (received && hPort->impairLine)
+   {
+      m_ImpairRelease(hPort);
+   }
+   //grant credits for the space, that is free again
+   if (received && (hPort->portType == PORT_TYPE_CHANNEL))
+   {
+      m_MuxGrant(hPort);
+   }
+   //a source, that is not rate limited, produces as much as it is read
+   if ((hPort->portType == PORT_TYPE_SOURCE) && (hPort->synthetic.rate == 0))
+   {
+      m_SourceFill(hPort, received);
+   }
+   //trigger tx events of pair port
+   if (received && hPort->pairPort && hPort->pairPort->isOpen)
+   {
+      DWORD events = EV_TXCHAR; //issue that event,if at least one char is read
+      m_ReadyNotify(hPort->pairPort, MXVCP_READY_TX);
+      if (m_TxFifoCount(hPort, m_FifoCount(hPort)) == 0) //if fillstate of receive fifo of this port is less than 50%...
+      {
+         events |= EV_TXEMPTY; //...then the tx fifo of the pair port is declared empty!
+      }
+      *hPort->pairPort->eventRegister |= events;
+      events = events & hPort->pairPort->eventMask;
+      if (events && hPort->pairPort->eventCallback)
+      {
+         hPort->pairPort->stats.callbacks++;
+         hPort->pairPort->eventCallback(hPort->pairPort, hPort->pairPort->portData.dwClientRefData,
+                                          CN_EVENT, events);
+      }
+      if (hPort->pairPort->txCallback)
+      {
+         //tx fifo of pair port is "emulated" by the rx fifo of this port ...
+         DWORD const txFifoCountBefore = m_TxFifoCount(hPort, fifoCountBefore);
+         DWORD const txFifoCountAfter = m_TxFifoCount(hPort, m_FifoCount(hPort));
+         //the fillstate of the "tx fifo" is fallen "below" the threshold (due to this read operation)
+         if ((txFifoCountBefore > (DWORD)(hPort->pairPort->txCallbackTriggerLevel)) &&
+             (txFifoCountAfter <= (DWORD)(hPort->pairPort->txCallbackTriggerLevel)))
+         {
+            hPort->pairPort->stats.callbacks++;
+            hPort->pairPort->txCallback(hPort->pairPort, hPort->pairPort->txCallbackParameter,
+                                        CN_TRANSMIT, 0);
+         }
+      }
+   }
+}
+
+
 /*----------------------------------------------------------------------------
    \brief Called by the _VCOMM_ReadComm service to read characters from the receive queue for the
    specified port.
@@ -658,44 +4690,7 @@ static BOOL _cdecl m_PortRead(PortInformation * hPort, void * achBuffer, DWORD c
       DWORD fifoCountBefore = m_FifoCount(hPort);
       DWORD received = m_FifoRead(hPort, achBuffer, cchRequested);
       *cchReceived = received;
-      //trigger tx events of pair port
-      if (received && hPort->pairPort && hPort->pairPort->isOpen)
-      {
-         DWORD events = EV_TXCHAR; //issue that event,if at least one char is read
-         if (m_FifoCount(hPort) <= FIFO_SIZE_1BY/2) //if fillstate of receive fifo of this port is less than 50%...
-         {
-            events |= EV_TXEMPTY; //...then the tx fifo of the pair port is declared empty!
-         }
-         *hPort->pairPort->eventRegister |= events;
-         events = events & hPort->pairPort->eventMask;
-         if (events && hPort->pairPort->eventCallback)
-         {
-            hPort->pairPort->eventCallback(hPort->pairPort, hPort->pairPort->portData.dwClientRefData,
-                                             CN_EVENT, events);
-         }
-         if (hPort->pairPort->txCallback)
-         {
-            //tx fifo of pair port is "emulated" by the rx fifo of this port ...
-            DWORD fifoCountAfter = m_FifoCount(hPort);
-            DWORD txFifoCountBefore = 0;
-            DWORD txFifoCountAfter = 0;
-            if (fifoCountBefore > FIFO_SIZE_1BY/2)
-            {
-               txFifoCountBefore = fifoCountBefore - FIFO_SIZE_1BY/2;
-            }
-            if (fifoCountAfter > FIFO_SIZE_1BY/2)
-            {
-               txFifoCountAfter = fifoCountAfter - FIFO_SIZE_1BY/2;
-            }
-            //the fillstate of the "tx fifo" is fallen "below" the threshold (due to this read operation)
-            if ((txFifoCountBefore > (DWORD)(hPort->pairPort->txCallbackTriggerLevel)) &&
-                (txFifoCountAfter <= (DWORD)(hPort->pairPort->txCallbackTriggerLevel)))
-            {
-               hPort->pairPort->txCallback(hPort->pairPort, hPort->pairPort->txCallbackParameter,
-                                           CN_TRANSMIT, 0);
-            }
-         }
-      }
+      m_PortReadDone(hPort, fifoCountBefore, received);
       hPort->portData.dwLastError = 0;
       return 1; //success
    }
@@ -728,11 +4723,30 @@ static BOOL _cdecl m_PortWrite(PortInformation * hPort, void * achBuffer, DWORD
    if (hPort->isOpen)
    {
       DWORD written;
+      //monitor ports are read only
+      if (hPort->portType == PORT_TYPE_MONITOR)
+      {
+         *cchWritten = 0;
+         hPort->portData.dwLastError = IE_DEFAULT;
+         return 0; //error - write not supported
+      }
       //pair channel open
       if ((!hPort->pairPort) || (!hPort->pairPort->isOpen))
       {
-         //drop all data while pair channel is close
+         //drop all data while pair channel is close (or there is no pair channel, like for synthetic ports)
          written = cchRequested;
+         if (hPort->portType == PORT_TYPE_SINK)
+         {
+            m_SinkConsume(hPort, achBuffer, written);
+         }
+         else if (hPort->portType == PORT_TYPE_MUX)
+         {
+            m_MuxReceive(hPort, achBuffer, written); //frames of the channels
+         }
+         else if (hPort->portType == PORT_TYPE_CHANNEL)
+         {
+            written = m_MuxSend(hPort, achBuffer, written); //as far as the peer has granted credits
+         }
          *cchWritten = written;
          //trigger tx event callback (if set)
          if (written)
@@ -742,6 +4756,7 @@ static BOOL _cdecl m_PortWrite(PortInformation * hPort, void * achBuffer, DWORD
             events = events & hPort->eventMask;
             if (events && hPort->eventCallback)
             {
+               hPort->stats.callbacks++;
                hPort->eventCallback(hPort, hPort->portData.dwClientRefData, CN_EVENT, events);
             }
             if (hPort->txCallback)
@@ -749,6 +4764,7 @@ static BOOL _cdecl m_PortWrite(PortInformation * hPort, void * achBuffer, DWORD
                DWORD fifoCount = 0; //everything was dropped away. to the tx fifo is empty
                if (fifoCount <= (DWORD)(hPort->txCallbackTriggerLevel))
                {
+                  hPort->stats.callbacks++;
                   hPort->txCallback(hPort, hPort->txCallbackParameter, CN_TRANSMIT, 0);
                }
             }
@@ -756,33 +4772,54 @@ static BOOL _cdecl m_PortWrite(PortInformation * hPort, void * achBuffer, DWORD
       }
       else
       {
-         //otherwise: write into pair channels fifo
-         written = m_FifoWrite(hPort->pairPort, achBuffer, cchRequested);
-         *cchWritten = written;
-         //trigger rx events of pair port
-         if (written)
+         //in message mode, the check for space and the write must not be interrupted by another writer
+         BOOL const atomic = hPort->messageMode;
+         if (atomic)
          {
-            hPort->pairPort->portData.dwLastReceiveTime = System_GetTime();
-            *hPort->pairPort->eventRegister |= EV_RXCHAR;
-            if (hPort->pairPort->eventCallback)
+            ENTER_CRITICAL();
+            //(the delay line of an impairment stage may take more, than the fifo ever can)
+            if ((cchRequested > m_PortRxSpace(hPort->pairPort, cchRequested)) ||
+                (cchRequested > m_FifoSizeLimit(hPort->pairPort)))
             {
-               if (hPort->pairPort->eventMask & EV_RXCHAR)
-               {
-                  hPort->pairPort->eventCallback(hPort->pairPort, hPort->pairPort->portData.dwClientRefData,
-                                                 CN_EVENT, EV_RXCHAR);
-               }
+               LEAVE_CRITICAL();
+               //the message doesn't fit completely: reject it (cf. m_PortClearError)
+               *cchWritten = 0;
+               hPort->portData.dwCommError |= CE_TXFULL;
+               hPort->portData.dwLastError = IE_DEFAULT;
+               return 0;
             }
-            if (hPort->pairPort->rxCallback)
+         }
+         //write into pair channels fifo (through its impairment stage, if active)
+         if (hPort->pairPort->impairLine)
+         {
+            written = m_ImpairWrite(hPort->pairPort, achBuffer, cchRequested, atomic);
+            if (atomic)
             {
-               DWORD fifoCount = m_FifoCount(hPort->pairPort);
-               if (fifoCount >= (DWORD)(hPort->pairPort->rxCallbackTriggerLevel))
-               {
-                  hPort->pairPort->rxCallback(hPort->pairPort, hPort->pairPort->rxCallbackParameter,
-                                              CN_RECEIVE, 0);
-               }
+               LEAVE_CRITICAL();
+            }
+            m_ImpairRelease(hPort->pairPort); //(callbacks must not be called within the critical section)
+         }
+         else
+         {
+            MxvcpSpan span[2];
+            DWORD errors;
+            written = m_LineReceive(hPort->pairPort, achBuffer, cchRequested, span, &errors);
+            if (atomic)
+            {
+               LEAVE_CRITICAL();
             }
+            //trigger rx events of pair port (the impairment stage does so on release).
+            //with a framing stage, this is done once per complete frame only
+            m_ReceiveDone(hPort->pairPort, NULL, span, errors);
+         }
+         *cchWritten = written;
+         if (written)
+         {
+            m_MonitorMirror(hPort, achBuffer, written);
+            m_CaptureRecord(hPort, achBuffer, written);
          }
       }
+      hPort->stats.bytesOut += *cchWritten;
       hPort->portData.dwLastError = 0;
       return 1; //success
    }
@@ -835,6 +4872,16 @@ static BOOL _cdecl m_PortPurge(PortInformation * hPort, DWORD dwQueueType)
       if (dwQueueType == 1) //receive queue
       {
          m_FifoFlush(hPort);
+         if (hPort->impairLine)
+         {
+            m_ImpairFlush(hPort->impairLine);
+         }
+         m_FrameReset(hPort, 0);
+         //the peer may send again, what fits into the empty fifo
+         if (hPort->portType == PORT_TYPE_CHANNEL)
+         {
+            m_MuxGrant(hPort);
+         }
       }
       hPort->portData.dwLastError = 0;
       return 1; //success (nothing todo for transmit queue)
@@ -965,6 +5012,7 @@ static BOOL _cdecl m_PortEnableNotification(PortInformation * hPort, PCommNotify
    {
       if (hPort->eventMask & EV_TXEMPTY)
       {
+         hPort->stats.callbacks++;
          hPort->eventCallback(hPort, hPort->portData.dwClientRefData, CN_EVENT, EV_TXEMPTY);
       }
    }
@@ -1004,9 +5052,9 @@ static BOOL _cdecl m_PortSetReadCallback(PortInformation * hPort, long rxTrigger
    len += stdutils_uitoa(&dbgMsg[len], (DWORD)rxTrigger, dbgMsgLen - len);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
-   if (rxTrigger > FIFO_SIZE_1BY)
+   if (rxTrigger > (long)hPort->fifoSizeBase)
    {
-      rxTrigger = FIFO_SIZE_1BY; //limit threshold value
+      rxTrigger = hPort->fifoSizeBase; //limit threshold value
    }
    hPort->rxCallbackTriggerLevel = rxTrigger;
    hPort->rxCallbackParameter = lReferenceData;
@@ -1018,6 +5066,7 @@ static BOOL _cdecl m_PortSetReadCallback(PortInformation * hPort, long rxTrigger
       DWORD fifoCount = m_FifoCount(hPort);
       if (fifoCount >= (DWORD)(hPort->rxCallbackTriggerLevel))
       {
+         hPort->stats.callbacks++;
          hPort->rxCallback(hPort, hPort->rxCallbackParameter, CN_RECEIVE, 0);
       }
    }
@@ -1047,6 +5096,7 @@ static BOOL _cdecl m_PortSetReadCallback(PortInformation * hPort, long rxTrigger
 static BOOL _cdecl m_PortSetWriteCallback(PortInformation * hPort, long txTrigger, PCommNotifyProc commNotifyProc,
                                           DWORD lReferenceData)
 {
+   DWORD txFifoSize;
 #if 0
    unsigned int len;
    len  = stdutils_strncpy(dbgMsg, "m_PortSetWriteCallback:", dbgMsgLen);
@@ -1057,9 +5107,11 @@ static BOOL _cdecl m_PortSetWriteCallback(PortInformation * hPort, long txTrigge
    len += stdutils_uitoa(&dbgMsg[len], (DWORD)txTrigger, dbgMsgLen - len);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
-   if (txTrigger > (FIFO_SIZE_1BY/2 - 1)) //50% chosen randomly ;-)
+   //the tx fifo is emulated by the upper half of the rx fifo of the pair port (of its configured size, cf. m_TxFifoCount)
+   txFifoSize = hPort->pairPort ? hPort->pairPort->fifoSizeBase/2 : FIFO_SIZE_1BY/2;
+   if (txTrigger > (long)(txFifoSize - 1)) //50% chosen randomly ;-)
    {
-      txTrigger = (FIFO_SIZE_1BY/2 - 1); //limit threshold value
+      txTrigger = (txFifoSize - 1); //limit threshold value
    }
    hPort->txCallbackTriggerLevel = txTrigger;
    hPort->txCallbackParameter = lReferenceData;
@@ -1072,14 +5124,11 @@ static BOOL _cdecl m_PortSetWriteCallback(PortInformation * hPort, long txTrigge
       if (hPort->pairPort && hPort->pairPort->isOpen)
       {
          //tx fifo of this port is "emulated" by the rx fifo of pair port ...
-         DWORD fifoCount = m_FifoCount(hPort->pairPort);
-         if (fifoCount > FIFO_SIZE_1BY/2)
-         {
-            txFifoCount = fifoCount - FIFO_SIZE_1BY/2;
-         }
+         txFifoCount = m_TxFifoCount(hPort->pairPort, m_FifoCount(hPort->pairPort));
       }
       if (txFifoCount <= (DWORD)(hPort->txCallbackTriggerLevel))
       {
+         hPort->stats.callbacks++;
          hPort->txCallback(hPort, hPort->txCallbackParameter, CN_TRANSMIT, 0);
       }
    }
@@ -1104,7 +5153,7 @@ static BOOL _cdecl m_PortGetProperties(PortInformation * hPort, _COMMPROP * cmmp
    stdutils_strncpy(dbgMsg, "m_PortGetProperties", dbgMsgLen);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
-   stdutils_memclr(&cmmp, sizeof(_COMMPROP));
+   stdutils_memclr(cmmp, sizeof(_COMMPROP));
    cmmp->wPacketLength = sizeof(_COMMPROP);
    cmmp->wPacketVersion = 2;
    cmmp->dwServiceMask = SP_SERIALCOMM;
@@ -1148,11 +5197,7 @@ static BOOL _cdecl m_PortGetCommConfig(PortInformation * hPort, _DCB * dcbPort,
       status = 1;
       if (dcbPort != 0)
       {
-         //say 9600 8n1
-         stdutils_memclr(&dcbPort, sizeof(_DCB));
-         dcbPort->DCBLength = sizeof(_DCB);
-         dcbPort->BaudRate = CBR_9600;
-         dcbPort->ByteSize = 8;
+         stdutils_memcpy(dcbPort, &hPort->dcb, sizeof(_DCB));
       }
    }
    *dwSize = sizeof(_DCB);
@@ -1201,11 +5246,7 @@ static BOOL _cdecl m_PortGetCommState(PortInformation * hPort, _DCB * dcbPort)
    stdutils_strncpy(dbgMsg, "m_PortGetCommState", dbgMsgLen);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
-   //alway say 9600 8n1
-   stdutils_memclr(&dcbPort, sizeof(_DCB));
-   dcbPort->DCBLength = sizeof(_DCB);
-   dcbPort->BaudRate = CBR_9600;
-   dcbPort->ByteSize = 8;
+   stdutils_memcpy(dcbPort, &hPort->dcb, sizeof(_DCB));
    hPort->portData.dwLastError = 0;
    return 1;
 }
@@ -1231,8 +5272,40 @@ static BOOL _cdecl m_PortSetCommState(PortInformation * hPort, _DCB * dcbPort, D
    stdutils_strncpy(dbgMsg, "m_PortSetCommState", dbgMsgLen);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
+   _DCB * const dcb = &hPort->dcb;
+
+   if (((ActionMask & fByteSize) && ((dcbPort->ByteSize < 5) || (dcbPort->ByteSize > 8))) ||
+       ((ActionMask & fbParity) && (dcbPort->Parity > SPACEPARITY)))
+   {
+      hPort->portData.dwLastError = IE_BYTESIZE;
+      return 0;
+   }
+   if ((ActionMask & fBaudRate) && (dcbPort->BaudRate == 0))
+   {
+      hPort->portData.dwLastError = IE_BAUDRATE;
+      return 0;
+   }
+   if (ActionMask & fBaudRate) dcb->BaudRate = dcbPort->BaudRate;
+   if (ActionMask & fBitMask) dcb->BitMask = dcbPort->BitMask;
+   if (ActionMask & fXonLim) dcb->XonLim = dcbPort->XonLim;
+   if (ActionMask & fXoffLim) dcb->XoffLim = dcbPort->XoffLim;
+   if (ActionMask & fByteSize) dcb->ByteSize = dcbPort->ByteSize;
+   if (ActionMask & fbParity) dcb->Parity = dcbPort->Parity;
+   if (ActionMask & fStopBits) dcb->StopBits = dcbPort->StopBits;
+   if (ActionMask & fXonChar) dcb->XonChar = dcbPort->XonChar;
+   if (ActionMask & fXoffChar) dcb->XoffChar = dcbPort->XoffChar;
+   if (ActionMask & fErrorChar) dcb->ErrorChar = dcbPort->ErrorChar;
+   if (ActionMask & fEofChar) dcb->EofChar = dcbPort->EofChar;
+   if (ActionMask & fEvtChar2) dcb->EvtChar2 = dcbPort->EvtChar2;
+   if (ActionMask & fEvtChar1)
+   {
+      dcb->EvtChar1 = dcbPort->EvtChar1;
+      hPort->evtChar = dcbPort->EvtChar1; //the received data is scanned for this char (cf. EV_RXFLAG)
+   }
+   //the line format affects both directions of the pair
+   m_LineUpdate(hPort);
    hPort->portData.dwLastError = 0;
-   return 1; //accept everything, but drop it away!
+   return 1;
 }
 
 
@@ -1255,7 +5328,9 @@ static BOOL _cdecl m_PortGetModemStatus(PortInformation * hPort, DWORD * dwModem
    stdutils_strncpy(dbgMsg, "m_PortGetModemStatus", dbgMsgLen);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
-   if ((hPort->pairPort) && (hPort->pairPort->isOpen))
+   if (((hPort->pairPort) && (hPort->pairPort->isOpen)) ||
+       (hPort->portType == PORT_TYPE_SOURCE) || (hPort->portType == PORT_TYPE_SINK) ||
+       ((hPort->portType == PORT_TYPE_CHANNEL) && hPort->muxPort && hPort->muxPort->isOpen))
    {
       //TBD: ignore fifo fillstate - always issue CTS if pair port is open!
       // DWORD fifoCount = m_FifoCount(hPort->pairPort); //get number of bytes in rx buffer of pair channel
@@ -1313,11 +5388,13 @@ static BOOL _cdecl m_PortSetModemStatusShadow(PortInformation * hPort, DWORD dwE
    \param   hPort    Address of a PORTINFORMATION_t structure returned by the PortOpen function.
    \param   cmst     Address of a COMSTAT_t structure that receives information about the state of the
                      communications channel. Can be NULL.
+   \param   lpErrors Address of a 32-bit variable that receives the error mask (CE_xxx). The errors
+                     are cleared. Can be NULL.
 
    \retval  TRUE     if successful
    \retval  FALSE    otherwise
 ----------------------------------------------------------------------------*/
-static BOOL _cdecl m_PortClearError(PortInformation * hPort, _COMSTAT * cmst)
+static BOOL _cdecl m_PortClearError(PortInformation * hPort, _COMSTAT * cmst, DWORD * lpErrors)
 {
 #if 0
    stdutils_strncpy(dbgMsg, "m_PortClearError", dbgMsgLen);
@@ -1331,17 +5408,19 @@ static BOOL _cdecl m_PortClearError(PortInformation * hPort, _COMSTAT * cmst)
       //tx fifo is "emulated" by rx fifo of pair port
       if (hPort->pairPort && hPort->pairPort->isOpen)
       {
-         DWORD fifoCount = m_FifoCount(hPort->pairPort);
-         if (fifoCount > FIFO_SIZE_1BY/2)
-         {
-            txFifoCount = fifoCount - FIFO_SIZE_1BY/2;
-         }
+         txFifoCount = m_TxFifoCount(hPort->pairPort, m_FifoCount(hPort->pairPort));
       }
       //set fifo count
       cmst->BitMask = 0;
       cmst->cbInque = rxFifoCount;
       cmst->cbOutque = txFifoCount;
    }
+   //report and clear errors (e.g. framing errors of the impairment stage)
+   if (lpErrors)
+   {
+      *lpErrors = hPort->portData.dwCommError;
+   }
+   hPort->portData.dwCommError = 0;
    hPort->portData.dwLastError = 0;
    return 1;
 }
@@ -1388,10 +5467,56 @@ static BOOL _cdecl m_PortGetWin32Error(PortInformation * hPort, DWORD * dwError)
 ----------------------------------------------------------------------------*/
 static BOOL _cdecl m_PortEscapeFunction(PortInformation * hPort, DWORD lFunc, DWORD InData, DWORD * OutData)
 {
+   BOOL status = 1;
 #if 0
    stdutils_strncpy(dbgMsg, "m_PortEscapeFunction", dbgMsgLen);
    SHELL_SendMessage(m_SysVmHandle, NULL, dbgMsg);
 #endif
-   hPort->portData.dwLastError = 0;
-   return 1; //say always success!
+   switch (lFunc)
+   {
+   case MXVCP_ESC_CAPTURE_START:
+      status = m_CaptureStart(InData);
+      break;
+
+   case MXVCP_ESC_CAPTURE_STOP:
+      m_CaptureStop();
+      break;
+
+   case MXVCP_ESC_REPLAY_START:
+      status = hPort->isOpen && m_ReplayStart(hPort, InData);
+      break;
+
+   case MXVCP_ESC_REPLAY_STOP:
+      if (m_Replay.port == hPort)
+      {
+         m_ReplayStop();
+      }
+      break;
+
+   case MXVCP_ESC_MESSAGE_MODE:
+      hPort->messageMode = (InData != 0);
+      break;
+
+   case MXVCP_ESC_FIFO_RESIZE:
+      status = hPort->isOpen && m_FifoResize(hPort, InData);
+      break;
+
+   case MXVCP_ESC_GET_SPAN_API:
+      if (OutData == NULL)
+      {
+         status = 0;
+         break;
+      }
+      ((MxvcpSpanApi *)OutData)->port = hPort;
+      ((MxvcpSpanApi *)OutData)->peek = (DWORD (_cdecl *)(void *, MxvcpSpan *))m_SpanPeek;
+      ((MxvcpSpanApi *)OutData)->commit = (void (_cdecl *)(void *, DWORD))m_SpanCommit;
+      ((MxvcpSpanApi *)OutData)->reserve = (DWORD (_cdecl *)(void *, DWORD, MxvcpSpan *))m_SpanReserve;
+      ((MxvcpSpanApi *)OutData)->publish = (void (_cdecl *)(void *, DWORD))m_SpanPublish;
+      break;
+
+   default:
+      break; //say always success!
+   }
+   hPort->portData.dwLastError = status ? 0 : IE_DEFAULT;
+   return status;
 }
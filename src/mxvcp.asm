@@ -7,6 +7,7 @@ include   VCOMM.INC
 
 
 EXTRN _MXVCP_DeviceInit:PROC
+EXTRN _MXVCP_DeviceIOControl:PROC
 
 
 
@@ -26,6 +27,7 @@ VxD_Locked_Code_Seg
 ;      Control_Dispatch DEVICE_INIT, MXVCP_DeviceInit, cCall, <ebx>
       Control_Dispatch SYS_DYNAMIC_DEVICE_INIT, _MXVCP_DeviceInit, cCall, <ebx>
       Control_Dispatch SYS_DYNAMIC_DEVICE_EXIT, _MXVCP_DeviceExit, cCall, <ebx>
+      Control_Dispatch W32_DEVICEIOCONTROL, _MXVCP_DeviceIOControl, cCall, <esi>
       clc
       ret
    EndProc MXVCP_Control
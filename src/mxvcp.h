@@ -0,0 +1,312 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Definitions shared between the driver and its clients.
+
+   This file describes the data formats and the private function codes of
+   the driver, which are visible to applications (e.g. the record format
+   of a monitor port). It doesn't include any header by itself, as it is
+   used from within the VxD (basedef.h) as well as from Win32 applications
+   (windows.h). One of them must be included before this file.
+*/
+//-----------------------------------------------------------------------------
+#ifndef MXVCP_H_
+#define MXVCP_H_
+
+/* -- Includes ------------------------------------------------------------ */
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+
+//direction of a traffic record, relative to the ports "A" and "B" of a pair (monitor port and capture file).
+//"A" is the port of the pair with the lower port index, "B" is its pair port.
+#define MXVCP_DIR_A_TO_B         (0)
+#define MXVCP_DIR_B_TO_A         (1)
+#define MXVCP_DIR_CALL           (2)     //not a traffic record, but the record of a port function call (cf. MxvcpCallRecord)
+#define MXVCP_DIR_CALL_DATA      (3)     //further data of the preceding call record (cf. MXVCP_RECORD_CHUNK)
+
+//private extended functions (cf. EscapeCommFunction). 0..199 are reserved by Microsoft.
+#define MXVCP_ESC_CAPTURE_START  (200)   //start capture of all traffic into "CaptureFile". InData: MXVCP_CAPTURE_xxx flags
+#define MXVCP_ESC_CAPTURE_STOP   (201)   //stop capture and close "CaptureFile"
+#define MXVCP_ESC_REPLAY_START   (202)   //replay "ReplayFile" into the port. InData: MXVCP_REPLAY_xxx flags
+#define MXVCP_ESC_REPLAY_STOP    (203)   //stop replay
+#define MXVCP_ESC_MESSAGE_MODE   (204)   //InData: 1 to enable, 0 to disable message mode of the port
+#define MXVCP_ESC_FIFO_RESIZE    (205)   //InData: new size of the rx fifo of the port (256..8192)
+#define MXVCP_ESC_GET_SPAN_API   (206)   //ring 0 clients only. OutData: MxvcpSpanApi * (filled in by the driver)
+
+//multiplexer port (port type "Mux", 27.010 basic option): frames F9 | address | control | length | info | FCS | F9.
+//an UIH frame (0xEF) with P/F bit (0x10) carries credits (number of frames the receiver may send) in its first info byte.
+#define MXVCP_MUX_FRAME_SIZE     (64)    //max. number of data bytes per frame, sent by the driver
+
+//flags of MXVCP_ESC_CAPTURE_START
+#define MXVCP_CAPTURE_CALLS      (0x01)  //record the calls of VCOMM to the port functions too (MXVCP_DIR_CALL)
+
+//port functions of a call record (index in the function table of the port driver, cf. PortFunctions).
+//arguments (arg[0], arg[1]), value returned by reference (out) and data of the call record
+#define MXVCP_CALL_SET_COMM_STATE     (0)   //arg: ActionMask. data: DCB
+#define MXVCP_CALL_GET_COMM_STATE     (1)
+#define MXVCP_CALL_SETUP              (2)   //arg: cbRxQueue, cbTxQueue
+#define MXVCP_CALL_TRANSMIT_CHAR      (3)   //arg: ch
+#define MXVCP_CALL_CLOSE              (4)
+#define MXVCP_CALL_GET_QUEUE_STATUS   (5)   //out: cbInque
+#define MXVCP_CALL_CLEAR_ERROR        (6)   //out: errors (CE_xxx)
+#define MXVCP_CALL_SET_MODEM_STATUS_SHADOW (7) //arg: dwEventMask
+#define MXVCP_CALL_GET_PROPERTIES     (8)
+#define MXVCP_CALL_ESCAPE_FUNCTION    (9)   //arg: lFunc, InData
+#define MXVCP_CALL_PURGE              (10)  //arg: dwQueueType
+#define MXVCP_CALL_SET_EVENT_MASK     (11)  //arg: dwMask. out: events
+#define MXVCP_CALL_GET_EVENT_MASK     (12)  //arg: dwMask. out: events
+#define MXVCP_CALL_WRITE              (13)  //arg: cchRequested. out: number of written bytes. data: written data
+#define MXVCP_CALL_READ               (14)  //arg: cchRequested. out: number of read bytes. data: read data
+#define MXVCP_CALL_ENABLE_NOTIFICATION (15) //arg: 1 if a callback is set, 0 if removed
+#define MXVCP_CALL_SET_READ_CALLBACK  (16)  //arg: rxTrigger, 1 if a callback is set
+#define MXVCP_CALL_SET_WRITE_CALLBACK (17)  //arg: txTrigger, 1 if a callback is set
+#define MXVCP_CALL_GET_MODEM_STATUS   (18)  //out: modem status (MS_xxx)
+#define MXVCP_CALL_GET_COMM_CONFIG    (19)
+#define MXVCP_CALL_SET_COMM_CONFIG    (20)  //data: DCB
+#define MXVCP_CALL_GET_WIN32_ERROR    (21)  //out: error
+#define MXVCP_CALL_OPEN               (0x80) //PortOpen (not part of the table). arg: VM id. data: port name (zero padded)
+
+//flags of MXVCP_ESC_REPLAY_START
+#define MXVCP_REPLAY_FAST        (0x01)  //replay as fast as the fifo accepts (otherwise: original timing)
+#define MXVCP_REPLAY_B_TO_A      (0x02)  //replay records of direction B to A (otherwise: A to B)
+
+//private device io control codes (cf. DeviceIoControl on "\\\\.\\MXVCP")
+#define MXVCP_IOCTL_GET_BENCH_STATS (0x801) //in: port name, out: MxvcpBenchStats
+#define MXVCP_IOCTL_GET_FRAME_STATS (0x802) //in: port name, out: MxvcpFrameStats
+#define MXVCP_IOCTL_GET_SLAB_STATS  (0x803) //out: array of MxvcpSlabStats (one per size class)
+#define MXVCP_IOCTL_TRANSFER        (0x805) //in: array of MxvcpTransfer, out: array of MxvcpTransferResult (one per transfer)
+
+#define MXVCP_IOCTL_READY_SET       (0x806) //in: array of MxvcpReadyEntry (ports and events of interest), replaces the previous set
+#define MXVCP_IOCTL_READY_GET       (0x807) //out: array of MxvcpReadyEntry (ready ports). overlapped: waits for a ready port
+
+#define MXVCP_IOCTL_RING_MAP        (0x808) //in: port name, out: MxvcpRing * (rx fifo of the port, shared with the client)
+#define MXVCP_IOCTL_RING_SIGNAL     (0x809) //in: MxvcpRingSignal. the client has put data into resp. taken data from a shared ring
+
+//readiness of a port (cf. MxvcpReadyEntry)
+#define MXVCP_READY_RX           (0x01)  //rx fifo holds data
+#define MXVCP_READY_TX           (0x02)  //a write is accepted (at least partly)
+
+//operation of a transfer (cf. MxvcpTransfer)
+#define MXVCP_TRANSFER_READ      (0)     //read from the rx fifo of the port (like ReadFile)
+#define MXVCP_TRANSFER_WRITE     (1)     //write to the port (like WriteFile)
+#define MXVCP_PORTNAME_LENGTH    (16)
+
+//capture file
+#define MXVCP_CAPTURE_MAGIC      (0x5043584D) //"MXCP"
+#define MXVCP_CAPTURE_VERSION    (3)     //version 1: no call records. version 2: write calls with the requested data, in one record
+#define MXVCP_RECORD_CHUNK       (4096)  //max. number of data bytes of a record (since version 3). more data is split
+
+
+/* -- Types --------------------------------------------------------------- */
+
+/*----------------------------------------------------------------------------
+   Header of a traffic record. Each chunk of data, transfered from one port to
+   its pair port, is reported as a record. The header is directly followed by
+   "length" bytes of data.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpRecordHeader
+{
+   DWORD time;       //time in milli seconds, since windows was started (cf. Get_System_Time)
+   BYTE  port;       //index of the port, that has written the data
+   BYTE  direction;  //MXVCP_DIR_A_TO_B or MXVCP_DIR_B_TO_A
+   WORD  length;     //number of data bytes following the header
+} MxvcpRecordHeader;
+
+
+/*----------------------------------------------------------------------------
+   Header of a capture file. It is followed by the captured traffic records
+   (MxvcpRecordHeader + data each).
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpCaptureHeader
+{
+   DWORD magic;      //MXVCP_CAPTURE_MAGIC
+   DWORD version;    //MXVCP_CAPTURE_VERSION
+} MxvcpCaptureHeader;
+
+
+/*----------------------------------------------------------------------------
+   Record of a port function call (direction MXVCP_DIR_CALL, cf. MXVCP_CAPTURE_CALLS).
+   It follows the record header and is followed by the data of the call (see MXVCP_CALL_xxx).
+   Data of more than MXVCP_RECORD_CHUNK bytes is continued in the next records of the
+   port, with direction MXVCP_DIR_CALL_DATA (without MxvcpCallRecord).
+   The time of the record header is taken, when the function returns. A replay of the
+   calls drives the same sequence into the port functions; the recorded results allow
+   to compare the behavior.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpCallRecord
+{
+   DWORD function;         //MXVCP_CALL_xxx
+   DWORD arg[2];           //arguments
+   DWORD out;              //value returned by reference
+   DWORD result;           //return value (TRUE or FALSE)
+   DWORD error;            //last error of the port (IE_xxx), after the call
+} MxvcpCallRecord;
+
+
+/*----------------------------------------------------------------------------
+   Statistics of a synthetic port (port type "Source" or "Sink"), since it was opened.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpBenchStats
+{
+   DWORD bytes;            //number of bytes produced (source) or consumed (sink)
+   DWORD time;             //time in milli seconds, since the port was opened
+   DWORD checksum;         //CRC-32 of all consumed bytes (sink only)
+   DWORD sequenceErrors;   //number of bytes not matching the expected pattern (sink only)
+} MxvcpBenchStats;
+
+
+/*----------------------------------------------------------------------------
+   Statistics of the framing stage of a port (registry value "Framing"), since it was opened.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpFrameStats
+{
+   DWORD frames;           //number of received frames (including the corrupt ones)
+   DWORD corruptFrames;    //number of frames with bad checksum, invalid escape sequence or too short
+} MxvcpFrameStats;
+
+
+/*----------------------------------------------------------------------------
+   Usage of a size class of the drivers object allocator (slab).
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpSlabStats
+{
+   DWORD size;             //size of an object
+   DWORD total;            //number of objects
+   DWORD used;             //number of allocated objects
+   DWORD peak;             //max. number of allocated objects, since the driver was loaded
+   DWORD failures;         //number of allocations failed, as all objects (also of the larger classes) were in use
+} MxvcpSlabStats;
+
+
+/*----------------------------------------------------------------------------
+   A read or write operation on an open port, as part of a batch (cf. MXVCP_IOCTL_TRANSFER).
+   The operations of a batch are executed in order. A failed operation doesn't stop the
+   batch. Reads never wait for data. Only the ports, the calling process has opened, can be
+   accessed (IE_NOPEN otherwise). The buffer must be committed memory of the process
+   (IE_DEFAULT otherwise).
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpTransfer
+{
+   char  portName[MXVCP_PORTNAME_LENGTH]; //e.g. "COM3"
+   DWORD operation;        //MXVCP_TRANSFER_READ or MXVCP_TRANSFER_WRITE
+   void * buffer;          //data to write resp. buffer for the read data
+   DWORD length;           //number of bytes to write resp. size of the buffer
+} MxvcpTransfer;
+
+
+/*----------------------------------------------------------------------------
+   Result of a transfer (cf. MXVCP_IOCTL_TRANSFER).
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpTransferResult
+{
+   DWORD count;            //number of bytes read resp. written
+   long  error;            //0 if successful, otherwise IE_xxx (e.g. IE_NOPEN, if the port is not open)
+} MxvcpTransferResult;
+
+
+/*----------------------------------------------------------------------------
+   Port of a readiness set (cf. MXVCP_IOCTL_READY_SET and MXVCP_IOCTL_READY_GET). Each
+   handle of the driver has its own set.
+
+   MXVCP_IOCTL_READY_GET returns the ports, that are ready. If none is ready and the call
+   is overlapped, it is completed (without data) as soon as a port of the set gets ready.
+   The ports are then retrieved by another call.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpReadyEntry
+{
+   char  portName[MXVCP_PORTNAME_LENGTH]; //e.g. "COM3"
+   DWORD events;           //MXVCP_READY_xxx: events of interest (set) resp. ready events (get)
+} MxvcpReadyEntry;
+
+
+/*----------------------------------------------------------------------------
+   Header of the rx fifo of a port, shared with the Win32 process, that opened the port
+   (cf. MXVCP_IOCTL_RING_MAP). The header and the data (it follows the header, cf.
+   MXVCP_RING_DATA) are located in the shared arena. They stay valid, until the port is closed.
+
+   The driver keeps the indices of the fifo in its own memory and publishes them here. The
+   client only reads the header. It consumes the rx fifo of its own port: it copies up to
+   "count" bytes from "get" on (wrapping around at "size"). It produces into the rx fifo of the
+   pair port (if it opened the pair port too): it copies up to "size" - "count" bytes to "put" on.
+   Meanwhile it must not call ReadFile resp. WriteFile on the port. Afterwards, it calls
+   MXVCP_IOCTL_RING_SIGNAL with the number of bytes consumed resp. produced. The driver checks
+   them against its indices, advances them and publishes them. Produced data is handled, as
+   written by the pair port: it is transformed to the line format of the port, the events are
+   issued and it is mirrored to the monitor port and the capture file.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpRing
+{
+   DWORD size;             //size of the ring buffer
+   volatile DWORD count;   //number of bytes in the ring buffer
+   volatile DWORD get;     //offset of the next byte to consume
+   volatile DWORD put;     //offset of the next byte to produce
+} MxvcpRing;
+
+#define MXVCP_RING_DATA(ring)    ((BYTE *)((ring) + 1))  //ring buffer of a shared ring
+
+
+/*----------------------------------------------------------------------------
+   Notification of the driver, after the client has accessed a shared ring (cf. MxvcpRing).
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpRingSignal
+{
+   char  portName[MXVCP_PORTNAME_LENGTH]; //port, that owns the ring (i.e. whose rx fifo it is)
+   DWORD produced;         //number of bytes, the client has put into the ring (rx events of the port)
+   DWORD consumed;         //number of bytes, the client has taken from the ring (tx events of the pair port)
+} MxvcpRingSignal;
+
+
+/*----------------------------------------------------------------------------
+   Contiguous region of a fifo buffer (cf. MxvcpSpanApi).
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpSpan
+{
+   BYTE * data;            //first byte of the region
+   DWORD length;           //number of bytes (0: the span is empty)
+} MxvcpSpan;
+
+
+/*----------------------------------------------------------------------------
+   Zero copy access to the fifos of an open port, for other VxDs (cf. MXVCP_ESC_GET_SPAN_API,
+   issued by _VCOMM_EscapeCommFunction). The functions are called with "port" as first
+   argument. They are callable at interrupt time.
+
+   Reading: peek returns the readable data of the rx fifo of the port as (at most) two spans
+   (the second one after wrap around). The client parses the data in place and calls commit
+   with the number of consumed bytes (which may be less than peeked).
+
+   Writing: reserve returns free space in the rx fifo of the pair port as (at most) two spans.
+   The client fills the space in place and calls publish with the number of filled bytes (at
+   most the reserved number). Nothing is reserved, if the pair port is closed, data must pass
+   through the impairment stage or the space is reserved already. Then the client writes by
+   _VCOMM_WriteComm. Until publish, all other writes into the fifo are refused (they find the
+   fifo full).
+
+   The fifo buffer stays in place from peek to commit resp. from reserve to publish. Meanwhile,
+   the client must not read resp. write the port by other means.
+----------------------------------------------------------------------------*/
+typedef struct _MxvcpSpanApi
+{
+   void * port;                                                   //context of the port
+   DWORD (_cdecl * peek)(void * port, MxvcpSpan * span);          //span[2]: readable data. returns total size
+   void  (_cdecl * commit)(void * port, DWORD count);             //count bytes are consumed
+   DWORD (_cdecl * reserve)(void * port, DWORD count, MxvcpSpan * span); //span[2]: space for up to count bytes. returns total size
+   void  (_cdecl * publish)(void * port, DWORD count);            //count bytes are filled
+} MxvcpSpanApi;
+
+
+/* -- Global Variables ---------------------------------------------------- */
+
+/* -- Function Prototypes ------------------------------------------------- */
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
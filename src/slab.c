@@ -0,0 +1,311 @@
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+#include "vmm.h"
+#include "wrapper.h"
+#include "slab.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#ifndef SLAB_BLOCKS
+#define SLAB_BLOCKS     (16)  //max. number of memory blocks of a size class
+#endif
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//a free object. the link is stored within the object itself
+typedef struct _SlabObject
+{
+   struct _SlabObject * next;
+} SlabObject;
+
+
+//a size class. its objects are within (up to SLAB_BLOCKS) contiguous blocks of memory
+typedef struct _SlabClass
+{
+   DWORD size;             //size of an object (multiple of 4)
+   DWORD count;            //number of objects of a block
+   DWORD reserve;          //number of blocks, allocated when the driver is loaded (never trimmed)
+   DWORD blocks;           //number of allocated blocks
+   BYTE * block[SLAB_BLOCKS]; //memory blocks of the objects
+   SlabObject * free;      //list of free objects
+   DWORD used;             //number of allocated objects
+   DWORD peak;             //max. number of allocated objects
+   DWORD failures;         //number of failed allocations
+} SlabClass;
+
+
+/* -- Module Global Function Prototypes ----------------------------------- */
+
+
+/* -- Module Global Variables --------------------------------------------- */
+//size classes, ordered by size. the reserve is what the driver needs without any port open
+static SlabClass m_SlabClass[SLAB_CLASSES] =
+{
+   {   64, 16, 1 },   //small objects, like queued records
+   {  512,  4, 1 },   //rx fifos
+   { 2048,  2, 0 },   //grown rx fifos
+   { 8192,  1, 0 },   //large rx fifos, delay lines of impairment stages
+};
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//add a block of memory to a size class. return FALSE if there is no memory. must not be called at interrupt time.
+static BOOL m_SlabGrow(SlabClass * slab)
+{
+   BYTE * memory;
+   DWORD i;
+
+   if (slab->blocks >= SLAB_BLOCKS)
+   {
+      return 0;
+   }
+   memory = Heap_Allocate(slab->size * slab->count, 0);
+   if (memory == NULL)
+   {
+      return 0;
+   }
+   //link all objects into the free list (in order of their addresses)
+   ENTER_CRITICAL();
+   for (i = slab->count; i > 0; --i)
+   {
+      SlabObject * const object = (SlabObject *)(memory + (i - 1) * slab->size);
+      object->next = slab->free;
+      slab->free = object;
+   }
+   slab->block[slab->blocks++] = memory;
+   LEAVE_CRITICAL();
+   return 1;
+}
+
+
+//take an object from the smallest size class, the size fits in and that has a free object.
+//fitting returns the smallest class, the size fits in (NULL if none). callable at interrupt time.
+static void * m_SlabTake(DWORD size, SlabClass ** fitting)
+{
+   SlabObject * object = NULL;
+   unsigned int c;
+
+   *fitting = NULL;
+   ENTER_CRITICAL();
+   for (c = 0; c < SLAB_CLASSES; ++c)
+   {
+      SlabClass * const slab = &m_SlabClass[c];
+      if (size > slab->size)
+      {
+         continue;
+      }
+      if (*fitting == NULL)
+      {
+         *fitting = slab;
+      }
+      object = slab->free;
+      if (object)
+      {
+         slab->free = object->next;
+         if (++slab->used > slab->peak)
+         {
+            slab->peak = slab->used;
+         }
+         break;
+      }
+   }
+   LEAVE_CRITICAL();
+   return object;
+}
+
+
+//remove all objects of a block from the free list, if none of them is allocated.
+//return FALSE if the block is in use. must be called within a critical section.
+static BOOL m_SlabUnlink(SlabClass * slab, BYTE * memory)
+{
+   BYTE * const end = memory + slab->size * slab->count;
+   SlabObject ** link;
+   DWORD freeObjects = 0;
+
+   for (link = &slab->free; *link; link = &(*link)->next)
+   {
+      freeObjects += (((BYTE *)*link >= memory) && ((BYTE *)*link < end));
+   }
+   if (freeObjects < slab->count)
+   {
+      return 0;
+   }
+   link = &slab->free;
+   while (*link)
+   {
+      if (((BYTE *)*link >= memory) && ((BYTE *)*link < end))
+      {
+         *link = (*link)->next;
+      }
+      else
+      {
+         link = &(*link)->next;
+      }
+   }
+   return 1;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Allocate the reserve of all size classes. Must not be called at interrupt time.
+
+   \retval  TRUE     if successful
+   \retval  FALSE    if (some of) the memory couldn't be allocated
+----------------------------------------------------------------------------*/
+BOOL slab_init(void)
+{
+   BOOL status = 1;
+   unsigned int c;
+
+   for (c = 0; c < SLAB_CLASSES; ++c)
+   {
+      SlabClass * const slab = &m_SlabClass[c];
+      slab->blocks = 0;
+      slab->free = NULL;
+      slab->used = 0;
+      slab->peak = 0;
+      slab->failures = 0;
+      while (slab->blocks < slab->reserve)
+      {
+         if (!m_SlabGrow(slab))
+         {
+            status = 0;
+            break;
+         }
+      }
+   }
+   return status;
+}
+
+
+
+//free the memory of all size classes. all objects must be freed before. must not be called at interrupt time.
+void slab_exit(void)
+{
+   unsigned int c;
+   for (c = 0; c < SLAB_CLASSES; ++c)
+   {
+      SlabClass * const slab = &m_SlabClass[c];
+      while (slab->blocks)
+      {
+         Heap_Free(slab->block[--slab->blocks], 0);
+      }
+      slab->free = NULL;
+   }
+}
+
+
+
+//allocate an object of (at least) size bytes. if the fitting size class is exhausted, the object is taken
+//from the next larger one. return NULL if none is available. callable at interrupt time.
+void * slab_alloc(DWORD size)
+{
+   SlabClass * fitting;
+   void * const object = m_SlabTake(size, &fitting);
+   if ((object == NULL) && fitting)
+   {
+      fitting->failures++; //all classes, the size fits in, are exhausted
+   }
+   return object;
+}
+
+
+
+//allocate an object like slab_alloc. if all classes, the size fits in, are exhausted, the fitting one is
+//grown by a block from the heap. must not be called at interrupt time.
+void * slab_alloc_grow(DWORD size)
+{
+   SlabClass * fitting;
+   void * object = m_SlabTake(size, &fitting);
+   if ((object == NULL) && fitting)
+   {
+      if (m_SlabGrow(fitting))
+      {
+         object = m_SlabTake(size, &fitting);
+      }
+      else
+      {
+         fitting->failures++;
+      }
+   }
+   return object;
+}
+
+
+
+//free an object, allocated by slab_alloc. callable at interrupt time.
+void slab_free(void * object)
+{
+   unsigned int c;
+   DWORD b;
+
+   for (c = 0; c < SLAB_CLASSES; ++c)
+   {
+      SlabClass * const slab = &m_SlabClass[c];
+      //the size class is given by the memory block, the object is located in
+      for (b = 0; b < slab->blocks; ++b)
+      {
+         if (((BYTE *)object >= slab->block[b]) && ((BYTE *)object < (slab->block[b] + slab->size * slab->count)))
+         {
+            ENTER_CRITICAL();
+            ((SlabObject *)object)->next = slab->free;
+            slab->free = (SlabObject *)object;
+            slab->used--;
+            LEAVE_CRITICAL();
+            return;
+         }
+      }
+   }
+}
+
+
+
+//return the blocks, whose objects are all free, to the heap (except the reserve). must not be called at interrupt time.
+void slab_trim(void)
+{
+   unsigned int c;
+   DWORD b;
+
+   for (c = 0; c < SLAB_CLASSES; ++c)
+   {
+      SlabClass * const slab = &m_SlabClass[c];
+      for (b = slab->blocks; b > slab->reserve; --b)
+      {
+         BYTE * const memory = slab->block[b - 1];
+         BOOL unused;
+         ENTER_CRITICAL();
+         unused = m_SlabUnlink(slab, memory);
+         if (unused)
+         {
+            slab->block[b - 1] = slab->block[--slab->blocks]; //(that block was checked already)
+         }
+         LEAVE_CRITICAL();
+         if (unused)
+         {
+            Heap_Free(memory, 0);
+         }
+      }
+   }
+}
+
+
+
+//get usage statistics of a size class. return FALSE, if there is no such class
+BOOL slab_stats(unsigned int sizeClass, SlabStats * stats)
+{
+   SlabClass * slab;
+
+   if (sizeClass >= SLAB_CLASSES)
+   {
+      return 0;
+   }
+   slab = &m_SlabClass[sizeClass];
+   stats->size = slab->size;
+   stats->total = slab->blocks * slab->count;
+   stats->used = slab->used;
+   stats->peak = slab->peak;
+   stats->failures = slab->failures;
+   return 1;
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Slab allocator for fixed size objects.
+
+   When the driver is loaded, only a small reserve is allocated (from the locked
+   heap). A size class grows by a block of memory on demand, if an object is
+   allocated at task time (slab_alloc_grow), and returns its unused blocks to the
+   heap on slab_trim. Objects are allocated and freed in constant time, also at
+   interrupt time (slab_alloc, without growth). An object is taken from the
+   smallest size class, the requested size fits in.
+*/
+//-----------------------------------------------------------------------------
+#ifndef SLAB_H_
+#define SLAB_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#define SLAB_CLASSES    (4)   //number of size classes
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//usage statistics of a size class
+typedef struct _SlabStats
+{
+   DWORD size;       //size of an object
+   DWORD total;      //number of objects
+   DWORD used;       //number of allocated objects
+   DWORD peak;       //max. number of allocated objects
+   DWORD failures;   //number of allocations failed, as all objects (also of the larger classes) were in use
+} SlabStats;
+
+
+/* -- Global Variables ---------------------------------------------------- */
+
+/* -- Function Prototypes ------------------------------------------------- */
+BOOL slab_init(void);
+void slab_exit(void);
+void * slab_alloc(DWORD size);
+void * slab_alloc_grow(DWORD size);
+void slab_free(void * object);
+void slab_trim(void);
+BOOL slab_stats(unsigned int sizeClass, SlabStats * stats);
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
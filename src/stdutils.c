@@ -4,6 +4,8 @@
 
 
 /* -- Defines ------------------------------------------------------------- */
+#define WORD_ALIGNED(p)    ((((unsigned long)(p)) & 3) == 0)
+#define HAS_ZERO_BYTE(x)   ((((x) - 0x01010101) & ~(x) & 0x80808080) != 0) //any byte of the DWORD x is zero
 
 
 /* -- Types --------------------------------------------------------------- */
@@ -13,14 +15,29 @@
 
 
 /* -- Module Global Variables --------------------------------------------- */
+//the decimal digits of 0..99, as pairs of chars
+static const char m_DigitPairs[] =
+   "00010203040506070809"
+   "10111213141516171819"
+   "20212223242526272829"
+   "30313233343536373839"
+   "40414243444546474849"
+   "50515253545556575859"
+   "60616263646566676869"
+   "70717273747576777879"
+   "80818283848586878889"
+   "90919293949596979899";
 
 
 /* -- Implementation ------------------------------------------------------ */
 
-unsigned int stdutils_uitoa(char * destination, unsigned long value, unsigned int num)
+//convert value to a decimal string. if the buffer is too small, the lower digits are kept.
+//return length (without zero termination)
+unsigned int stdutils_uitoa(char * destination, DWORD value, unsigned int num)
 {
-   char * start = destination;
-   unsigned long len = 0;
+   char digits[10]; //max. number of digits of a 32-bit value
+   char * digit = &digits[sizeof(digits)];
+   unsigned int len;
 
    //there must be buffer!
    if ((destination == 0) || (num == 0))
@@ -28,35 +45,38 @@ unsigned int stdutils_uitoa(char * destination, unsigned long value, unsigned in
       return 0;
    }
 
-
-   //unsigned-integer to ascii string
-   do
+   //unsigned-integer to ascii string, from right to left. two digits at a time
+   while (value >= 100)
    {
-      //check if still enough buffer is left
-      if (num <= 1)
-      {
-         break;
-      }
-
-      //to ascii
-      *destination++ = (char)('0' + (value % 10));
-      value = value / 10;
-      --num;
-      ++len;
-   } while (value != 0);
-   //add zero termination
-   *destination = 0;
-
-   //swap-byte order
-   --destination;
-   while (start < destination)
+      unsigned int const pair = (unsigned int)(value % 100) * 2;
+      value /= 100;
+      *--digit = m_DigitPairs[pair + 1];
+      *--digit = m_DigitPairs[pair];
+   }
+   if (value >= 10)
    {
-      char tmp = *start;
-      *start++ = *destination;
-      *destination-- = tmp;
+      *--digit = m_DigitPairs[value * 2 + 1];
+      *--digit = m_DigitPairs[value * 2];
    }
+   else
+   {
+      *--digit = (char)('0' + value);
+   }
+   len = (unsigned int)(&digits[sizeof(digits)] - digit);
 
-   //return length (without zero termination)
+   //check if enough buffer is left
+   if (len > (num - 1))
+   {
+      digit += len - (num - 1);
+      len = num - 1;
+   }
+   //at most 10 chars: a plain copy is cheaper than the word kernel's alignment checks
+   for (num = 0; num < len; ++num)
+   {
+      destination[num] = digit[num];
+   }
+   //add zero termination
+   destination[len] = 0;
    return len;
 }
 
@@ -64,7 +84,7 @@ unsigned int stdutils_uitoa(char * destination, unsigned long value, unsigned in
 
 unsigned int stdutils_strncpy(char * destination, const char * source, unsigned int num)
 {
-   unsigned long len = 0;
+   unsigned int len = 0;
    char c;
 
    //there must be buffer!
@@ -116,11 +136,31 @@ int stdutils_strncmp(const char * str1, const char * str2, unsigned int num)
       return 0;
    }
 
-   //for each char
+   //word by word, while both strings are aligned and the words are equal and not terminated
+   if (WORD_ALIGNED(str1) && WORD_ALIGNED(str2))
+   {
+      while (num >= 4)
+      {
+         DWORD const w = *(const DWORD *)str1;
+         if ((w != *(const DWORD *)str2) || HAS_ZERO_BYTE(w))
+         {
+            break; //the difference resp. termination is within this word
+         }
+         str1 += 4;
+         str2 += 4;
+         num -= 4;
+      }
+      if (num == 0)
+      {
+         return 0;
+      }
+   }
+
+   //for each (remaining) char
    do
    {
-      c1 = *str1++;
-      c2 = *str2++;
+      c1 = *(const unsigned char *)str1++; //like the C library, chars compare as unsigned
+      c2 = *(const unsigned char *)str2++;
       if (c1 != c2) //in case of in-equality
       {
          break;
@@ -132,11 +172,168 @@ int stdutils_strncmp(const char * str1, const char * str2, unsigned int num)
 
 
 
+//set num bytes of memory to zero. a 32-bit word at a time.
 void stdutils_memclr(void * memory, unsigned int num)
 {
+#ifdef VXD
+   _asm mov   edi, memory
+   _asm mov   edx, num
+   _asm xor   eax, eax
+   _asm mov   ecx, edx
+   _asm shr   ecx, 2
+   _asm cld
+   _asm rep   stosd
+   _asm mov   ecx, edx
+   _asm and   ecx, 3
+   _asm rep   stosb
+#else
    unsigned char * mem = memory;
+   //byte by byte, until address is aligned
+   while (num && !WORD_ALIGNED(mem))
+   {
+      *mem++ = 0;
+      --num;
+   }
+   //word by word
+   while (num >= 4)
+   {
+      *(DWORD *)mem = 0;
+      mem += 4;
+      num -= 4;
+   }
+   //remaining bytes
    while (num--)
    {
       *mem++ = 0;
    }
+#endif
+}
+
+
+
+//copy num bytes from source to destination. the memory areas must not overlap (cf. stdutils_memmove).
+//a 32-bit word at a time.
+void stdutils_memcpy(void * destination, const void * source, unsigned int num)
+{
+#ifdef VXD
+   _asm mov   esi, source
+   _asm mov   edi, destination
+   _asm mov   edx, num
+   _asm mov   ecx, edx
+   _asm shr   ecx, 2
+   _asm cld
+   _asm rep   movsd
+   _asm mov   ecx, edx
+   _asm and   ecx, 3
+   _asm rep   movsb
+#else
+   unsigned char * dest = destination;
+   const unsigned char * src = source;
+   //word by word, if both addresses can be aligned
+   if (((unsigned long)dest & 3) == ((unsigned long)src & 3))
+   {
+      while (num && !WORD_ALIGNED(dest))
+      {
+         *dest++ = *src++;
+         --num;
+      }
+      while (num >= 4)
+      {
+         *(DWORD *)dest = *(const DWORD *)src;
+         dest += 4;
+         src += 4;
+         num -= 4;
+      }
+   }
+   //remaining bytes
+   while (num--)
+   {
+      *dest++ = *src++;
+   }
+#endif
+}
+
+
+
+//copy num bytes from source to destination. the memory areas may overlap.
+void stdutils_memmove(void * destination, const void * source, unsigned int num)
+{
+   unsigned char * dest = destination;
+   const unsigned char * src = source;
+
+   if ((dest <= src) || (dest >= (src + num)))
+   {
+      //copying forwards doesn't overwrite any source byte, before it is copied
+      stdutils_memcpy(destination, source, num);
+      return;
+   }
+   //copy backwards
+   dest += num;
+   src += num;
+   if (((unsigned long)dest & 3) == ((unsigned long)src & 3))
+   {
+      while (num && !WORD_ALIGNED(dest))
+      {
+         *--dest = *--src;
+         --num;
+      }
+      while (num >= 4)
+      {
+         dest -= 4;
+         src -= 4;
+         *(DWORD *)dest = *(const DWORD *)src;
+         num -= 4;
+      }
+   }
+   while (num--)
+   {
+      *--dest = *--src;
+   }
+}
+
+
+
+//find first occurence of value in memory. return its address (or 0 if not found).
+//scans a 32-bit word at a time, as far as memory is aligned.
+void * stdutils_memchr(const void * memory, int value, unsigned int num)
+{
+   const unsigned char * mem = memory;
+   unsigned char const c = (unsigned char)value;
+   DWORD pattern;
+
+   //byte by byte, until address is aligned
+   while (num && !WORD_ALIGNED(mem))
+   {
+      if (*mem == c)
+      {
+         return (void *)mem;
+      }
+      ++mem;
+      --num;
+   }
+
+   //word by word. a byte of (word ^ pattern) is zero, at the position of the char.
+   pattern = c * 0x01010101;
+   while (num >= 4)
+   {
+      DWORD const x = *(const DWORD *)mem ^ pattern;
+      if (HAS_ZERO_BYTE(x))
+      {
+         break; //char is within this word
+      }
+      mem += 4;
+      num -= 4;
+   }
+
+   //remaining bytes
+   while (num)
+   {
+      if (*mem == c)
+      {
+         return (void *)mem;
+      }
+      ++mem;
+      --num;
+   }
+   return 0;
 }
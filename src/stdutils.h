@@ -23,10 +23,13 @@ extern "C" {
 /* -- Global Variables ---------------------------------------------------- */
 
 /* -- Function Prototypes ------------------------------------------------- */
-unsigned int stdutils_uitoa(char * destination, unsigned long value, unsigned int num);
+unsigned int stdutils_uitoa(char * destination, DWORD value, unsigned int num);
 unsigned int stdutils_strncpy(char * destination, const char * source, unsigned int num);
 int stdutils_strncmp(const char * str1, const char * str2, unsigned int num);
 void stdutils_memclr(void * memory, unsigned int num);
+void stdutils_memcpy(void * destination, const void * source, unsigned int num);
+void stdutils_memmove(void * destination, const void * source, unsigned int num);
+void * stdutils_memchr(const void * memory, int value, unsigned int num);
 
 
 /* -- Implementation ------------------------------------------------------ */
@@ -0,0 +1,219 @@
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+#include "vmm.h"
+#include "wrapper.h"
+#include "wheel.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+
+
+/* -- Types --------------------------------------------------------------- */
+
+/*----------------------------------------------------------------------------
+   The timer wheel. A slot of level n holds the timers, that expire within its
+   WHEEL_SLOTS^n ms. When level 0 wraps around, the next slot of level 1 is
+   cascaded into level 0 (and so on).
+----------------------------------------------------------------------------*/
+typedef struct _TimerWheel
+{
+   WheelLink slot[WHEEL_LEVELS][WHEEL_SLOTS]; //list heads (circular)
+   DWORD time;                //next time [ms] to process
+   DWORD count;               //number of armed timers
+   DWORD timeOut;             //handle of the time-out, that drives the wheel (0 if none)
+} TimerWheel;
+
+
+/* -- Module Global Function Prototypes ----------------------------------- */
+static void _cdecl m_WheelTimeout(DWORD refData);
+
+
+/* -- Module Global Variables --------------------------------------------- */
+static TimerWheel m_Wheel;
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//time-out callback (register based). the reference data is passed in edx
+REGISTER_CALLBACK(m_WheelTimeoutCallback, m_WheelTimeout)
+
+
+//initialize the (empty) timer wheel. must be called once, before a timer is armed
+void wheel_init(void)
+{
+   unsigned int l;
+   unsigned int i;
+
+   for (l = 0; l < WHEEL_LEVELS; ++l)
+   {
+      for (i = 0; i < WHEEL_SLOTS; ++i)
+      {
+         m_Wheel.slot[l][i].next = &m_Wheel.slot[l][i];
+         m_Wheel.slot[l][i].prev = &m_Wheel.slot[l][i];
+      }
+   }
+   m_Wheel.count = 0;
+   m_Wheel.timeOut = 0;
+}
+
+
+//link a timer into the slot of its due time. the caller must hold the critical section
+static void m_WheelInsert(WheelTimer * timer)
+{
+   DWORD const max = (1 << (WHEEL_LEVELS*WHEEL_BITS)) - 1;
+   DWORD delta = timer->due - m_Wheel.time;
+   WheelLink * head;
+   unsigned int l = 0;
+
+   if ((LONG)delta < 0)
+   {
+      timer->due = m_Wheel.time; //overdue: expires with the next processed slot
+      delta = 0;
+   }
+   if (delta > max)
+   {
+      timer->due = m_Wheel.time + max;
+      delta = max;
+   }
+   while (delta >= (DWORD)(1 << ((l + 1)*WHEEL_BITS)))
+   {
+      ++l;
+   }
+   head = &m_Wheel.slot[l][(timer->due >> (l*WHEEL_BITS)) & (WHEEL_SLOTS - 1)];
+   timer->link.next = head;
+   timer->link.prev = head->prev;
+   head->prev->next = &timer->link;
+   head->prev = &timer->link;
+}
+
+
+//unlink a timer from its slot. the caller must hold the critical section
+static __inline void m_WheelUnlink(WheelTimer * timer)
+{
+   timer->link.prev->next = timer->link.next;
+   timer->link.next->prev = timer->link.prev;
+   timer->link.next = NULL;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Arm a timer of the timer wheel. An armed timer is re-armed.
+
+   Takes constant time, independent of the number of armed timers. Callable at
+   interrupt time. The callback is called at interrupt time (cf. wheel.h).
+
+   \param   timer       timer (zero initialized, before it is armed the first time)
+   \param   due         system time [ms], the timer shall expire
+   \param   callback    function, called when the timer expires
+   \param   refData     reference data, passed to the callback
+----------------------------------------------------------------------------*/
+void wheel_arm(WheelTimer * timer, DWORD due, void (* callback)(DWORD refData), DWORD refData)
+{
+   ENTER_CRITICAL();
+   if (timer->link.next)
+   {
+      m_WheelUnlink(timer);
+      m_Wheel.count--;
+   }
+   if (m_Wheel.count == 0)
+   {
+      m_Wheel.time = System_GetTime(); //the empty wheel starts at the current time
+   }
+   timer->due = due;
+   timer->callback = callback;
+   timer->refData = refData;
+   m_WheelInsert(timer);
+   m_Wheel.count++;
+   if (m_Wheel.timeOut == 0)
+   {
+      m_Wheel.timeOut = Timer_SetGlobalTimeOut(WHEEL_PERIOD, 0, m_WheelTimeoutCallback);
+   }
+   LEAVE_CRITICAL();
+}
+
+
+//cancel a timer of the timer wheel (if armed). callable at interrupt time
+void wheel_cancel(WheelTimer * timer)
+{
+   ENTER_CRITICAL();
+   if (timer->link.next)
+   {
+      m_WheelUnlink(timer);
+      m_Wheel.count--;
+   }
+   LEAVE_CRITICAL();
+}
+
+
+//move the timers of a slot into the lower levels. the caller must hold the critical section
+static void m_WheelCascade(WheelLink * head)
+{
+   while (head->next != head)
+   {
+      WheelTimer * const timer = (WheelTimer *)head->next;
+      m_WheelUnlink(timer);
+      m_WheelInsert(timer);
+   }
+}
+
+
+//periodic time-out of the timer wheel: expire all timers, that are due until now
+static void _cdecl m_WheelTimeout(DWORD refData)
+{
+   DWORD const now = System_GetTime();
+   WheelLink expired;
+   unsigned int l;
+
+   ENTER_CRITICAL();
+   m_Wheel.timeOut = 0;
+   while (m_Wheel.count && ((LONG)(now - m_Wheel.time) >= 0))
+   {
+      WheelLink * const head = &m_Wheel.slot[0][m_Wheel.time & (WHEEL_SLOTS - 1)];
+      //on wrap around of a level, cascade the next slot of the level above
+      for (l = 1; l < WHEEL_LEVELS; ++l)
+      {
+         if ((m_Wheel.time & ((1 << (l*WHEEL_BITS)) - 1)) != 0)
+         {
+            break;
+         }
+         m_WheelCascade(&m_Wheel.slot[l][(m_Wheel.time >> (l*WHEEL_BITS)) & (WHEEL_SLOTS - 1)]);
+      }
+      m_Wheel.time++;
+      if (head->next == head)
+      {
+         continue;
+      }
+      //take over the due timers, as their callbacks may arm or cancel timers
+      expired.next = head->next;
+      expired.prev = head->prev;
+      expired.next->prev = &expired;
+      expired.prev->next = &expired;
+      head->next = head;
+      head->prev = head;
+      while (expired.next != &expired)
+      {
+         WheelTimer * const timer = (WheelTimer *)expired.next;
+         m_WheelUnlink(timer);
+         m_Wheel.count--;
+         LEAVE_CRITICAL();
+         timer->callback(timer->refData);
+         ENTER_CRITICAL();
+      }
+   }
+   if (m_Wheel.count && (m_Wheel.timeOut == 0))
+   {
+      m_Wheel.timeOut = Timer_SetGlobalTimeOut(WHEEL_PERIOD, 0, m_WheelTimeoutCallback);
+   }
+   LEAVE_CRITICAL();
+}
+
+
+//cancel the time-out, that drives the wheel (the driver is unloaded)
+void wheel_exit(void)
+{
+   if (m_Wheel.timeOut)
+   {
+      Timer_CancelTimeOut(m_Wheel.timeOut);
+      m_Wheel.timeOut = 0;
+   }
+}
@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Hierarchical timer wheel.
+
+   All timers of the driver are driven by one periodic time-out (every
+   WHEEL_PERIOD ms), which is only scheduled while a timer is armed. Arming and
+   cancelling take constant time, independent of the number of armed timers,
+   and are callable at interrupt time.
+
+   The callback of an expired timer is called from that time-out, i.e. at
+   interrupt time (but not within a critical section). So it may only use
+   services, that are callable at interrupt time: no heap, no IFSMgr, no
+   page locking. Work of that kind is deferred by a global event.
+*/
+//-----------------------------------------------------------------------------
+#ifndef WHEEL_H_
+#define WHEEL_H_
+
+/* -- Includes ------------------------------------------------------------ */
+#include "basedef.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* -- Defines ------------------------------------------------------------- */
+#define WHEEL_BITS      (6)
+#define WHEEL_SLOTS     (1 << WHEEL_BITS) //slots per level
+#define WHEEL_LEVELS    (3)         //level n has a resolution of WHEEL_SLOTS^n ms. max. period about 4 min.
+#define WHEEL_PERIOD    (5)         //period [ms] of the time-out, that drives the timer wheel
+
+
+/* -- Types --------------------------------------------------------------- */
+
+typedef struct _WheelLink
+{
+   struct _WheelLink * next;
+   struct _WheelLink * prev;
+} WheelLink;
+
+//timer of the wheel. it is embedded in the object, that uses it (zero initialized: not armed)
+typedef struct _WheelTimer
+{
+   WheelLink link;            //must be first: list of the slot (next is NULL, while the timer is not armed)
+   DWORD due;                 //time [ms], the timer expires
+   void (* callback)(DWORD refData);
+   DWORD refData;
+} WheelTimer;
+
+
+/* -- Global Variables ---------------------------------------------------- */
+
+/* -- Function Prototypes ------------------------------------------------- */
+void wheel_init(void);
+void wheel_exit(void);
+void wheel_arm(WheelTimer * timer, DWORD due, void (* callback)(DWORD refData), DWORD refData);
+void wheel_cancel(WheelTimer * timer);
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+//TRUE, while the timer is armed
+#define wheel_armed(timer)    ((timer)->link.next != NULL)
+
+
+
+#ifdef __cplusplus
+} /* end of extern "C" */
+#endif
+
+#endif
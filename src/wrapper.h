@@ -57,11 +57,17 @@
 #ifndef WRAPPER_H_
 #define WRAPPER_H_
 
+#ifdef MXVCP_HOST
+//host build: stand-ins of the VxD services (cf. host/hostwrap.h)
+#include "hostwrap.h"
+#else
+
 
 /* -- Includes ------------------------------------------------------------ */
 #include "basedef.h"
 #include "vmm.h"
 #include "shell.h"
+#include "vwin32.h"
 
 
 
@@ -73,9 +79,33 @@ extern "C" {
 #define JC_FORWARED(n);  _asm _emit 0x72 _asm _emit n
 #define JZ_FORWARED(n);  _asm _emit 0x74 _asm _emit n
 
+//disable interrupts resp. restore the previous interrupt state. must be used in pairs, within the same function
+#define ENTER_CRITICAL();  _asm pushfd _asm cli
+#define LEAVE_CRITICAL();  _asm popfd
+
+//private arena of the Win32 applications (cf. Page_LockUser)
+#define USER_ARENA_START   (0x00400000)
+#define USER_ARENA_END     (0x80000000)
+
+//set resp. clear the carry flag (result of a system control message, cf. MXVCP_DeviceInit)
+#define SET_CARRY();       _asm stc
+#define CLEAR_CARRY();     _asm clc
+
+//define the register based callback "name" (time-out, event), that passes the reference data in EDX
+//to the C function "void _cdecl handler(DWORD refData)"
+#define REGISTER_CALLBACK(name, handler) \
+   static void __declspec(naked) name(void) \
+   { \
+      _asm push edx \
+      _asm call handler \
+      _asm add esp, 4 \
+      _asm ret \
+   }
+
 
 /* -- Types --------------------------------------------------------------- */
 typedef DWORD   ULONG;
+typedef long    LONG;      //32 bits. e.g. difference of two system times
 
 /* -- Global Variables ---------------------------------------------------- */
 
@@ -291,6 +321,346 @@ VXDINLINE DWORD CONFIGMG_ReadRegistryValue(DWORD dnDevNode, char * pszSubKey, ch
 }
 
 
+VXDINLINE void Heap_Free(void * memory, DWORD flags)
+{
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VxDCall is using C calling connvention
+   _asm push flags
+   _asm push memory
+   VxDCall(_HeapFree);
+   _asm add esp, 2*4            //clean up stack
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Allocate locked, zero initialized pages in the system arena.
+
+   \param   pages    number of pages (4 KByte each)
+   \param   handle   receives the memory handle (needed to free the pages)
+
+   \return  linear address of the pages (NULL on error)
+----------------------------------------------------------------------------*/
+VXDINLINE void * Page_Allocate(DWORD pages, DWORD * handle)
+{
+   DWORD const type = PG_SYS;
+   DWORD const flags = PAGELOCKED | PAGEZEROINIT;
+   DWORD memory;
+   void * address;
+
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VMMCall is using C calling connvention
+   _asm push flags
+   _asm push 0                  //no physical address
+   _asm push 0                  //max. physical page
+   _asm push 0                  //min. physical page
+   _asm push 0                  //no alignment
+   _asm push 0                  //no VM (system arena)
+   _asm push type
+   _asm push pages
+   VMMCall(_PageAllocate);
+   _asm mov memory, eax
+   _asm mov address, edx
+   _asm add esp, 8*4            //clean up stack
+   *handle = memory;
+   return memory ? address : NULL;
+}
+
+
+VXDINLINE void Page_Free(DWORD handle)
+{
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VMMCall is using C calling connvention
+   _asm push 0                  //flags
+   _asm push handle
+   VMMCall(_PageFree);
+   _asm add esp, 2*4            //clean up stack
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Map locked pages into the shared arena. The returned address is valid in all
+   contexts, including the address spaces of the Win32 applications (ring 3).
+
+   \param   address  linear address of the pages (cf. Page_Allocate)
+   \param   pages    number of pages
+
+   \return  address of the pages in the shared arena (NULL on error)
+----------------------------------------------------------------------------*/
+VXDINLINE void * Page_MapGlobal(void * address, DWORD pages)
+{
+   DWORD const page = (DWORD)address >> 12;
+   DWORD const flags = PAGEMAPGLOBAL;
+   void * global;
+
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VMMCall is using C calling connvention
+   _asm push flags
+   _asm push pages
+   _asm push page
+   VMMCall(_LinPageLock);
+   _asm mov global, eax
+   _asm add esp, 3*4            //clean up stack
+   return global;
+}
+
+
+VXDINLINE void Page_UnmapGlobal(void * global, DWORD pages)
+{
+   DWORD const page = (DWORD)global >> 12;
+   DWORD const flags = PAGEMAPGLOBAL;
+
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VMMCall is using C calling connvention
+   _asm push flags
+   _asm push pages
+   _asm push page
+   VMMCall(_LinPageUnLock);
+   _asm add esp, 3*4            //clean up stack
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Validate and lock a buffer of the calling Win32 application, so that it can be accessed
+   within a critical section (no page fault). Must be called in the context of the application,
+   not at interrupt time. Unlock with Page_UnlockUser.
+
+   \param   buffer   linear address of the buffer (private arena)
+   \param   length   size of the buffer [bytes]
+
+   \retval  TRUE     if the buffer is locked (or empty)
+   \retval  FALSE    if it is not within the private arena, or not committed
+----------------------------------------------------------------------------*/
+VXDINLINE BOOL Page_LockUser(void * buffer, DWORD length)
+{
+   DWORD const address = (DWORD)buffer;
+   DWORD page;
+   DWORD pages;
+   DWORD locked;
+
+   if (length == 0)
+   {
+      return 1;
+   }
+   if ((address < USER_ARENA_START) || (address >= USER_ARENA_END) || (length > (USER_ARENA_END - address)))
+   {
+      return 0;
+   }
+   page = address >> 12;
+   pages = ((address + length - 1) >> 12) - page + 1;
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VMMCall is using C calling connvention
+   _asm push 0                  //flags: lock in the current context
+   _asm push pages
+   _asm push page
+   VMMCall(_LinPageLock);
+   _asm mov locked, eax
+   _asm add esp, 3*4            //clean up stack
+   return locked != 0;
+}
+
+
+VXDINLINE void Page_UnlockUser(void * buffer, DWORD length)
+{
+   DWORD const address = (DWORD)buffer;
+   DWORD page;
+   DWORD pages;
+
+   if (length == 0)
+   {
+      return;
+   }
+   page = address >> 12;
+   pages = ((address + length - 1) >> 12) - page + 1;
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VMMCall is using C calling connvention
+   _asm push 0
+   _asm push pages
+   _asm push page
+   VMMCall(_LinPageUnLock);
+   _asm add esp, 3*4            //clean up stack
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Schedule a time-out, that is not associated with a virtual machine.
+
+   The callback is a register based function. It gets called (at interrupt time) with
+   EBX = current VM, ECX = number of milli seconds the time-out is late, EDX = refData.
+
+   \param   milliseconds   time-out period
+   \param   refData        reference data passed to the callback in EDX
+   \param   callback       address of callback
+
+   \return  time-out handle (0 if time-out could not be scheduled)
+----------------------------------------------------------------------------*/
+VXDINLINE DWORD Timer_SetGlobalTimeOut(DWORD milliseconds, DWORD refData, void * callback)
+{
+   DWORD handle;
+
+   _asm mov eax, milliseconds
+   _asm mov edx, refData
+   _asm mov esi, callback
+   VMMCall(Set_Global_Time_Out);
+   _asm mov handle, esi
+   return handle;
+}
+
+
+VXDINLINE void Timer_CancelTimeOut(DWORD handle)
+{
+   _asm mov esi, handle
+   VMMCall(Cancel_Time_Out);
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Schedule a global event. May be called at interrupt time.
+
+   The callback is a register based function. It gets called (outside of interrupt time) with
+   EBX = current VM, EDX = refData.
+
+   \param   callback       address of callback
+   \param   refData        reference data passed to the callback in EDX
+
+   \return  event handle
+----------------------------------------------------------------------------*/
+VXDINLINE DWORD Event_ScheduleGlobal(void * callback, DWORD refData)
+{
+   DWORD handle;
+
+   _asm mov esi, callback
+   _asm mov edx, refData
+   VMMCall(Schedule_Global_Event);
+   _asm mov handle, esi
+   return handle;
+}
+
+
+/*----------------------------------------------------------------------------
+   Ring 0 file access, using IFSMgr_Ring0_FileIO. This functions must not be called
+   at interrupt time.
+----------------------------------------------------------------------------*/
+enum { __IFSMgr_Ring0_FileIO = 0x400032 }; //include von ifsmgr.h verursacht probleme. deswegen muss ich hier selbst berechnen...
+#define R0_OPENCREATFILE      (0xD500)
+#define R0_READFILE           (0xD600)
+#define R0_WRITEFILE          (0xD601)
+#define R0_CLOSEFILE          (0xD700)
+#define R0_GETFILESIZE        (0xD800)
+//open mode
+#define R0_ACCESS_READONLY    (0x00)
+#define R0_ACCESS_WRITEONLY   (0x01)
+#define R0_ACCESS_READWRITE   (0x02)
+#define R0_SHARE_DENYNONE     (0x40)
+//open action
+#define R0_ACTION_OPENEXISTING      (0x01)
+#define R0_ACTION_REPLACEEXISTING   (0x02)
+#define R0_ACTION_CREATENEW         (0x10)
+
+
+//return file handle (0 on error)
+VXDINLINE DWORD IFSMgr_OpenFile(char * path, DWORD mode, DWORD action)
+{
+   DWORD handle = 0;
+
+   _asm mov eax, R0_OPENCREATFILE
+   _asm mov ebx, mode
+   _asm sub ecx, ecx       //normal file attributes
+   _asm mov edx, action
+   _asm mov esi, path
+   VxDCall(IFSMgr_Ring0_FileIO);
+   JC_FORWARED(3);         //skip next assignmet inscruction (3 bytes) in case of carry flag (error indicator)
+   _asm mov handle, eax
+   return handle;
+}
+
+
+//return number of read bytes
+VXDINLINE DWORD IFSMgr_ReadFile(DWORD handle, void * buffer, DWORD count, DWORD position)
+{
+   DWORD read = 0;
+
+   _asm mov eax, R0_READFILE
+   _asm mov ebx, handle
+   _asm mov ecx, count
+   _asm mov edx, position
+   _asm mov esi, buffer
+   VxDCall(IFSMgr_Ring0_FileIO);
+   JC_FORWARED(3);         //skip next assignmet inscruction (3 bytes) in case of carry flag (error indicator)
+   _asm mov read, eax
+   return read;
+}
+
+
+//return number of written bytes
+VXDINLINE DWORD IFSMgr_WriteFile(DWORD handle, void * buffer, DWORD count, DWORD position)
+{
+   DWORD written = 0;
+
+   _asm mov eax, R0_WRITEFILE
+   _asm mov ebx, handle
+   _asm mov ecx, count
+   _asm mov edx, position
+   _asm mov esi, buffer
+   VxDCall(IFSMgr_Ring0_FileIO);
+   JC_FORWARED(3);         //skip next assignmet inscruction (3 bytes) in case of carry flag (error indicator)
+   _asm mov written, eax
+   return written;
+}
+
+
+VXDINLINE DWORD IFSMgr_GetFileSize(DWORD handle)
+{
+   DWORD size = 0;
+
+   _asm mov eax, R0_GETFILESIZE
+   _asm mov ebx, handle
+   _asm sub ecx, ecx       //touch clobberd registers by VxDCall
+   _asm sub edx, edx
+   VxDCall(IFSMgr_Ring0_FileIO);
+   JC_FORWARED(3);         //skip next assignmet inscruction (3 bytes) in case of carry flag (error indicator)
+   _asm mov size, eax
+   return size;
+}
+
+
+VXDINLINE void IFSMgr_CloseFile(DWORD handle)
+{
+   _asm mov eax, R0_CLOSEFILE
+   _asm mov ebx, handle
+   _asm sub ecx, ecx       //touch clobberd registers by VxDCall
+   _asm sub edx, edx
+   VxDCall(IFSMgr_Ring0_FileIO);
+}
+
+
 VXDINLINE DWORD System_GetTime(void)
 {
    DWORD time1ms; //time in milli seconds, since windows was started
@@ -302,6 +672,145 @@ VXDINLINE DWORD System_GetTime(void)
 }
 
 
+/*----------------------------------------------------------------------------
+   \brief Complete an overlapped DeviceIoControl call, that returned ERROR_IO_PENDING.
+
+   \param   event    O_Internal of the OVERLAPPED structure of the call
+----------------------------------------------------------------------------*/
+VXDINLINE void VWIN32_DIOCCompletion(DWORD event)
+{
+   _asm mov ebx, event
+   VxDCall(VWIN32_DIOCCompletionRoutine);
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Get the Win32 process, whose thread is currently running (e.g. the caller of
+   CreateFile resp. DeviceIoControl).
+
+   \return  handle of the process (ring 0 process data base)
+----------------------------------------------------------------------------*/
+VXDINLINE DWORD VWIN32_GetCurrentProcess(void)
+{
+   DWORD process;
+
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   VxDCall(VWIN32_GetCurrentProcessHandle);
+   _asm mov process, eax
+   return process;
+}
+
+
+/*----------------------------------------------------------------------------
+   \brief Check, if a VxD is loaded.
+
+   \param   deviceId       device ID of the VxD
+
+   \return  address of the VxDs device description block (NULL if not loaded)
+----------------------------------------------------------------------------*/
+VXDINLINE void * VMM_GetDDB(DWORD deviceId)
+{
+   void * ddb;
+
+   _asm mov eax, deviceId
+   _asm sub edi, edi       //no name, search by device ID only
+   VMMCall(Get_DDB);
+   _asm mov ddb, ecx
+   return ddb;
+}
+
+
+/*----------------------------------------------------------------------------
+   Performance statistics of System Monitor (SYSMON), using the PERF VxD. The PERF
+   VxD must be loaded (cf. VMM_GetDDB), before any of its services is called.
+   The structures correspond to perf_server_0 and perf_stat_0 of perf.h.
+----------------------------------------------------------------------------*/
+#define PERF_DEVICE_ID        (0x0048)
+enum { __PERF_Server_Register = 0x480001 };  //include von perf.h verursacht probleme. deswegen muss ich hier selbst berechnen...
+enum { __PERF_Server_Deregister = 0x480002 };
+enum { __PERF_Server_Add_Stat = 0x480003 };
+#define PERF_STAT_FUNCPTR     (0x01)   //stat is a function returning the value (otherwise: a pointer to a DWORD)
+#define PERF_STAT_COUNT       (0x02)   //stat is a counter, displayed as rate per second (otherwise: a value)
+
+typedef struct _PerfServer
+{
+   DWORD level;               //level of the structure (0)
+   DWORD flags;               //none defined
+   char * name;               //name displayed by System Monitor (category)
+   char * nodeName;           //name of the registry node
+   void * controlFunc;        //not implemented (NULL)
+} PerfServer;
+
+typedef struct _PerfStat
+{
+   DWORD level;               //level of the structure (0)
+   DWORD flags;               //PERF_STAT_xxx
+   char * name;               //name displayed by System Monitor (item)
+   char * nodeName;           //name of the registry node (unique within the server)
+   char * unitName;           //e.g. "Bytes/s"
+   char * description;        //explanation displayed by System Monitor
+   void * stat;               //address of the DWORD value (or function, cf. PERF_STAT_FUNCPTR)
+   DWORD scaleType;           //0: default scale
+} PerfStat;
+
+
+//register this VxD as server of statistics. the structure must stay valid, until it is deregistered.
+//returns the handle of the server (0 on error)
+VXDINLINE DWORD PERF_ServerRegister(PerfServer * server)
+{
+   DWORD handle;
+
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VxDCall is using C calling connvention
+   _asm push server
+   VxDCall(_PERF_Server_Register);
+   _asm mov handle, eax
+   _asm add esp, 1*4            //clean up stack
+   return handle;
+}
+
+
+//add a statistic to a server. the structure and the value must stay valid, until the server is deregistered.
+//returns the handle of the statistic (0 on error)
+VXDINLINE DWORD PERF_ServerAddStat(DWORD server, PerfStat * stat)
+{
+   DWORD handle;
+
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VxDCall is using C calling connvention
+   _asm push stat
+   _asm push server
+   VxDCall(_PERF_Server_Add_Stat);
+   _asm mov handle, eax
+   _asm add esp, 2*4            //clean up stack
+   return handle;
+}
+
+
+//deregister a server, including all of its statistics
+VXDINLINE void PERF_ServerDeregister(DWORD server)
+{
+   // touch callee-save registers clobberd by VxDCall
+   //  ....in order to let the inline-assembler know about that
+   _asm sub eax, eax
+   _asm sub ecx, ecx
+   _asm sub edx, edx
+   // VxDCall is using C calling connvention
+   _asm push server
+   VxDCall(_PERF_Server_Deregister);
+   _asm add esp, 1*4            //clean up stack
+}
+
+
 
 
 
@@ -310,4 +819,6 @@ VXDINLINE DWORD System_GetTime(void)
 } /* end of extern "C" */
 #endif
 
+#endif /* MXVCP_HOST */
+
 #endif